@@ -0,0 +1,106 @@
+// @file matrix_bench.cpp
+// Micro-benchmark for the batch transform composite (4x4) * points (4xN),
+// the multiply ViewContext::modelToDevice performs on every draw.
+// Reports points/second for:
+//   checked - the original r/c/i loop through matrix::operator[]
+//   scalar  - multiplyWideScalar, blocked but not vectorized
+//   kernel  - multiplyWide with the implementation selected for this CPU
+//
+// usage: matrix_bench [numPoints] [repetitions]
+
+#include "matrix.h"
+#include "fixedmatrix.h"
+#include "matkernel.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+// the multiply as matrix::operator* used to do it, every access checked
+static void checkedMultiply(const matrix& a, const matrix& b, matrix& out)
+{
+	for (int r=0; r<a.getRows(); r++)
+	{
+		for (int c=0; c<b.getCols(); c++)
+		{
+			out[r][c] = 0;
+			for (int i=0; i<a.getCols(); i++)
+			{
+				out[r][c] += a[r][i] * b[i][c];
+			}
+		}
+	}
+}
+
+template <typename F>
+static double pointsPerSecond(unsigned int numPoints, unsigned int reps, F run)
+{
+	// warm up caches and the branch predictor once before timing
+	run();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int i=0; i<reps; i++)
+	{
+		run();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return (double)numPoints * reps / elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int numPoints = (argc > 1) ? std::atoi(argv[1]) : 100000;
+	unsigned int reps = (argc > 2) ? std::atoi(argv[2]) : 50;
+
+	// something shaped like a real composite: rotation, scale, perspective
+	Mat4 composite = Mat4::translation(400, 300, 0) * Mat4::rotationZ(0.3) *
+			Mat4::scale(2, 2, 2);
+	composite[3][2] = -1.0/25;
+	matrix compositeM = toMatrix(composite);
+
+	matrix points(4, numPoints);
+	for (unsigned int c=0; c<numPoints; c++)
+	{
+		points[0][c] = (c % 997) * 0.5;
+		points[1][c] = (c % 491) * -0.25;
+		points[2][c] = (c % 13);
+		points[3][c] = 1;
+	}
+
+	matrix checked(4, numPoints), scalar(4, numPoints), kernel(4, numPoints);
+
+	double checkedRate = pointsPerSecond(numPoints, reps, [&]() {
+		checkedMultiply(compositeM, points, checked);
+	});
+	double scalarRate = pointsPerSecond(numPoints, reps, [&]() {
+		multiplyWideScalar(composite[0], 4, 4, points.data(), numPoints,
+				scalar.data());
+	});
+	double kernelRate = pointsPerSecond(numPoints, reps, [&]() {
+		multiplyWide(composite[0], 4, 4, points.data(), numPoints,
+				kernel.data());
+	});
+
+	// every path must agree exactly
+	for (unsigned int i=0; i<4*numPoints; i++)
+	{
+		if (checked.data()[i] != kernel.data()[i] ||
+				scalar.data()[i] != kernel.data()[i])
+		{
+			std::cerr << "mismatch at element " << i << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << "4x4 * 4x" << numPoints << ", " << reps << " repetitions" 
+			<< std::endl;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "  checked:       " << std::setw(8) << checkedRate/1e6 
+			<< " Mpoints/s" << std::endl;
+	std::cout << "  scalar:        " << std::setw(8) << scalarRate/1e6 
+			<< " Mpoints/s" << std::endl;
+	std::cout << "  kernel (" << std::setw(6) << multiplyWideImpl() << "): " 
+			<< std::setw(8) << kernelRate/1e6 << " Mpoints/s  (" 
+			<< kernelRate/checkedRate << "x checked)" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,168 @@
+// @file render_bench.cpp
+// Benchmark for whole frames drawn without a display: an STL model drawn
+// filled and as a wireframe into a FramebufferContext on one thread, and
+// into TiledContexts with increasing numbers of threads. Every tiled frame
+// is checked to be identical to the single-threaded one. Then a scene of
+// many small triangles is drawn with the image unpacked and packed (see
+// Image::setPacked), which must draw the same frames.
+//
+// usage: render_bench [model.stl] [frames] [width] [height] [triangles]
+
+#include "Image.h"
+#include "fbcontext.h"
+#include "tiledcontext.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <thread>
+
+// draws the image frames times
+// @returns milliseconds per frame
+static double msPerFrame(Image &image, ViewContext &vc, GraphicsContext &gc,
+		unsigned int frames)
+{
+	// one frame to warm up caches and size the tile bins
+	gc.clear();
+	image.draw(&gc, &vc);
+	gc.flush();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int i=0; i<frames; i++)
+	{
+		gc.clear();
+		image.draw(&gc, &vc);
+		gc.flush();
+	}
+	std::chrono::duration<double, std::milli> elapsed = 
+			std::chrono::steady_clock::now() - start;
+	return elapsed.count() / frames;
+}
+
+// Fills image with a grid of small triangles over most of the view, each
+// of its own color and depth
+static void buildTriangles(Image &image, unsigned int count, double width, 
+		double height)
+{
+	unsigned int columns = std::sqrt(count * width / height) + 1;
+	double step = 0.9 * width / columns;
+	matrix pts(4, 3);
+	for (unsigned int i=0; i<count; i++)
+	{
+		double x = -0.45*width + (i % columns)*step;
+		double y = -0.45*height + (i / columns)*step;
+		double z = (i % 7) * step;
+		double corners[3][2] = {{0, 0}, {step, 0.2*step}, {0.3*step, step}};
+		for (int c=0; c<3; c++)
+		{
+			pts[0][c] = x + corners[c][0];
+			pts[1][c] = y + corners[c][1];
+			pts[2][c] = z;
+			pts[3][c] = 1;
+		}
+		Triangle triangle(pts, (i * 2654435761u) & 0xFFFFFF);
+		image.add(&triangle);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = (argc > 1) ? argv[1] : "word.stl";
+	unsigned int frames = (argc > 2) ? std::atoi(argv[2]) : 20;
+	unsigned int width = (argc > 3) ? std::atoi(argv[3]) : 1920;
+	unsigned int height = (argc > 4) ? std::atoi(argv[4]) : 1080;
+	unsigned int triangles = (argc > 5) ? std::atoi(argv[5]) : 200000;
+
+	Image image;
+	try
+	{
+		image.parseStl(path);
+	}
+	catch (imageException &e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	// fill most of the frame with the model
+	ViewContext vc(height, width);
+	vc.configZoom(1.5);
+	for (int i=0; i<8; i++)
+	{
+		vc.zoom(true);
+	}
+	vc.configRotation(20);
+	vc.rotate(true);
+
+	std::cout << path << ", " << width << "x" << height << ", " << frames 
+			<< " frames" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	for (int filled=1; filled>=0; filled--)
+	{
+		image.setFilled(filled);
+		FramebufferContext reference(width, height);
+		double single = msPerFrame(image, vc, reference, frames);
+		std::cout << (filled ? "filled" : "wireframe") << std::endl;
+		std::cout << "  framebuffer:         " << std::setw(8) << single 
+				<< " ms/frame" << std::endl;
+		std::cout << "  " << vc.getCullStats() << std::endl;
+
+		// At least 2 threads: with 1, TiledContext draws straight through
+		// and its tiles would go unchecked
+		unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 2u);
+		for (unsigned int threads=1; ; threads*=2)
+		{
+			threads = std::min(threads, maxThreads);
+			ThreadPool pool(threads);
+			TiledContext tiled(width, height, GraphicsContext::BLACK, pool);
+			double ms = msPerFrame(image, vc, tiled, frames);
+			if (std::memcmp(tiled.data(), reference.data(), 
+					width*height*sizeof(uint32_t)) != 0)
+			{
+				std::cerr << "tiled frame differs from the framebuffer's" 
+						<< std::endl;
+				return 1;
+			}
+			std::cout << "  tiled, " << std::setw(2) << threads << " threads: " 
+					<< std::setw(8) << ms << " ms/frame  (" << single/ms 
+					<< "x)" << std::endl;
+			if (threads >= maxThreads)
+			{
+				break;
+			}
+		}
+	}
+
+	Image scene;
+	buildTriangles(scene, triangles, width, height);
+	ViewContext sceneView(height, width);
+	sceneView.configRotation(10);
+	sceneView.rotate(true);
+	std::cout << triangles << " triangles" << std::endl;
+	for (int filled=1; filled>=0; filled--)
+	{
+		scene.setFilled(filled);
+		scene.setPacked(false);
+		FramebufferContext objects(width, height);
+		double single = msPerFrame(scene, sceneView, objects, frames);
+		scene.setPacked(true);
+		FramebufferContext packed(width, height);
+		double ms = msPerFrame(scene, sceneView, packed, frames);
+		if (std::memcmp(packed.data(), objects.data(), 
+				width*height*sizeof(uint32_t)) != 0)
+		{
+			std::cerr << "packed frame differs from the unpacked one" << std::endl;
+			return 1;
+		}
+		std::cout << (filled ? "filled" : "wireframe") << std::endl;
+		std::cout << "  shape objects:       " << std::setw(8) << single 
+				<< " ms/frame" << std::endl;
+		std::cout << "  packed arrays:       " << std::setw(8) << ms 
+				<< " ms/frame  (" << single/ms << "x)" << std::endl;
+		std::cout << "  " << sceneView.getCullStats() << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+// @file roundtrip_check.cpp
+// Check that images survive being saved and loaded again. A scene of every
+// shape type, an STL model included, is saved as text, binary and
+// compressed binary, and each file loaded both unpacked and packed (see
+// Image::setPacked): every loaded image must write out the same text as
+// the scene, and save the same bytes as the file it came from. Then
+// malformed text must be rejected with an imageException naming the line
+// and column at fault, and truncated binary files with one too.
+//
+// usage: roundtrip_check [model.stl] [shapes]
+
+#include "Image.h"
+#include "Line.h"
+#include "Triangle.h"
+#include "Circle.h"
+#include "Rectangle.h"
+#include "Polygon.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+// where the files are written, in the current directory
+static const char* const TEMP_PATH = "roundtrip_check.tmp";
+
+// @returns what out writes for image
+static std::string text(const Image &image)
+{
+	std::ostringstream os;
+	os << image;
+	return os.str();
+}
+
+// @returns the contents of the file at path
+static std::string readFile(const std::string &path)
+{
+	std::ifstream ifs(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(ifs),
+			std::istreambuf_iterator<char>());
+}
+
+// writes contents to the file at path
+static void writeFile(const std::string &path, const std::string &contents)
+{
+	std::ofstream ofs(path, std::ios::binary);
+	ofs.write(contents.data(), contents.size());
+}
+
+// @returns whether a and b hold the same bytes
+static bool same(const std::string &a, const std::string &b)
+{
+	return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// Fills image with count shapes, cycling through the types, with
+// coordinates that don't print exactly in decimal. Polygons of one and
+// two points are among them.
+static void buildScene(Image &image, unsigned int count)
+{
+	matrix pts(4, 6);
+	for (unsigned int i=0; i<count; i++)
+	{
+		int color = (i * 2654435761u) & 0xFFFFFF;
+		for (int c=0; c<6; c++)
+		{
+			pts[0][c] = (i % 97) / 3.0 + c;
+			pts[1][c] = -(double)(i % 89) / 7.0 - c*c;
+			pts[2][c] = (i % 5) * 1e-3;
+			pts[3][c] = 1;
+		}
+		switch (i % 6)
+		{
+			case 0: image.emplace<Point>(pts[0][0], pts[1][0], pts[2][0], color); break;
+			case 1: image.emplace<Line>(pts, color); break;
+			case 2: image.emplace<Triangle>(pts, color); break;
+			case 3: image.emplace<Circle>(pts, color); break;
+			case 4: image.emplace<Rectangle>(pts, pts[0][1], pts[1][1], color); break;
+			default: image.emplace<Polygon>(1 + i/6 % 6, pts, color); break;
+		}
+	}
+}
+
+// Loads contents from a file, which must fail
+// @param expected what the imageException's message must contain, empty
+//		  for any
+// @returns whether it failed as expected
+static bool checkRejected(const std::string &contents, const std::string &expected)
+{
+	writeFile(TEMP_PATH, contents);
+	Image image;
+	try
+	{
+		image.load(TEMP_PATH);
+	}
+	catch (imageException &e)
+	{
+		std::string message = e.what();
+		if (message.find(expected) == std::string::npos)
+		{
+			std::cerr << "expected \"" << expected << "\", got \"" << message
+					<< "\"" << std::endl;
+			return false;
+		}
+		return true;
+	}
+	std::cerr << "loaded without the error \"" << expected << "\"" << std::endl;
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = (argc > 1) ? argv[1] : "word.stl";
+	unsigned int count = (argc > 2) ? std::atoi(argv[2]) : 10000;
+
+	Image scene;
+	try
+	{
+		buildScene(scene, count);
+		scene.parseStl(path);
+	}
+	catch (imageException &e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	std::string reference = text(scene);
+
+	const char* const NAMES[] = {"text", "binary", "compressed"};
+	const Image::SaveFormat FORMATS[] = {Image::SAVE_TEXT, Image::SAVE_BINARY,
+			Image::SAVE_COMPRESSED};
+	std::string files[3];
+	for (int f=0; f<3; f++)
+	{
+		try
+		{
+			scene.save(TEMP_PATH, FORMATS[f]);
+			files[f] = readFile(TEMP_PATH);
+			for (int packed=0; packed<2; packed++)
+			{
+				Image loaded;
+				loaded.setPacked(packed);
+				loaded.load(TEMP_PATH);
+				if (!same(text(loaded), reference))
+				{
+					std::cerr << NAMES[f] << " file loaded " <<
+							(packed ? "packed" : "unpacked") <<
+							" differs from the scene" << std::endl;
+					return 1;
+				}
+				loaded.save(TEMP_PATH, FORMATS[f]);
+				if (!same(readFile(TEMP_PATH), files[f]))
+				{
+					std::cerr << NAMES[f] << " file loaded " <<
+							(packed ? "packed" : "unpacked") <<
+							" saves differently" << std::endl;
+					return 1;
+				}
+			}
+		}
+		catch (imageException &e)
+		{
+			std::cerr << NAMES[f] << ": " << e.what() << std::endl;
+			return 1;
+		}
+		std::cout << NAMES[f] << ": " << files[f].size() << " bytes, same"
+				<< std::endl;
+	}
+
+	// where the error is counts in lines and columns from 1
+	std::string at = std::string(TEMP_PATH) + ":";
+	size_t lines = 1;
+	for (char c : files[0])
+	{
+		lines += (c == '\n');
+	}
+	bool rejected =
+			checkRejected("p(color=0x00FF00 p1=[1 2 3 1]')\nq(",
+					at + "2:1: expected a shape") &&
+			checkRejected("p(color=0x00FF00 p1=[1 2 x 1]')",
+					at + "1:26: expected a number") &&
+			checkRejected("t(color=0x0000FF p1=[0 0 0 1]'\n  p2=[1 1 1 1]')",
+					at + "2:16: expected a triangle to have 3 points") &&
+			checkRejected("m(color=0x0000FF p1=[0 0 0 1]'\n  v=[0 0 0]'\n"
+					"  f=[0 0 5]')",
+					at + "3:10: expected the index of a vertex") &&
+			// past the end of a large file, which is parsed in pieces
+			checkRejected(files[0] + "\nl(color=0x000010 p1=[0 0 0 1]' p2=[1 1 1 1 )",
+					at + std::to_string(lines + 1) + ":44: expected \"]'\"") &&
+			checkRejected(files[1].substr(0, files[1].size()/2), "") &&
+			checkRejected(files[2].substr(0, files[2].size()/2), "");
+	std::remove(TEMP_PATH);
+	if (!rejected)
+	{
+		return 1;
+	}
+	std::cout << "malformed files: rejected" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,261 @@
+// @file x11_check.cpp
+// Check that X11Context draws what FramebufferContext does, in each of its
+// present modes (see X11Context::presentMode, main's -p). The same scene is
+// drawn filled and as a wireframe into a window and into a framebuffer,
+// two frames each, and the window's pixels read back with getPixels must
+// be the framebuffer's. Then both go through the same steps of pixels,
+// lines, circles, XOR drawing and clears, after each of which getPixels
+// must match, over the window and over rectangles reaching past its edges.
+// getPixel must match too, read right after setPixel the way a flood fill
+// does.
+// PRESENT_PIXMAP has the server draw lines and circles, which may put an
+// odd pixel elsewhere than the framebuffer does: there, up to
+// MAX_PIXMAP_DIFFERING of the frame may differ. Any other difference fails
+// the check.
+//
+// Needs a display with a 24 bit true color visual, such as
+//	 xvfb-run -s "-screen 0 640x480x24" ./x11_check
+//
+// usage: x11_check [width] [height]
+
+#include "Image.h"
+#include "Line.h"
+#include "Triangle.h"
+#include "Circle.h"
+#include "Polygon.h"
+#include "fbcontext.h"
+#include "x11context.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <unistd.h> // for alarm
+
+// a display that never answers fails the check rather than hanging it
+static const unsigned int TIMEOUT_SECONDS = 60;
+
+// in PRESENT_PIXMAP, the fraction of the frame's pixels the server may
+// draw differently
+static const double MAX_PIXMAP_DIFFERING = 0.01;
+
+// @returns the name main's -p takes for mode
+static const char* modeName(X11Context::presentMode mode)
+{
+	switch (mode)
+	{
+		case X11Context::PRESENT_PIXMAP: return "pixmap";
+		case X11Context::PRESENT_IMAGE: return "image";
+		default: return "shm";
+	}
+}
+
+// Fills image with shapes of every kind drawn with lines, circles and
+// filled triangles, some of them partly outside a view of width x height
+static void buildScene(Image &image, double width, double height)
+{
+	matrix pts(4, 5);
+	for (unsigned int i=0; i<40; i++)
+	{
+		int color = (i * 2654435761u) & 0xFFFFFF;
+		double x = (i % 8) * width / 7 - width/2;
+		double y = (i / 8) * height / 4 - height/2;
+		double corners[5][2] = {{0, 0}, {width/9, height/40},
+				{width/30, height/7}, {-width/20, height/11}, {-width/13, 0}};
+		for (int c=0; c<5; c++)
+		{
+			pts[0][c] = x + corners[c][0];
+			pts[1][c] = y + corners[c][1];
+			pts[2][c] = i % 5;
+			pts[3][c] = 1;
+		}
+		switch (i % 4)
+		{
+			case 0: image.emplace<Line>(pts, color); break;
+			case 1: image.emplace<Triangle>(pts, color); break;
+			case 2: image.emplace<Circle>(pts, color); break;
+			default: image.emplace<Polygon>(5, pts, color); break;
+		}
+	}
+}
+
+// @returns how many pixels of the width x height rectangle at (x, y) in
+//			gc differ from those of reference
+static unsigned int countDiffering(GraphicsContext &gc,
+		FramebufferContext &reference, int x, int y, int width, int height)
+{
+	std::vector<unsigned int> got(width*height), expected(width*height);
+	gc.getPixels(x, y, width, height, got.data());
+	reference.getPixels(x, y, width, height, expected.data());
+	unsigned int differing = 0;
+	for (size_t i=0; i<got.size(); i++)
+	{
+		differing += (got[i] & 0xFFFFFF) != expected[i];
+	}
+	return differing;
+}
+
+// the steps runStep takes
+static const char* const STEP_NAMES[] = {"clear", "set and get pixels",
+		"lines and circles", "XOR lines twice", "XOR lines and circles",
+		"XOR pixels", "clear again"};
+static const int NUM_STEPS = sizeof(STEP_NAMES)/sizeof(STEP_NAMES[0]);
+
+// Draws step s of the readback check into gc, a width x height window
+// @returns what getPixel read during the step
+static std::vector<unsigned int> runStep(GraphicsContext &gc, int s, 
+		int width, int height)
+{
+	std::vector<unsigned int> read;
+	switch (s)
+	{
+		case 0:
+		case 6:
+			gc.clear();
+			break;
+		case 1:
+			// each pixel read as soon as it's set, as a flood fill does,
+			// and the one next to it, not yet set
+			for (int i=0; i<200; i++)
+			{
+				int x = (i * 37) % (width + 20) - 10;
+				int y = (i * 53) % (height + 20) - 10;
+				gc.setColor((i * 2654435761u) & 0xFFFFFF);
+				gc.setPixel(x, y);
+				read.push_back(gc.getPixel(x, y));
+				read.push_back(gc.getPixel(x + 1, y));
+			}
+			break;
+		case 2:
+		case 3:
+		case 4:
+			if (s != 2)
+			{
+				gc.setMode(GraphicsContext::MODE_XOR);
+			}
+			// twice in a row puts back what was there
+			for (int pass=0; pass<(s == 3 ? 2 : 1); pass++)
+			{
+				for (int i=0; i<12; i++)
+				{
+					gc.setColor(0x123456 * (i + 1) & 0xFFFFFF);
+					gc.drawLine(i * width / 11 - 5, -5, width - i * width / 13, 
+							height + 5);
+					if (s != 3)
+					{
+						gc.drawCircle(i * width / 11, height / 2, 10 + i * 7);
+					}
+				}
+			}
+			gc.setMode(GraphicsContext::MODE_NORMAL);
+			break;
+		case 5:
+			gc.setMode(GraphicsContext::MODE_XOR);
+			gc.setColor(0xFFFFFF);
+			for (int y=height/4; y<height/2; y++)
+			{
+				for (int x=width/4; x<width/2; x++)
+				{
+					gc.setPixel(x, y);
+				}
+			}
+			read.push_back(gc.getPixel(width/3, height/3));
+			gc.setMode(GraphicsContext::MODE_NORMAL);
+			break;
+	}
+	return read;
+}
+
+int main(int argc, char** argv)
+{
+	int width = (argc > 1) ? std::atoi(argv[1]) : 320;
+	int height = (argc > 2) ? std::atoi(argv[2]) : 240;
+	alarm(TIMEOUT_SECONDS);
+	Display* display = XOpenDisplay(NULL);
+	if (!display)
+	{
+		std::cerr << "no display: run under Xvfb" << std::endl;
+		return 1;
+	}
+	XCloseDisplay(display);
+
+	Image scene;
+	buildScene(scene, width, height);
+	ViewContext vc(height, width);
+	vc.configRotation(15);
+	vc.rotate(true);
+
+	bool passed = true;
+	const X11Context::presentMode MODES[] = {X11Context::PRESENT_PIXMAP,
+			X11Context::PRESENT_IMAGE, X11Context::PRESENT_SHM};
+	for (X11Context::presentMode asked : MODES)
+	{
+		X11Context window(width, height, GraphicsContext::BLACK, asked);
+		X11Context::presentMode mode = window.getPresentMode();
+		std::cout << modeName(asked);
+		if (mode != asked)
+		{
+			// the same mode is checked again, not this one
+			std::cout << ": not supported by the display, skipped" << std::endl;
+			continue;
+		}
+		std::cout << std::endl;
+		FramebufferContext reference(width, height, GraphicsContext::BLACK);
+		for (int filled=1; filled>=0; filled--)
+		{
+			scene.setFilled(filled);
+			unsigned int differing = 0;
+			// the second frame is drawn over pixels the server may still
+			// be presenting
+			for (int frame=0; frame<2; frame++)
+			{
+				GraphicsContext* contexts[2] = {&window, &reference};
+				for (GraphicsContext* gc : contexts)
+				{
+					gc->clear();
+					scene.draw(gc, &vc);
+					gc->flush();
+				}
+				differing = std::max(differing, countDiffering(window, 
+						reference, 0, 0, width, height));
+			}
+			unsigned int allowed = (mode == X11Context::PRESENT_PIXMAP) ?
+					MAX_PIXMAP_DIFFERING*width*height : 0;
+			bool same = differing <= allowed;
+			passed = passed && same;
+			std::cout << "  " << (filled ? "filled:    " : "wireframe: ")
+					<< differing << " pixels differ"
+					<< (same ? "" : "  FAILED") << std::endl;
+		}
+		
+		for (int s=0; s<NUM_STEPS; s++)
+		{
+			std::vector<unsigned int> got = runStep(window, s, width, height);
+			std::vector<unsigned int> expected = runStep(reference, s, 
+					width, height);
+			unsigned int differing = countDiffering(window, reference, 
+					0, 0, width, height);
+			// partly outside the window, on both sides
+			unsigned int outside = countDiffering(window, reference, 
+					-10, -10, 40, 30) + countDiffering(window, reference, 
+					width - 20, height - 20, 40, 40);
+			unsigned int badReads = 0;
+			for (size_t i=0; i<got.size(); i++)
+			{
+				badReads += (got[i] & 0xFFFFFF) != expected[i];
+			}
+			// lines and circles the server drew stay until the next clear
+			bool showsLines = (s >= 2 && s <= 5);
+			unsigned int allowed = (mode == X11Context::PRESENT_PIXMAP && 
+					showsLines) ? MAX_PIXMAP_DIFFERING*width*height : 0;
+			bool same = differing <= allowed && outside <= allowed &&
+					badReads == 0;
+			passed = passed && same;
+			std::cout << "  " << STEP_NAMES[s] << ": " << differing 
+					<< " pixels differ, " << outside << " past the edges, " 
+					<< badReads << " of " << got.size() << " getPixel reads"
+					<< (same ? "" : "  FAILED") << std::endl;
+		}
+	}
+
+	return passed ? 0 : 1;
+}
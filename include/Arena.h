@@ -0,0 +1,79 @@
+// @file Arena.h
+// A region allocator. Memory is handed out of large blocks by bumping a
+// pointer, and given back only all at once, by release: thousands of small
+// objects cost a handful of calls to the heap, and clearing them frees a
+// handful of blocks instead of every object, leaving no holes behind.
+//
+// An arena doesn't know what was built in it. Objects with destructors
+// that do more than give back arena memory must be destroyed before the
+// arena is released. Arenas aren't thread safe: threads that build in
+// parallel each use their own and absorb them into one afterwards.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>	// for size_t, std::max_align_t
+#include <new>		// for placement new, which builds objects in an arena
+
+class Arena {
+public:
+	// bytes of each block, but for allocations too big to share one
+	static const size_t BLOCK_SIZE = 256*1024;
+
+	// An empty arena. No block is allocated until something is.
+	Arena();
+
+	// Frees every block
+	~Arena();
+
+	// What was allocated from an arena lives and dies with it
+	Arena(const Arena &a) = delete;
+	Arena& operator=(const Arena &rhs) = delete;
+
+	// @param bytes how much memory
+	// @param alignment what its address must be a multiple of, a power
+	//		  of 2 no greater than alignof(std::max_align_t)
+	// @returns uninitialized memory, valid until the arena is released
+	// @throws std::bad_alloc if no more memory can be had
+	void* allocate(size_t bytes, size_t alignment);
+
+	// @returns uninitialized memory for count objects of type T, which are
+	//			then constructed in it with placement new
+	template <typename T>
+	T* allocate(size_t count = 1)
+	{
+		return static_cast<T*>(allocate(count*sizeof(T), alignof(T)));
+	}
+
+	// Takes over all of other's blocks, so what was allocated from other
+	// is released with this arena. other is left empty.
+	void absorb(Arena &other);
+
+	// Gives back everything allocated at once. The newest block is kept
+	// for what's allocated next; the others are freed.
+	void release();
+
+	// @returns the bytes of all blocks held, used or not
+	size_t getCapacity() const;
+
+private:
+	// The start of every block, the memory handed out follows it
+	struct alignas(std::max_align_t) Block
+	{
+		// the block allocated before this one
+		Block* next;
+		// bytes handed out of the block, not counting this header
+		size_t size;
+	};
+
+	// newest block first
+	Block* blocks;
+	// where the next allocation from the newest block starts, and its end
+	char* position;
+	char* end;
+
+	// @returns a new block, with room for at least bytes
+	static Block* newBlock(size_t bytes);
+};
+
+#endif
@@ -21,6 +21,9 @@ public:
 	// It builds on top of the copy constructor of the shape class
 	Circle(const Circle &s);
 
+	// Copy constructor placing the copy's points in arena
+	Circle(const Circle &s, Arena &arena);
+
 	// This won't do anything, because the object contains Plain old data (POD).
 	// The default destructing will suffice.
 	virtual ~Circle();
@@ -33,6 +36,12 @@ public:
 	// and draws a Circle using the origin and a point on the circle
 	// using the passed GraphicsContext pointer and ViewContext pointer
 	virtual void draw(GraphicsContext *gc, ViewContext *vc) const;
+	
+	// The circle is drawn around its projected center with a radius
+	// measured on the device, which no box in the model is sure to
+	// contain, so circles aren't culled
+	// @returns false
+	virtual bool getModelBounds(double low[3], double high[3]) const;
 
 	// This implementation extends on the output of the Shape class by specifying 
 	// the shape type,
@@ -54,11 +63,17 @@ public:
 	// @throws shapeException if an invalid format to parse is passed
 	virtual void in(std::istream & is);
 
+	// @returns 'c', the character Circles are known by in files
+	virtual char getType() const;
+	
 	// the closest we get to a "virtual copy constructor"
 	// This will return a new'd copy of the current shape
 	// It's the responsibility of the caller to delete!
 	virtual Shape* clone() const;
 	
+	// Same as clone, but the copy and its points come from arena
+	virtual Shape* clone(Arena &arena) const;
+	
 };
 
 // global overloading of the stream insertion operator for the class
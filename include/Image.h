@@ -11,8 +11,12 @@
 #include "Circle.h"
 #include "Rectangle.h"
 #include "Polygon.h"
+#include "Mesh.h"
+#include "ShapeArrays.h"
 #include "x11context.h"
 #include <vector>
+#include <memory> // for std::unique_ptr
+#include <utility> // for std::forward
 #include <string> // for parseStl, taking string ref param for path
 #include <sstream>
 #include <fstream> // for parsting STL files
@@ -31,6 +35,22 @@ class imageException:public std::runtime_error
 
 class Image {
 public:
+	// How much parseStl tells about a load on std::cout
+	enum LoadVerbosity {
+		LOAD_QUIET,		// nothing
+		LOAD_REPORT,	// one summary: facets, bytes, parse time, bounding box
+		LOAD_DUMP		// the summary, then every shape in the image. Debug
+						// only: large models take longer to print than to load
+	};
+	
+	// The formats save can write. load reads any of them.
+	enum SaveFormat {
+		SAVE_TEXT,			// the text of out: readable, for interchange
+		SAVE_BINARY,		// the binary format of SceneFile.h
+		SAVE_COMPRESSED		// the binary format, compressed
+	};
+	
+
 	// no-argument constructor. Creates an empty Image with no shapes in it
 	Image();
 	
@@ -49,54 +69,175 @@ public:
 	
 	// Adds a Shape to the container by deep-copying the contents given
 	// This gives the responsibility of freeing the dynamically allocated data to the
-	// container alone
+	// container alone. The copy comes out of the image's arena, which erase
+	// releases all at once.
 	// @param s	Shape pointer; Deep-copied content will be allocated in the heap
 	void add(const Shape *s);
 	
-	// Invokes the draw() method of all shape objects within the shapes container
+	// Adds a shape without copying it: the image takes it over, and
+	// deletes it along with the rest. Packed, only meshes are kept as
+	// they are; other shapes are copied into the arrays.
+	// @param s a new'd shape
+	void add(std::unique_ptr<Shape> s);
+	
+	// Constructs a shape in the container, with no copy made of it.
+	// Unpacked, it's built in the image's arena; packed, it's built on
+	// the stack and its points copied into the arrays.
+	// @param args what T's constructor takes
+	template <typename T, typename... Args>
+	void emplace(Args&&... args);
+	
+	// Makes room for n shapes in all, for loaders that know how many
+	// are coming
+	void reserve(size_t n);
+	
+	// @returns the number of shapes in the image
+	size_t getNumShapes() const;
+	
+	// Gets a shape for editing. Packed or not, the image keeps its own.
+	// @param i which shape, in the order they were added
+	// @returns a new'd copy of the shape. It's the responsibility of the
+	//			caller to delete!
+	// @throws imageException if there is no such shape
+	Shape* getShape(size_t i) const;
+	
+	// Replaces a shape with a deep copy of s, of any type. The copy is
+	// new'd rather than built in the arena, so editing a shape over and
+	// over doesn't grow the arena.
+	// @param i which shape, in the order they were added
+	// @throws imageException if there is no such shape
+	void setShape(size_t i, const Shape *s);
+	
+	// Chooses how the shapes are stored. Unpacked (the default), each is
+	// a Shape object of its own. Packed, the shapes of each type share
+	// contiguous arrays (see ShapeArrays.h), which draws scenes of many
+	// small shapes faster; they are drawn a type at a time, rather than
+	// in the order they were added. Shapes are moved over when it changes.
+	void setPacked(bool packed);
+	
+	// @returns true if shapes are stored in per-type arrays
+	bool isPacked() const;
+	
+	// Invokes the draw() method of all shape objects within the shapes container,
+	// or their fill() method if the image is set to be filled. Shapes wholly
+	// out of view are skipped; what was culled is counted in vc's CullStats.
 	// @param gc Pointer to GraphicsContext used for drawing
 	// @param vc Pointer to ViewContext used to convert to device coordinates
 	void draw(GraphicsContext *gc, ViewContext *vc);
 	
+	// Chooses between drawing shapes as outlines (the default) and as
+	// solid, shaded surfaces that hide what's behind them
+	void setFilled(bool filled);
+	
+	// @returns true if shapes are drawn as solid surfaces
+	bool isFilled() const;
+	
+	// @returns a number that changes whenever what draw would draw does:
+	//			shapes added or erased, or the fill mode switched. A
+	//			drawing that remembers it can tell if it must redraw.
+	unsigned long getRevision() const;
+	
 	// Configures output for Extra space padding to generate output
 	// that does not begin at the start of a line
 	void setSpaceLevel(unsigned int spaceLevel);
 	
+	// Configures what parseStl prints after loading a file.
+	// Images start out quiet.
+	void setLoadVerbosity(LoadVerbosity verbosity);
+	
 	// Outputs all shapes to an ostream
 	std::ostream& out(std::ostream &os) const;
 	
 	// Reads a set of shapes from istream
 	std::istream& in(std::istream &is);	
 	
-	// Parses triangles out of an stl file and adds them into the image
+	// Outputs all shapes in the binary format (see SceneFile.h)
+	// @param os where to write, opened in binary mode
+	// @param compress whether to compress the shapes
+	// @throws imageException if this machine can't write the format
+	std::ostream& outBinary(std::ostream &os, bool compress) const;
+	
+	// Replaces the shapes with those of a file in the binary format
+	// @param data contents of the file, normally a MappedFile
+	// @param size number of bytes in data
+	// @throws imageException if the file is not in the format or damaged.
+	//		   The image is left empty.
+	void inBinary(const char* data, size_t size);
+	
+	// Writes all shapes to a file
+	// @param path the file to write
+	// @param format how to write them
+	// @throws imageException if the file can't be written
+	void save(const std::string &path, SaveFormat format) const;
+	
+	// Replaces the shapes with those saved in a file. Text and binary
+	// files are told apart by their contents. Text is parsed in one pass
+	// over the mapped file by ImgParser.
+	// @param path the file to read
+	// @throws imageException if the file can't be read or fails to parse;
+	//		   for text, with the line and column of the error
+	void load(const std::string &path);
+	
+	// Parses the triangles out of an stl file and adds them into the image
+	// as a single Mesh shape, with the corners facets share welded into one
+	// vertex (see Mesh::weld). Both ASCII and binary STL are accepted; the
+	// format is detected from the file contents.
+	// What gets printed afterwards depends on setLoadVerbosity.
 	// @param stlFile this should only contain triangle facets
-	// @throws imageException in case of parsing failure
-	void parseStl(const std::string &stlPath) throw(imageException);
+	// @throws imageException if the file can't be read or fails to parse
+	void parseStl(const std::string &stlPath);
 	
 	// removes all shapes from memory, and deallocates dynamic objects in the Image
 	// this destructor logic can be used in the destructor, but also the assignment 
-	// operator
+	// operator. Their memory goes back with the arena's blocks, not one by one.
+	// Shapes holding no memory of their own aren't even destroyed.
 	void erase();
 private:
-	// parses one facet out of the input file stream and creates 
-	// a triangle out of it! (yes facets happen to be triangles) 
-	// Always parses at least one line, or a whole facet
-	// @param stlFile the stl file to parse
-	// @returns a triangle pointer to a heap object representing the facet
-	//		    NULL if the first line parsed doesn't start with "facet normal"
-	// @throws imageException in case of parsing failure
-	Triangle* parseFacet(std::ifstream &stlFile) const throw(imageException);
-
-	// check for the start of a facet... It must start with "facet normal"
-	// @return whether the line really is the start of a facet
-	bool isFacetStart(const std::string &line) const;
-
+	// Disposes of a shape of the container as it came
+	struct ShapeOwner
+	{
+		enum Disposal
+		{
+			DELETE,		// handed over or edited in: new'd
+			DESTROY,	// in the arena, holding memory of its own
+			NOTHING		// in the arena, and nothing but: the arena's
+						// blocks take it all back
+		};
+		Disposal disposal;
+		void operator()(Shape *s) const;
+	};
+	// a shape, and how to dispose of it
+	typedef std::unique_ptr<Shape, ShapeOwner> OwnedShape;
+	
+	// @returns a shape built in the arena, to be disposed of as it needs
+	static OwnedShape inArena(Shape *s);
+	
+	// Adds a shape that read reads in. Unpacked, it's read into a copy of
+	// blank built in the arena, as ImgParser builds its shapes; packed,
+	// into blank itself, whose points the arrays then copy. A loader
+	// passes the same blank shape for every shape of its type.
+	// @param read reads into the Shape& it's given
+	template <typename Read>
+	void addRead(Shape &blank, Read read);
 	
-	// container for shape pointers: anything that extends Shape can be here
-	std::vector<Shape*> shapes;
+	// where shapes and their points are allocated: see Shape::clone(Arena&)
+	Arena arena;
+	// container for shape pointers: anything that extends Shape can be here.
+	// Copies are built in arena. Empty while packed.
+	std::vector<OwnedShape> shapes;
+	// the shapes while packed
+	ShapeArrays arrays;
+	// see setPacked
+	bool packed;
 	// Additional amount of space padding to insert to each shape. Helps printing good 
 	// output
 	unsigned int spaceLevel;
+	// what parseStl prints
+	LoadVerbosity loadVerbosity;
+	// whether draw fills shapes or outlines them
+	bool filled;
+	// see getRevision
+	unsigned long revision;
 	
 };
 
@@ -115,4 +256,23 @@ std::ostream& operator<<(std::ostream &os, const Image &o);
 std::istream& operator>>(std::istream &is, Image &o);
 
 
+template <typename T, typename... Args>
+void Image::emplace(Args&&... args)
+{
+	if (packed)
+	{
+		// the arrays copy it, so it needn't outlive the call
+		const T shape(std::forward<Args>(args)...);
+		arrays.add(shape);
+	}
+	else
+	{
+		OwnedShape shape = inArena(
+				new (arena.allocate<T>()) T(std::forward<Args>(args)...));
+		shapes.push_back(std::move(shape));
+	}
+	revision++;
+}
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,107 @@
+// @file ImgParser.h
+// Parser for the text image format written by Image::out, over an
+// in-memory buffer (normally a MappedFile). It makes a single pass over
+// the text and builds every shape directly, instead of reading each into
+// a temporary through operator>> and copying it.
+//
+// The grammar it accepts, with any whitespace between the parts:
+//   shape   := type '(' "color=" ["0x"] hex points ')'
+//   points  := "p1=[" x y z w "]'" { 'p' hex "=[" x y z w "]'" }
+//   meshes also take any number of "v=[" x y z "]'" and "f=[" i j k "]'"
+// where type is one of "pltcrgm". Points beyond p1 are numbered in hex, as
+// out writes them. Errors are reported with the line and column where
+// the text stops making sense.
+
+#ifndef IMG_PARSER_H
+#define IMG_PARSER_H
+
+#include "Image.h" // for imageException
+#include "ThreadPool.h"
+#include "Arena.h"
+#include <vector>
+#include <string>
+#include <cstddef>
+
+class ImgParser {
+public:
+	// Parses the shapes in [begin, end). Only whitespace may follow them.
+	// @param begin first character to parse
+	// @param end one past the last character to parse
+	// @param name what to call the text in error messages (a file name)
+	// @param shapes receives a shape for every shape parsed, in order.
+	//		  Nothing is added if an exception is thrown.
+	// @param arena where the shapes are built. The caller destroys them
+	//		  (see Shape::clone(Arena&)) before releasing it.
+	// @throws imageException naming the line and column of the first error
+	static void parse(const char* begin, const char* end,
+			const std::string &name, std::vector<Shape*> &shapes,
+			Arena &arena);
+	
+	// Same as parse, with the work spread over pool. The buffer is cut
+	// into chunks at lines starting a shape, and each chunk is parsed
+	// into its own list; the lists are joined in order. If several chunks
+	// fail, the error from the earliest one is thrown, which is the one
+	// parse would report. Buffers too small to be worth splitting are
+	// parsed on the calling thread. Each chunk is built in an arena of its
+	// own, which arena absorbs once all have parsed.
+	// @param pool the threads to parse with
+	static void parseParallel(const char* begin, const char* end,
+			const std::string &name, std::vector<Shape*> &shapes,
+			Arena &arena, ThreadPool &pool);
+
+private:
+	// Chunks smaller than this aren't worth a thread
+	static const size_t MIN_CHUNK_SIZE = 256*1024;
+	// Chunks per thread. More than one evens out chunks that parse slower.
+	static const unsigned int CHUNKS_PER_THREAD = 4;
+	
+	// The state of the tokenizer: a position within the buffer
+	struct Cursor
+	{
+		const char* begin;
+		const char* pos;
+		const char* end;
+		const std::string* name;
+	};
+
+	// Parses the shapes in [from, to), a part of the buffer starting at
+	// begin, which line and column numbers count from
+	static void parseRange(const char* begin, const char* from, 
+			const char* to, const std::string &name, 
+			std::vector<Shape*> &shapes, Arena &arena);
+	
+	// destroys shapes built in an arena, leaving their memory to it
+	static void destroy(const std::vector<Shape*> &shapes);
+	
+	// @returns the start of the first line at or after from which starts
+	//			a shape, or end if there is none
+	static const char* findShapeStart(const char* from, const char* end);
+
+	// moves past any whitespace (spaces, tabs, newlines)
+	static void skipSpace(Cursor &cur);
+
+	// Skips whitespace, then moves past text if it comes next
+	// @returns false, leaving cur after the whitespace, if it doesn't
+	static bool accept(Cursor &cur, const char* text);
+
+	// Same as accept, but it's an error if text doesn't come next
+	static void expect(Cursor &cur, const char* text);
+
+	// Reads a floating point number, after whitespace
+	static double parseNumber(Cursor &cur);
+
+	// Reads an unsigned number in the given base, after whitespace
+	static unsigned long parseUnsigned(Cursor &cur, int base);
+
+	// Reads one shape, the type character being next
+	// @param coords scratch space for the points, reused between shapes
+	// @returns the shape, built in arena
+	static Shape* parseShape(Cursor &cur, std::vector<double> &coords,
+			Arena &arena);
+
+	// @throws imageException saying what was expected at cur, with the
+	//		   line and column
+	[[noreturn]] static void fail(const Cursor &cur, const std::string &what);
+};
+
+#endif
@@ -22,6 +22,9 @@ public:
 	// It builds on top of the copy constructor of the shape class
 	Line(const Line &s);
 
+	// Copy constructor placing the copy's points in arena
+	Line(const Line &s, Arena &arena);
+
 	// This won't do anything, because the object contains Plain old data (POD).
 	// The default destructing will suffice.
 	virtual ~Line();
@@ -55,11 +58,17 @@ public:
 	// @throws shapeException if an invalid format to parse is passed
 	virtual void in(std::istream & is);
 
+	// @returns 'l', the character Lines are known by in files
+	virtual char getType() const;
+	
 	// the closest we get to a "virtual copy constructor"
 	// This will return a new'd copy of the current shape
 	// It's the responsibility of the caller to delete!
 	virtual Shape* clone() const;
 	
+	// Same as clone, but the copy and its points come from arena
+	virtual Shape* clone(Arena &arena) const;
+	
 };
 
 // global overloading of the stream insertion operator for the class
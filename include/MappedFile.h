@@ -0,0 +1,52 @@
+// @file MappedFile.h
+// Read-only view of a whole file through mmap. The contents are paged in
+// by the kernel on demand, so parsers can walk them like an in-memory
+// buffer without copying the file through a stream first.
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>	// for size_t
+#include <stdexcept>	// for std::runtime_error
+#include <string>
+
+// a helper class to bundle a message with any thrown exceptions.
+// To use, simply 'throw fileException("A descriptive message about
+// the problem")'.  This will throw the exception object by value.
+// Recommendation is to catch by reference (to prevent slicing).
+class fileException:public std::runtime_error
+{
+	public:
+		fileException(std::string message):
+		      std::runtime_error((std::string("File Exception: ") + 
+		               message).c_str()) {}
+};
+
+class MappedFile {
+public:
+	// Maps the whole file at path for reading
+	// @param path the file to map
+	// @throws fileException if the file can't be opened or mapped
+	MappedFile(const std::string &path);
+	
+	// Unmaps the file
+	~MappedFile();
+	
+	// A mapping can't be shared, so no copies
+	MappedFile(const MappedFile &m) = delete;
+	MappedFile& operator=(const MappedFile &rhs) = delete;
+	
+	// @returns the first byte of the file. NULL for an empty file.
+	const char* data() const;
+	
+	// @returns the size of the file in bytes
+	size_t size() const;
+	
+private:
+	// start of the mapping, NULL if the file is empty
+	char* base;
+	// length of the mapping in bytes
+	size_t length;
+};
+
+#endif
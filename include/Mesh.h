@@ -0,0 +1,207 @@
+// @file Mesh.h
+// This is a header file for the Mesh subclass of the Shape abstract class
+// A Mesh holds a whole triangle model (an STL file, for example) as one shape:
+// its vertices live in contiguous x/y/z arrays and its facets are triples of
+// indices into them, instead of one heap allocated Triangle per facet.
+// It also contains global overloads of operator<< and operator>> for the class
+
+#ifndef MESH_H
+#define MESH_H
+
+#include "Shape.h"
+#include "ThreadPool.h"
+#include <vector>
+#include <memory>
+
+class Mesh : public Shape {
+	
+	// vertex coordinates, structure-of-arrays. Vertex i is 
+	// (vertX[i], vertY[i], vertZ[i]) relative to p1, the mesh's origin.
+	// Single precision is all STL carries, and halves the footprint.
+	std::vector<float> vertX, vertY, vertZ;
+	
+	// three vertex indices per facet
+	std::vector<unsigned int> facetIndices;
+	
+	// The vertices as last converted, so that drawing the same view again
+	// (or drawing it filled after drawing it as a wireframe) doesn't
+	// convert them again. Every vertex is converted once per view.
+	struct TransformCache
+	{
+		// ViewContext::getRevision of the view converted to
+		unsigned long revision;
+		// the vertices in model, clip and device coordinates
+		matrix modelPts, clipPts, devPts;
+		// ViewContext::outcode of every vertex
+		std::vector<unsigned int> outcodes;
+		
+		TransformCache(const matrix &modelPts);
+	};
+	
+	// null until the mesh is first drawn, and whenever the vertices
+	// change
+	mutable std::unique_ptr<TransformCache> cache;
+	
+	// @returns every vertex as a column of a 4xn matrix in model
+	//			coordinates, ready to be converted by a ViewContext
+	matrix modelPoints() const;
+	
+	// @returns the vertices converted by vc, converting them only if
+	//			they haven't been converted by its current transform.
+	//			There must be at least one vertex.
+	const TransformCache& transformed(const ViewContext *vc) const;
+	
+	// Decides whether the facet starting at facetIndices[f] is drawn:
+	// it's not if it's wholly outside the view or faces away with
+	// backface culling on. Counts the facet into vc's CullStats.
+	// @param points the vertices converted by vc
+	bool isFacetVisible(ViewContext *vc, const TransformCache &points, 
+			unsigned int f) const;
+	
+public:
+	
+	// An empty mesh, with its origin (p1) at the model origin
+	// @param color RGB representation of the color of the shape, each color is a byte.
+	//		  STL files carry no color, so it has the same default as Triangle.
+	Mesh(int color=GraphicsContext::CYAN);
+	
+	// Copy constructor for the Mesh class
+	// It builds on top of the copy constructor of the shape class
+	Mesh(const Mesh &s);
+
+	// Copy constructor placing the copy's points in arena
+	Mesh(const Mesh &s, Arena &arena);
+
+	// The vertex and index arrays clean up after themselves.
+	virtual ~Mesh();
+
+	// assignment operator. Makes sure to build on the Shape's assignment
+	// operator.
+	Mesh& operator=(const Mesh& rhs);
+	
+	// Preallocates storage, so loaders that know their counts up front
+	// (STL files) fill the arrays without regrowing them
+	// @param numVertices expected number of vertices
+	// @param numFacets expected number of facets
+	void reserve(unsigned int numVertices, unsigned int numFacets);
+	
+	// Appends a vertex
+	// @params (x,y,z) coordinates of the vertex, relative to p1
+	// @returns the index of the new vertex, for use with addFacet
+	unsigned int addVertex(double x, double y, double z);
+	
+	// Appends a triangular facet
+	// @params (v0,v1,v2) indices of previously added vertices
+	// @throws shapeException if an index does not name a vertex
+	void addFacet(unsigned int v0, unsigned int v1, unsigned int v2);
+	
+	// Merges vertices that are at the same place, so facets meeting there
+	// share one vertex. STL stores each facet's corners separately, so
+	// this makes each vertex of a loaded model be converted once rather
+	// than once per facet around it.
+	// Only vertices with exactly the same coordinates are merged: STL
+	// repeats a shared corner bit for bit, and vertices that merely lie
+	// close together may well be meant to be apart. The geometry doesn't
+	// change, and no facet is removed.
+	// @returns the number of vertices removed
+	unsigned int weld();
+	
+	// Appends the vertices and facets of other, renumbering its facets to
+	// the new vertex positions. other's vertices are copied as they are, so
+	// both meshes should share an origin.
+	// @param other the mesh to append
+	void append(const Mesh &other);
+	
+	// Same as appending each of parts in order, but sizes the arrays once
+	// and copies the parts in parallel on pool
+	// @param parts the meshes to append, in order
+	// @param pool the threads to copy with
+	void append(const std::vector<Mesh> &parts, ThreadPool &pool);
+	
+	// Finds the axis-aligned box around all vertices, relative to p1.
+	// The mesh must have at least one vertex.
+	// @param low receives the smallest x, y and z
+	// @param high receives the largest x, y and z
+	void getBounds(double low[3], double high[3]) const;
+	
+	// The box around the vertices, in model coordinates
+	// @returns false if there are no vertices
+	virtual bool getModelBounds(double low[3], double high[3]) const;
+	
+	// @returns the number of vertices in the mesh
+	unsigned int getNumVertices() const;
+	
+	// @returns the number of facets in the mesh
+	unsigned int getNumFacets() const;
+	
+	// This sets the GraphicsContext color to the shape's color and draws the
+	// edges of every facet. All vertices are converted to device coordinates
+	// with a single batched call to the ViewContext. Facets out of view, or
+	// facing away if the ViewContext culls those, are skipped.
+	virtual void draw(GraphicsContext *gc, ViewContext *vc) const;
+	
+	// Fills every facet, each flat shaded by how directly it faces the
+	// viewer. Facets hide each other through the depth buffer, so they
+	// can be drawn in any order.
+	virtual void fill(GraphicsContext *gc, ViewContext *vc) const;
+
+	// This implementation extends on the output of the Shape class by 
+	// listing the vertices and then the facets.
+	// Output Format: 
+	// "m(color=<RGB_int> p1=[<x1> <y1> <z1> <a1>]'
+	//                    v=[<x> <y> <z>]'
+	//                    ...
+	//                    f=[<v0> <v1> <v2>]'
+	//                    ...)"
+	// @param os The output stream to insert into to
+	virtual void out(std::ostream & os) const;
+	
+	// Reads a mesh in the format written by out. Any previous vertices and
+	// facets are discarded.
+	// Having the shape specifier at the start is optional.
+	// @throws shapeException if the format is invalid to parse
+	// @param is The input stream to parse from
+	virtual void in(std::istream & is);
+
+	// Saves the vertex and index arrays as they are in memory, after the
+	// origin, so loading copies them back in bulk
+	virtual void outBinary(SceneFile::Writer &writer) const;
+	
+	// Reads a mesh written by outBinary. Any previous vertices and facets
+	// are discarded.
+	// @throws shapeException if a facet names a vertex that isn't there
+	virtual void inBinary(SceneFile::Reader &reader, 
+			const SceneFile::Record &record);
+	
+	// @returns 'm', the character Meshes are known by in files
+	virtual char getType() const;
+	
+	// the closest we get to a "virtual copy constructor"
+	// This will return a new'd copy of the current shape
+	// It's the responsibility of the caller to delete!
+	virtual Shape* clone() const;
+	
+	// Same as clone, but the copy and its points come from arena
+	virtual Shape* clone(Arena &arena) const;
+	
+	// @returns true: the vertices and facets are never in an arena
+	virtual bool ownsMemory() const;
+	
+};
+
+// global overloading of the stream insertion operator for the class
+// utilizes Mesh::out to generate the output
+// @param os output stream to the left of the << operator
+// @param o  Mesh shape object to insert the output of into os
+// @return os to allow for chaining 
+std::ostream& operator<<(std::ostream &os, const Mesh &o);
+
+// global overloading of the stream extraction operator for the class
+// utilizes Mesh::in to generate the input
+// @param is input stream to the left of the >> operator
+// @param o  Mesh shape object to parse into
+// @return is to allow for chaining
+std::istream& operator>>(std::istream &is, Mesh &o);
+
+
+#endif
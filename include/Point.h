@@ -20,6 +20,9 @@ public:
 	// It builds on top of the copy constructor of the shape class
 	Point(const Point &s);
 
+	// Copy constructor placing the copy's points in arena
+	Point(const Point &s, Arena &arena);
+
 	// This won't do anything, because the Point object contains POD.
 	// The default destructing will suffice.
 	virtual ~Point();
@@ -49,11 +52,17 @@ public:
 	// @throws shapeException if the format is invalid
 	virtual void in(std::istream & is);
 
+	// @returns 'p', the character Points are known by in files
+	virtual char getType() const;
+	
 	// the closest we get to a "virtual copy constructor"
 	// This will return a new'd copy of the current shape
 	// It's the responsibility of the caller to delete!
 	virtual Shape* clone() const;
 	
+	// Same as clone, but the copy and its points come from arena
+	virtual Shape* clone(Arena &arena) const;
+	
 };
 
 // global overloading of the stream insertion operator for the Point class
@@ -49,6 +49,9 @@ public:
 	// It builds on top of the copy constructor of the shape class
 	Polygon(const Polygon &s);
 
+	// Copy constructor placing the copy's points in arena
+	Polygon(const Polygon &s, Arena &arena);
+
 	// This won't do anything, because the object contains Plain old data (POD).
 	// The default destructing will suffice.
 	virtual ~Polygon();
@@ -63,10 +66,18 @@ public:
 	
 	// This sets the GraphicsContext color to the shape's color 
 	// and draws the Polygon by drawing n segments using the GraphicsContext pointer
-	// and ViewContext pointer
-	// @throws shapeException if numColumns < 3. 
-	// A (non-degenerate) polygon needs to AT LEAST be a triangle
+	// and ViewContext pointer. Polygons of fewer than 3 points are drawn
+	// the same way: a line there and back, or a single point.
 	virtual void draw(GraphicsContext *gc, ViewContext *vc) const;
+	
+	// Fills the Polygon as a fan of triangles around its first vertex,
+	// shaded by how directly each faces the viewer. This is only correct
+	// for convex polygons. Polygons of fewer than 3 points have nothing
+	// to fill, and are drawn as draw does, like lines are.
+	virtual void fill(GraphicsContext *gc, ViewContext *vc) const;
+	
+	// The box around the polygon's vertices, ignoring spare capacity
+	virtual bool getModelBounds(double low[3], double high[3]) const;
 
 	// This implementation extends on the output of the Shape class 
 	// by specifying the shape type,
@@ -92,11 +103,25 @@ public:
 	// @param is The input stream to parse from
 	virtual void in(std::istream & is);
 
+	// @returns the points in use, not the spare capacity, which is also
+	//			all that outBinary saves
+	virtual unsigned int getNumPoints() const;
+	
+	// Reads any number of points, as in does
+	virtual void inBinary(SceneFile::Reader &reader, 
+			const SceneFile::Record &record);
+	
+	// @returns 'g', the character Polygons are known by in files
+	virtual char getType() const;
+	
 	// the closest we get to a "virtual copy constructor"
 	// This will return a new'd copy of the current shape
 	// It's the responsibility of the caller to delete!
 	virtual Shape* clone() const;
 	
+	// Same as clone, but the copy and its points come from arena
+	virtual Shape* clone(Arena &arena) const;
+	
 };
 
 // global overloading of the stream insertion operator for the class
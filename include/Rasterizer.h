@@ -0,0 +1,276 @@
+// @file Rasterizer.h
+// Scan conversion of filled triangles with hidden surface removal.
+// Triangles are given in device coordinates, with the depth ViewContext
+// keeps in z (larger is nearer the viewer). The rasterizer owns the depth
+// buffer; the pixels themselves are written by the caller, which is handed
+// runs of visible pixels, so every GraphicsContext can store them its own
+// way.
+//
+// Coverage is decided with the three edge functions of the triangle,
+// evaluated in fixed point with 4 bits of subpixel precision. The bounding
+// box of the triangle is walked in 8x8 tiles, each row of tiles narrowed to
+// the triangle's extent along it. Tiles entirely outside an edge are
+// skipped, tiles entirely inside skip the edge tests, and within a tile the
+// edge functions are stepped incrementally with adds.
+// Pixels on an edge shared by two triangles belong to exactly one of them.
+//
+// A rasterizer may cover only part of the device (a tile of it). Coverage
+// and depth of a pixel don't depend on which part is being drawn, so tiles
+// drawn separately fit together exactly.
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm> // for std::min/std::max/std::swap
+#include <stdint.h>
+
+class Rasterizer {
+public:
+	// bits of subpixel precision of the vertex positions
+	static const int SUBPIXEL_BITS = 4;
+	// width and height of the blocks the bounding box is walked in
+	static const int TILE_SIZE = 8;
+	// Triangles reaching further than this many pixels from the origin
+	// are not drawn, which keeps the fixed point math from overflowing
+	static const int MAX_COORD = 1 << 20;
+
+	// An empty rasterizer. Nothing is drawn until it's given a size.
+	Rasterizer();
+
+	// Sets the area drawn into and clears the depth buffer. Nothing
+	// outside it is drawn.
+	// @params (width, height) size in pixels
+	// @params (originX, originY) device coordinates of its top left pixel
+	void resize(int width, int height, int originX = 0, int originY = 0);
+
+	// @returns the width of the area drawn into
+	int getWidth() const;
+
+	// @returns the height of the area drawn into
+	int getHeight() const;
+
+	// Forgets everything drawn, so the next triangles are all in front
+	void clearDepth();
+
+	// Fills a triangle, hiding the parts behind anything already filled
+	// since clearDepth, and records its depth. Either winding is accepted.
+	// @params (x0,y0,z0) ... (x2,y2,z2) the device coordinates of the corners
+	// @param span called as span(y, xBegin, xEnd) for every run of visible
+	//		  pixels [xBegin, xEnd) on row y, to write them
+	template <typename SpanFunc>
+	void fillTriangle(double x0, double y0, double z0,
+			double x1, double y1, double z1,
+			double x2, double y2, double z2, SpanFunc span);
+
+private:
+	// one edge function, E(x,y) = a*x + b*y + c in subpixel units,
+	// biased so that E >= 0 exactly for pixels the edge owns
+	struct Edge
+	{
+		int64_t a, b, c;
+
+		void setup(int64_t x0, int64_t y0, int64_t x1, int64_t y1)
+		{
+			a = y0 - y1;
+			b = x1 - x0;
+			c = -(a*x0 + b*y0);
+			// top-left rule: of the two triangles sharing an edge (which
+			// walk it in opposite directions) only one gets the pixels on it
+			if (!(a > 0 || (a == 0 && b > 0)))
+			{
+				c -= 1;
+			}
+		}
+
+		// evaluated at the center of pixel (x, y)
+		int64_t at(int x, int y) const
+		{
+			return (a*x + b*y) * (1 << SUBPIXEL_BITS) + c;
+		}
+	};
+
+	int width;
+	int height;
+	int originX;
+	int originY;
+	// one depth per pixel, row by row
+	std::vector<float> depth;
+};
+
+template <typename SpanFunc>
+void Rasterizer::fillTriangle(double x0, double y0, double z0,
+		double x1, double y1, double z1,
+		double x2, double y2, double z2, SpanFunc span)
+{
+	// anything non-finite or absurdly far off is skipped outright
+	const double limit = MAX_COORD;
+	if (!(std::fabs(x0) < limit && std::fabs(y0) < limit &&
+			std::fabs(x1) < limit && std::fabs(y1) < limit &&
+			std::fabs(x2) < limit && std::fabs(y2) < limit))
+	{
+		return;
+	}
+
+	// snap to the subpixel grid
+	const double one = 1 << SUBPIXEL_BITS;
+	int64_t fx0 = std::lround(x0*one), fy0 = std::lround(y0*one);
+	int64_t fx1 = std::lround(x1*one), fy1 = std::lround(y1*one);
+	int64_t fx2 = std::lround(x2*one), fy2 = std::lround(y2*one);
+
+	// twice the signed area. Make it positive, so that inside is
+	// where all edge functions are positive.
+	int64_t area = (fx1 - fx0)*(fy2 - fy0) - (fy1 - fy0)*(fx2 - fx0);
+	if (area == 0)
+	{
+		return;
+	}
+	if (area < 0)
+	{
+		std::swap(fx1, fx2);
+		std::swap(fy1, fy2);
+		std::swap(z1, z2);
+		area = -area;
+	}
+
+	Edge e0, e1, e2;
+	e0.setup(fx1, fy1, fx2, fy2);
+	e1.setup(fx2, fy2, fx0, fy0);
+	e2.setup(fx0, fy0, fx1, fy1);
+
+	// depth is linear in device x and y: z = z0 + dzdx*(x-x0) + dzdy*(y-y0).
+	// It's evaluated afresh at every pixel rather than stepped, so the
+	// result doesn't depend on where the walk started.
+	double ax = (fx1 - fx0)/one, ay = (fy1 - fy0)/one;
+	double bx = (fx2 - fx0)/one, by = (fy2 - fy0)/one;
+	double det = ax*by - ay*bx;
+	double dzdx = ((z1 - z0)*by - (z2 - z0)*ay) / det;
+	double dzdy = ((z2 - z0)*ax - (z1 - z0)*bx) / det;
+	double zOrigin = z0 - dzdx*(fx0/one) - dzdy*(fy0/one);
+
+	// bounding box, in whole pixels, clipped to the drawing area
+	int minX = (int)((std::min(fx0, std::min(fx1, fx2)) + (int64_t)one - 1) >> SUBPIXEL_BITS);
+	int minY = (int)((std::min(fy0, std::min(fy1, fy2)) + (int64_t)one - 1) >> SUBPIXEL_BITS);
+	int maxX = (int)(std::max(fx0, std::max(fx1, fx2)) >> SUBPIXEL_BITS);
+	int maxY = (int)(std::max(fy0, std::max(fy1, fy2)) >> SUBPIXEL_BITS);
+	minX = std::max(minX, originX);
+	minY = std::max(minY, originY);
+	maxX = std::min(maxX, originX + width - 1);
+	maxY = std::min(maxY, originY + height - 1);
+
+	// the change in each edge function per pixel
+	const int64_t unit = 1 << SUBPIXEL_BITS;
+	const int64_t stepX0 = e0.a*unit, stepY0 = e0.b*unit;
+	const int64_t stepX1 = e1.a*unit, stepY1 = e1.b*unit;
+	const int64_t stepX2 = e2.a*unit, stepY2 = e2.b*unit;
+
+	const Edge* edges[3] = {&e0, &e1, &e2};
+	for (int tileY = minY; tileY <= maxY; tileY += TILE_SIZE)
+	{
+		int lastY = std::min(tileY + TILE_SIZE - 1, maxY);
+
+		// Narrow the row of tiles to where the triangle is. Each sloped edge
+		// bounds x on one side, and over the rows of the strip that bound is
+		// furthest out at the first or last row. Long thin triangles would
+		// otherwise walk mostly empty tiles across their whole bounding box.
+		double left = minX, right = maxX;
+		for (int e=0; e<3; e++)
+		{
+			const Edge& edge = *edges[e];
+			if (edge.a == 0)
+			{
+				continue;
+			}
+			// E >= 0 where a*x >= -(b*y + c/unit)
+			double top = -(edge.b*(double)tileY + edge.c/one) / edge.a;
+			double bottom = -(edge.b*(double)lastY + edge.c/one) / edge.a;
+			if (edge.a > 0)
+			{
+				left = std::max(left, std::floor(std::min(top, bottom)) - 1);
+			}
+			else
+			{
+				right = std::min(right, std::ceil(std::max(top, bottom)) + 1);
+			}
+		}
+		if (left > right)
+		{
+			continue;
+		}
+		for (int tileX = (int)left; tileX <= (int)right; tileX += TILE_SIZE)
+		{
+			int lastX = std::min(tileX + TILE_SIZE - 1, (int)right);
+
+			// The edge functions are linear, so over the tile they're
+			// extreme at its corners. All corners outside one edge: the
+			// tile misses the triangle. All inside every edge: it's covered.
+			bool covered = true;
+			bool missed = false;
+			for (int e=0; e<3 && !missed; e++)
+			{
+				int64_t c00 = edges[e]->at(tileX, tileY);
+				int64_t c10 = edges[e]->at(lastX, tileY);
+				int64_t c01 = edges[e]->at(tileX, lastY);
+				int64_t c11 = edges[e]->at(lastX, lastY);
+				if (c00 < 0 && c10 < 0 && c01 < 0 && c11 < 0)
+				{
+					missed = true;
+				}
+				if (c00 < 0 || c10 < 0 || c01 < 0 || c11 < 0)
+				{
+					covered = false;
+				}
+			}
+			if (missed)
+			{
+				continue;
+			}
+
+			int64_t row0 = e0.at(tileX, tileY);
+			int64_t row1 = e1.at(tileX, tileY);
+			int64_t row2 = e2.at(tileX, tileY);
+			for (int y = tileY; y <= lastY; y++)
+			{
+				int64_t w0 = row0, w1 = row1, w2 = row2;
+				double rowZ = zOrigin + dzdy*y;
+				float* rowDepth = depth.data() + (y - originY)*width;
+				int runStart = -1;
+				for (int x = tileX; x <= lastX; x++)
+				{
+					bool visible = false;
+					if (covered || (w0 | w1 | w2) >= 0)
+					{
+						float pixelZ = (float)(rowZ + dzdx*x);
+						if (pixelZ > rowDepth[x - originX])
+						{
+							rowDepth[x - originX] = pixelZ;
+							visible = true;
+						}
+					}
+					if (visible && runStart < 0)
+					{
+						runStart = x;
+					}
+					else if (!visible && runStart >= 0)
+					{
+						span(y, runStart, x);
+						runStart = -1;
+					}
+					w0 += stepX0;
+					w1 += stepX1;
+					w2 += stepX2;
+				}
+				if (runStart >= 0)
+				{
+					span(y, runStart, lastX + 1);
+				}
+				row0 += stepY0;
+				row1 += stepY1;
+				row2 += stepY2;
+			}
+		}
+	}
+}
+
+#endif
@@ -32,6 +32,9 @@ public:
 	// It builds on top of the copy constructor of the shape class
 	Rectangle(const Rectangle &s);
 
+	// Copy constructor placing the copy's points in arena
+	Rectangle(const Rectangle &s, Arena &arena);
+
 	// This won't do anything, because the object contains Plain old data (POD).
 	// The default destructing will suffice.
 	virtual ~Rectangle();
@@ -44,6 +47,10 @@ public:
 	// and draws the Rectangle by drawing 4 segments using the GraphicsContext pointer
 	// and ViewContext pointer
 	virtual void draw(GraphicsContext *gc, ViewContext *vc) const;
+	
+	// Fills the Rectangle as two triangles, shaded by how directly it
+	// faces the viewer
+	virtual void fill(GraphicsContext *gc, ViewContext *vc) const;
 
 	// This implementation extends on the output of the Shape class by specifying 
 	// the shape type,
@@ -69,11 +76,17 @@ public:
 	// @param is The input stream to parse from
 	virtual void in(std::istream & is);
 
+	// @returns 'r', the character Rectangles are known by in files
+	virtual char getType() const;
+	
 	// the closest we get to a "virtual copy constructor"
 	// This will return a new'd copy of the current shape
 	// It's the responsibility of the caller to delete!
 	virtual Shape* clone() const;
 	
+	// Same as clone, but the copy and its points come from arena
+	virtual Shape* clone(Arena &arena) const;
+	
 };
 
 // global overloading of the stream insertion operator for the class
@@ -0,0 +1,181 @@
+// @file SceneFile.h
+// The binary image format: a compact alternative to the text format of
+// Image::out, for saving and loading scenes with large models quickly.
+//
+// A file starts with a Header: the magic "IMGB", the format version, flags
+// and the number of shapes of each type. The payload follows, a record per
+// shape. A record is a Record header followed by the shape's arrays, each
+// padded to a multiple of 8 bytes:
+//   numPoints points of 4 doubles (x, y, z, w), the columns of its pts
+//   numVertices floats each of x, y and z (meshes only)
+//   numFacets triples of uint32 vertex indices (meshes only)
+// Everything is stored as little-endian machines hold it in memory, so
+// uncompressed files are read straight out of a MappedFile: loading a
+// mesh copies its arrays in bulk instead of parsing numbers.
+//
+// With the COMPRESSED flag the payload is cut into blocks of BLOCK_SIZE
+// bytes, each compressed on its own with a byte-oriented LZ77 scheme, so
+// blocks are compressed and decompressed in parallel. The header is
+// then followed by the number of blocks, a BlockInfo per block and the
+// blocks themselves. A block that doesn't get smaller is stored as is.
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "matrix.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+class SceneFile {
+public:
+	// the first bytes of every binary image file
+	static const char MAGIC[4];
+	// the version written, and the only one read
+	static const uint16_t VERSION = 1;
+	// Header::flags: the payload is compressed in blocks
+	static const uint16_t COMPRESSED = 1;
+	// bytes of payload per compressed block
+	static constexpr size_t BLOCK_SIZE = 1 << 20;
+	// the shape types, by the character the text format gives them;
+	// Header::typeCounts is in this order
+	static const char TYPES[];
+	static const int NUM_TYPES = 7;
+
+	struct Header
+	{
+		char magic[4];
+		uint16_t version;
+		uint16_t flags;
+		uint32_t numShapes;
+		// number of shapes of each of TYPES
+		uint32_t typeCounts[NUM_TYPES];
+		// size of the payload, uncompressed
+		uint64_t payloadSize;
+	};
+
+	// the start of every shape record
+	struct Record
+	{
+		// the shape's type, one of TYPES
+		char type;
+		char reserved[3];
+		uint32_t color;
+		uint32_t numPoints;
+		uint32_t numVertices;
+		uint32_t numFacets;
+		uint32_t reserved2;
+	};
+
+	// where a compressed block's bytes are
+	struct BlockInfo
+	{
+		// bytes of payload it holds
+		uint32_t rawSize;
+		// bytes it takes up in the file. Equal to rawSize if stored
+		// uncompressed.
+		uint32_t storedSize;
+	};
+
+	// Appends shape records to a payload
+	class Writer {
+	public:
+		// @param payload where records are appended
+		Writer(std::string &payload);
+
+		// Starts a record. Shapes without vertices or facets need only
+		// write the points, which this does.
+		// @param pts the shape's points, a column each
+		// @param numPoints how many columns of pts are written
+		void record(char type, unsigned int color, const matrix &pts,
+				unsigned int numPoints, unsigned int numVertices = 0,
+				unsigned int numFacets = 0);
+
+		// Appends an array of the record, padded
+		// @param data the array
+		// @param bytes its size in bytes
+		void array(const void* data, size_t bytes);
+
+	private:
+		std::string &payload;
+	};
+
+	// Walks the records of a payload. Nothing is copied until a shape
+	// asks for its arrays.
+	class Reader {
+	public:
+		// @params [begin, end) the payload
+		Reader(const char* begin, const char* end);
+
+		// @returns true if there are records left
+		bool more() const;
+
+		// @returns the number of bytes of payload left. Shapes check the
+		//			arrays of a record fit in them before making room.
+		size_t remaining() const;
+
+		// Moves on to the next record
+		// @returns its header
+		// @throws fileException if the payload ends within it
+		const Record& next();
+
+		// Copies the next array of the record
+		// @param target receives it
+		// @param bytes its size in bytes
+		// @throws fileException if the payload ends within it
+		void array(void* target, size_t bytes);
+
+		// Copies the record's points into the first numPoints columns
+		// of pts, which must have that many
+		// @throws fileException if the payload ends within them
+		void points(matrix &pts, unsigned int numPoints);
+
+	private:
+		const char* position;
+		const char* end;
+		Record current;
+	};
+
+	// @returns true if the buffer holds a binary image file
+	static bool isBinary(const char* data, size_t size);
+
+	// @returns the index of a shape type in TYPES, NUM_TYPES if it's
+	//			not one
+	static int typeIndex(char type);
+
+	// Writes a binary image file
+	// @param os where to write it, opened in binary mode
+	// @param header the header, but for magic, version, flags and
+	//		  payloadSize, which this fills in
+	// @param payload the records
+	// @param compress whether to compress the payload
+	static void write(std::ostream &os, Header header,
+			const std::string &payload, bool compress);
+
+	// Finds the payload of a binary image file, decompressing it if it's
+	// compressed
+	// @param data contents of the file
+	// @param size number of bytes in data
+	// @param header receives the file's header
+	// @param storage holds the payload if it had to be decompressed
+	// @returns the payload: in data, or in storage
+	// @throws fileException if the file is not a binary image file of
+	//		   this version, or is damaged
+	static const char* read(const char* data, size_t size, Header &header,
+			std::vector<char> &storage);
+
+	// Compresses a block
+	// @params [data, data+size) the bytes to compress
+	// @param out where the compressed bytes are appended
+	static void compressBlock(const char* data, size_t size, std::string &out);
+
+	// Decompresses a block made by compressBlock
+	// @params [data, data+size) the compressed bytes
+	// @params [out, out+outSize) receives the bytes, which must fill it
+	// @throws fileException if the block is damaged
+	static void decompressBlock(const char* data, size_t size, char* out,
+			size_t outSize);
+};
+
+#endif
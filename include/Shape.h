@@ -11,6 +11,8 @@
 #include "matrix.h"
 #include "x11context.h"
 #include "ViewContext.h"
+#include "SceneFile.h"
+#include "Arena.h"
 
 #include <stdexcept>	// for std::runtime_error
  
@@ -28,6 +30,12 @@ class shapeException:public std::runtime_error
 
 class Shape {
 	
+	// builds shapes straight from the text format, points and all
+	friend class ImgParser;
+	// stores shapes in per-type arrays, and draws them with the helpers
+	// below
+	friend class ShapeArrays;
+	
 protected:
 	// RGB representation of the color of the shape
 	int color;
@@ -50,6 +58,40 @@ protected:
 	// expected to be accounted for.
 	unsigned int spaceLevel;
 	
+	// Fraction of its color a surface shows when seen edge-on. Surfaces
+	// facing the viewer show all of it.
+	static constexpr double AMBIENT = 0.25;
+	
+	// Draws one edge of the shape in the current color. An edge reaching
+	// behind the near plane or far off the device is clipped first.
+	// @param clipPts points of the shape in clip coordinates
+	// @param devPts the same points in device coordinates
+	// @params (a,b) the columns holding the ends of the edge
+	static void drawEdge(GraphicsContext *gc, const ViewContext *vc,
+			const matrix &clipPts, const matrix &devPts,
+			unsigned int a, unsigned int b);
+	
+	// Fills one triangle of a shape in its color, flat shaded by how
+	// directly the triangle faces the viewer. A triangle reaching behind
+	// the near plane or far off the device is clipped first.
+	// @param modelPts points of the shape in model coordinates (4xn)
+	// @param clipPts the same points in clip coordinates
+	// @param devPts the same points in device coordinates
+	// @params (a,b,c) the columns holding the corners of the triangle
+	// @param color the shape's color, fully lit
+	static void fillFacet(GraphicsContext *gc, const ViewContext *vc, 
+			const matrix &modelPts, const matrix &clipPts, 
+			const matrix &devPts,
+			unsigned int a, unsigned int b, unsigned int c, int color);
+	
+	// The same, for a triangle whose normal in model coordinates is known
+	// already: ShapeArrays keeps its model points in arrays, not a matrix
+	// @params (nx,ny,nz) the normal, of any length
+	static void fillFacet(GraphicsContext *gc, const ViewContext *vc, 
+			double nx, double ny, double nz, const matrix &clipPts, 
+			const matrix &devPts,
+			unsigned int a, unsigned int b, unsigned int c, int color);
+	
 public:
 	// a shape will have at least one point: the origin 
 	// @params (x,y,z) coordinates of the shape
@@ -60,6 +102,10 @@ public:
 	// Will copy the color and single point
 	Shape(const Shape &s);
 	
+	// Copy constructor putting the copy's points in arena instead of the
+	// heap, for clone(Arena&)
+	Shape(const Shape &s, Arena &arena);
+	
 	// virtual destructor must be present and defined, even if it does nothing
 	virtual ~Shape();
 	
@@ -77,6 +123,19 @@ public:
 	// device coordinates.
 	virtual void draw(GraphicsContext *gc, ViewContext *vc) const = 0;
 	
+	// Draws the shape as a solid surface, hidden where something nearer
+	// was filled first (see GraphicsContext::fillTriangle). Shapes without
+	// an area to fill are drawn as usual, which is the default.
+	virtual void fill(GraphicsContext *gc, ViewContext *vc) const;
+	
+	// Finds the axis-aligned box around the shape in model coordinates,
+	// for culling shapes that are out of view. The default is the box
+	// around all of pts.
+	// @param low receives the smallest x, y and z
+	// @param high receives the largest x, y and z
+	// @returns false if the shape has no such box, and is never culled
+	virtual bool getModelBounds(double low[3], double high[3]) const;
+	
 	// the amoount of space padding to put in a second line when outputting to a 
 	// stream
 	void setSpaceLevel(unsigned int spaceLevel);
@@ -99,11 +158,44 @@ public:
 	// @throws shapeException for invalid format
 	virtual void in(std::istream & is);
 	
+	// Appends the shape as a record of a binary image (see SceneFile.h).
+	// The default writes the type, color and every column of pts; derived
+	// classes with more data to save override it.
+	// @param writer the payload to append to
+	virtual void outBinary(SceneFile::Writer &writer) const;
+	
+	// Reads the shape back from a record written by outBinary. The
+	// default reads the color and points of shapes with a fixed number.
+	// @param reader the payload, just past the record's header
+	// @param record the record's header, which is of this shape's type
+	// @throws shapeException if the record doesn't describe such a shape
+	// @throws fileException if the payload ends within the record
+	virtual void inBinary(SceneFile::Reader &reader, 
+			const SceneFile::Record &record);
+	
+	// @returns the number of points the shape is made of: the columns of
+	//			pts, unless a derived class keeps spare ones
+	virtual unsigned int getNumPoints() const;
+	
+	// @returns the character the shape's type is known by in files: the
+	//			text format starts the shape with it
+	virtual char getType() const = 0;
+	
 	// the closest we get to a "virtual copy constructor"
 	// This will return a new'd copy of the current shape
 	// It's the responsibility of the caller to delete!
 	virtual Shape* clone() const = 0;
 	
+	// Same as clone, but the copy and its points are allocated from arena.
+	// The copy must not be deleted: it's destroyed by calling its
+	// destructor, and its memory is given back with the arena's.
+	virtual Shape* clone(Arena &arena) const = 0;
+	
+	// @returns true if the shape holds memory outside any arena, which
+	//			its destructor frees. A copy in an arena that doesn't
+	//			needn't be destroyed at all. The default checks pts.
+	virtual bool ownsMemory() const;
+	
 };
 
 // global overloading of the stream insertion operator for the Shape class
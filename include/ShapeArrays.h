@@ -0,0 +1,189 @@
+// @file ShapeArrays.h
+// Storage for the shapes of a packed Image (see Image::setPacked). Instead
+// of a heap allocated Shape per shape, each with its own heap allocated
+// matrix, the shapes of each type share contiguous arrays: a color per
+// shape, and the x, y, z and w of all their points, a row each. Drawing
+// walks a type's arrays in a loop of its own, with the type's points all
+// converted in one batched call to the ViewContext, and no pointer to
+// follow or virtual call to make per shape.
+// Meshes keep their vertices in arrays already, so they're stored whole.
+// Shapes are still edited as Shape objects: get hands out a copy of one,
+// and set stores it back.
+
+#ifndef SHAPE_ARRAYS_H
+#define SHAPE_ARRAYS_H
+
+#include "Shape.h"
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+class ShapeArrays {
+public:
+	// no shapes
+	ShapeArrays();
+
+	// Copy constructor -- deep-copies the arrays and meshes of s
+	ShapeArrays(const ShapeArrays &s);
+
+	// deletes the meshes
+	~ShapeArrays();
+
+	// Deep-copies the shapes of rhs in place of these
+	ShapeArrays& operator=(const ShapeArrays &rhs);
+
+	// Appends a copy of a shape
+	// @param s the shape, of any type
+	void add(const Shape &s);
+	
+	// Appends a shape, taking it over. Meshes are kept as they are; other
+	// shapes are copied into the arrays, and s deleted.
+	void add(std::unique_ptr<Shape> s);
+	
+	// Makes room for n shapes in all, of whatever types
+	void reserve(size_t n);
+	
+	// Makes room in a type's arrays for a bulk load of its shapes
+	// @param type one of SceneFile::TYPES
+	// @param count how many more shapes of the type there will be
+	// @param numPoints polygons only: how many points those have in all.
+	//		  The other types have a fixed number.
+	void reserve(char type, size_t count, size_t numPoints = 0);
+
+	// @returns the number of shapes held
+	size_t size() const;
+
+	// @returns a new'd copy of the i-th shape added, for editing or
+	//			output. It's the responsibility of the caller to delete!
+	// @throws shapeException if there is no such shape
+	Shape* get(size_t i) const;
+
+	// Replaces the i-th shape added with a copy of s, which may be of
+	// another type. It keeps its place among the shapes of its type.
+	// A shape of the same type and size is overwritten in place; other
+	// edits move the points after it in its batch, and a change of type
+	// renumbers the shapes after it too, in one pass: O(n).
+	// @throws shapeException if there is no such shape
+	void set(size_t i, const Shape &s);
+
+	// removes all shapes
+	void clear();
+
+	// Draws every shape, or fills it if filled is set, as the shape's
+	// own draw or fill would. Shapes are drawn a type at a time in the
+	// order of SceneFile::TYPES, meshes last, and in the order added
+	// within a type. Shapes wholly out of view are skipped; what was
+	// culled is counted in vc's CullStats.
+	void draw(GraphicsContext *gc, ViewContext *vc, bool filled) const;
+
+private:
+	// the types stored in arrays: all of SceneFile::TYPES but meshes,
+	// which come last
+	static const int NUM_BATCHES = SceneFile::NUM_TYPES - 1;
+
+	// The points of a batch as last converted, kept until the view or the
+	// points change, as Mesh does with its vertices. The model points are
+	// the batch's own arrays.
+	struct Converted
+	{
+		// ViewContext::getRevision of the view converted to
+		unsigned long revision;
+		// the points in clip and device coordinates
+		matrix clipPts, devPts;
+		// ViewContext::outcode of every point
+		std::vector<unsigned int> outcodes;
+
+		Converted(unsigned int numPoints);
+	};
+
+	// the shapes of one type
+	struct Batch
+	{
+		// a color per shape
+		std::vector<int> colors;
+		// the points of all shapes, shape after shape: the rows of their
+		// model coordinates
+		std::vector<double> x, y, z, w;
+		// polygons only, which vary in size: the first point of each
+		// polygon, and one past the last polygon's
+		std::vector<unsigned int> first;
+		// null until drawn, and whenever the points change
+		mutable std::unique_ptr<Converted> converted;
+
+		// @returns the number of shapes in the batch
+		size_t size() const;
+
+		// @returns the index of the first point of shape i
+		unsigned int firstPoint(size_t i, unsigned int numPoints) const;
+	};
+
+	// where a shape is held
+	struct Entry
+	{
+		// its batch, the index of its type in SceneFile::TYPES.
+		// NUM_BATCHES for meshes.
+		unsigned int batch;
+		// its index in the batch, or in meshes
+		unsigned int index;
+	};
+
+	Batch batches[NUM_BATCHES];
+	std::vector<Shape*> meshes;
+	// every shape, in the order added
+	std::vector<Entry> order;
+
+	// @returns the number of points each shape of a batch has, 0 for
+	//			polygons
+	static unsigned int pointsPerShape(unsigned int batch);
+
+	// copies the shapes of from after these
+	void append(const ShapeArrays &from);
+
+	// @returns the batch shapes of s's type are held in
+	static unsigned int batchOf(const Shape &s);
+
+	// Stores a copy of s at entry, in the batch of its type. Those from
+	// there on in the batch move up one, but aren't renumbered in order.
+	void insert(const Entry &entry, const Shape &s);
+
+	// Overwrites a shape with a copy of s, of the same type. A polygon
+	// may change size: the points after it move over.
+	void replace(const Entry &entry, const Shape &s);
+
+	// Removes a shape from its batch. Those after it in the batch move
+	// down one, but aren't renumbered in order.
+	void remove(const Entry &entry);
+
+	// @returns the points of a batch, converted by vc if they haven't
+	//			been by its current transform. The batch must hold a
+	//			shape.
+	static const Converted& convert(const Batch &batch, const ViewContext *vc);
+
+	// Fills the triangle of a batch's points (a,b,c) as Shape::fillFacet
+	// does, taking its normal from the model points in the arrays
+	static void fillFacet(GraphicsContext *gc, const ViewContext *vc,
+			const Batch &batch, const Converted &points,
+			unsigned int a, unsigned int b, unsigned int c, int color);
+
+	// The loops drawing each type: see the draw of each Shape. Each takes
+	// the batch and its converted points.
+	static void drawPoints(GraphicsContext *gc, ViewContext *vc,
+			const Batch &batch, const Converted &points);
+	static void drawCircles(GraphicsContext *gc, ViewContext *vc,
+			const Batch &batch, const Converted &points);
+	// lines, triangles and rectangles: shapes of numPoints points
+	// joined in a loop, a single edge for lines
+	static void drawOutlines(GraphicsContext *gc, ViewContext *vc,
+			const Batch &batch, const Converted &points,
+			unsigned int numPoints, bool filled);
+	static void drawPolygons(GraphicsContext *gc, ViewContext *vc,
+			const Batch &batch, const Converted &points, bool filled);
+
+	// Decides whether a shape of count points from first is drawn: not if
+	// all of them are beyond the same side of the view. Counts the shape
+	// into vc's CullStats.
+	static bool isVisible(ViewContext *vc, const Converted &points,
+			unsigned int first, unsigned int count);
+};
+
+#endif
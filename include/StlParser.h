@@ -0,0 +1,102 @@
+// @file StlParser.h
+// Parsers turning the contents of an STL file into a Mesh.
+// They work on an in-memory buffer (normally a MappedFile) and append
+// straight into the mesh's contiguous vertex arrays.
+
+#ifndef STL_PARSER_H
+#define STL_PARSER_H
+
+#include "Image.h" // for imageException
+#include "Mesh.h"
+#include "ThreadPool.h"
+#include <cstddef>
+
+class StlParser {
+public:
+	// Size of the fixed binary STL header, and of each facet record
+	// (normal, 3 vertices, 16-bit attribute)
+	static const size_t BINARY_HEADER_SIZE = 84;
+	static const size_t BINARY_FACET_SIZE = 50;
+	
+	// Decides whether a buffer holds a binary or an ASCII STL file.
+	// The 80 byte binary header may itself start with "solid", so the size
+	// implied by the facet count is checked first; failing that, a buffer
+	// that looks like text (no control bytes near the start) is ASCII.
+	// @param data contents of the file
+	// @param size number of bytes in data
+	// @returns true if the buffer should be parsed as binary STL
+	static bool isBinary(const char* data, size_t size);
+	
+	// Parses binary STL (80 byte header, uint32 facet count, 50 byte
+	// facet records, all little-endian) into mesh. Every facet appends
+	// three vertices and one facet.
+	// @param data contents of the file
+	// @param size number of bytes in data
+	// @param mesh the mesh to append to
+	// @throws imageException if the buffer is shorter than its facet count says
+	static void parseBinary(const char* data, size_t size, Mesh &mesh);
+	
+	// Parses ASCII STL in [begin, end) into mesh. Lines whose first two
+	// words are not "facet normal" (solid, endsolid, blank lines) are
+	// skipped. Once a facet has started it must be complete:
+	//   outer loop, vertex x y z (3 times), endloop, endfacet
+	// Tokens are matched in place over the buffer, no strings are built.
+	// @param begin first character to parse
+	// @param end one past the last character to parse
+	// @param mesh the mesh to append to
+	// @throws imageException if a facet is malformed
+	static void parseAscii(const char* begin, const char* end, Mesh &mesh);
+	
+	// Same as parseAscii, with the work spread over pool. The buffer is cut
+	// into chunks at lines starting with "facet normal", each chunk is
+	// parsed into its own mesh, and the chunks are appended to mesh in file
+	// order, so the result is exactly what parseAscii produces. A malformed
+	// facet is reported the same way too: if several chunks fail, the error
+	// from the earliest one is thrown. Buffers too small to be worth
+	// splitting are parsed on the calling thread.
+	// @param begin first character to parse
+	// @param end one past the last character to parse
+	// @param mesh the mesh to append to. Unchanged if an exception is thrown.
+	// @param pool the threads to parse with
+	// @throws imageException if a facet is malformed
+	static void parseAsciiParallel(const char* begin, const char* end, 
+			Mesh &mesh, ThreadPool &pool);
+	
+private:
+	// Chunks smaller than this aren't worth a thread
+	static const size_t MIN_CHUNK_SIZE = 256*1024;
+	// Chunks per thread. More than one evens out chunks that parse slower.
+	static const unsigned int CHUNKS_PER_THREAD = 4;
+	
+
+	// The state of the ASCII tokenizer: a position within the buffer
+	struct Cursor
+	{
+		const char* pos;
+		const char* end;
+	};
+	
+	// moves past any whitespace (spaces, tabs, newlines)
+	static void skipSpace(Cursor &cur);
+	
+	// moves to the first character of the next line
+	static void skipLine(Cursor &cur);
+	
+	// reads the next whitespace delimited word and compares it to keyword
+	// @returns true if the word is exactly keyword
+	static bool matchWord(Cursor &cur, const char* keyword, size_t length);
+	
+	// Same as above, but both words must be on the current line
+	// @returns true if the line starts with "facet normal"
+	static bool matchFacetStart(Cursor &cur);
+	
+	// reads the next word as a floating point number
+	// @returns false if it isn't a number
+	static bool parseNumber(Cursor &cur, double &value);
+	
+	// finds the first line at or after from that starts with "facet normal"
+	// @returns the start of that line, or end if there is none
+	static const char* findFacetStart(const char* from, const char* end);
+};
+
+#endif
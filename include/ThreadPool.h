@@ -0,0 +1,103 @@
+// @file ThreadPool.h
+// A fixed set of worker threads for data-parallel loops. The threads are
+// created once and sleep between jobs, so handing work to them costs a
+// wakeup rather than a thread creation.
+//
+// Work is balanced by stealing: each thread starts with its own contiguous
+// share of the indices, takes them from the front of its queue, and once
+// it runs out takes from the back of another thread's queue. Neighbouring
+// indices (tiles of an image, chunks of a file) thus mostly stay on one
+// thread, while threads that get cheap work help the ones that don't.
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <deque>
+#include <memory>
+
+class ThreadPool {
+public:
+	// Starts the worker threads. The thread calling parallelFor also
+	// works, so numThreads-1 extra threads are created.
+	// @param numThreads total number of threads working on a job.
+	//		  0 means one per hardware thread.
+	ThreadPool(unsigned int numThreads = 0);
+
+	// Stops and joins the worker threads
+	~ThreadPool();
+
+	// Threads can't be copied, neither can a pool of them
+	ThreadPool(const ThreadPool &p) = delete;
+	ThreadPool& operator=(const ThreadPool &rhs) = delete;
+
+	// @returns the number of threads working on a job, including the caller
+	unsigned int getNumThreads() const;
+
+	// Runs task(i) for every i in [0, count), spread over the pool, and
+	// returns once all of them have finished. Tasks may run in any order
+	// and on any thread.
+	// If tasks throw, the exception from the lowest index is rethrown here
+	// once everything has stopped; the remaining tasks still run.
+	// Only one parallelFor may run on a pool at a time.
+	// @param count number of tasks
+	// @param task the work to do for one index
+	void parallelFor(unsigned int count,
+			const std::function<void(unsigned int)> &task);
+
+	// @returns a process-wide pool with one thread per hardware thread,
+	//			created on first use
+	static ThreadPool& shared();
+
+private:
+	// The indices a thread has yet to run. The owner takes from the
+	// front, thieves from the back.
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::deque<unsigned int> tasks;
+	};
+
+	// body of every worker thread: wait for a job, help with it, repeat
+	// @param self the worker's queue, 1 and up (0 is the caller's)
+	void workerLoop(unsigned int self);
+
+	// runs tasks from queue self, then steals from the others until
+	// every queue is empty
+	void runTasks(unsigned int self);
+
+	// takes the next task for thread self
+	// @returns false if there is no work left anywhere
+	bool nextTask(unsigned int self, unsigned int &task);
+
+	std::vector<std::thread> workers;
+	// one queue per thread, the caller's first
+	std::vector<std::unique_ptr<WorkQueue> > queues;
+
+	// guards everything below
+	std::mutex lock;
+	// signalled when a job is posted or the pool is stopping
+	std::condition_variable jobReady;
+	// signalled when the last worker leaves a job
+	std::condition_variable jobDone;
+
+	// the job being run, valid while a parallelFor is in progress
+	const std::function<void(unsigned int)>* task;
+
+	// incremented per job so sleeping workers can tell a new one arrived
+	unsigned long generation;
+	// workers still inside the current job
+	unsigned int activeWorkers;
+	bool stopping;
+
+	// first failure of the current job, by task index
+	std::exception_ptr error;
+	unsigned int errorIndex;
+};
+
+#endif
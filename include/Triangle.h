@@ -22,6 +22,9 @@ public:
 	// It builds on top of the copy constructor of the shape class
 	Triangle(const Triangle &s);
 
+	// Copy constructor placing the copy's points in arena
+	Triangle(const Triangle &s, Arena &arena);
+
 	// This won't do anything, because the object contains Plain old data (POD).
 	// The default destructing will suffice.
 	virtual ~Triangle();
@@ -34,6 +37,10 @@ public:
 	// and draws the triangle by drawing 3 segments using the GraphicsContext pointer
 	// and the ViewContext pointer
 	virtual void draw(GraphicsContext *gc, ViewContext *vc) const;
+	
+	// Fills the triangle in the shape's color, shaded by how directly it
+	// faces the viewer
+	virtual void fill(GraphicsContext *gc, ViewContext *vc) const;
 
 	// This implementation extends on the output of the Shape class by specifying 
 	// the shape type,
@@ -57,11 +64,17 @@ public:
 	// @param is The input stream to parse from
 	virtual void in(std::istream & is);
 
+	// @returns 't', the character Triangles are known by in files
+	virtual char getType() const;
+	
 	// the closest we get to a "virtual copy constructor"
 	// This will return a new'd copy of the current shape
 	// It's the responsibility of the caller to delete!
 	virtual Shape* clone() const;
 	
+	// Same as clone, but the copy and its points come from arena
+	virtual Shape* clone(Arena &arena) const;
+	
 };
 
 // global overloading of the stream insertion operator for the class
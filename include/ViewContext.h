@@ -6,6 +6,8 @@
 #define VIEW_CONTEXT_H
 
 #include "matrix.h"
+#include "fixedmatrix.h"
+#include <atomic>
 
 // a helper class to bundle a message with any thrown exceptions.
 // To use, simply 'throw viewContextException("A descriptive message about
@@ -21,6 +23,52 @@ class viewContextException:public std::runtime_error
 
 class ViewContext {
 public:
+	// Bits of an outcode: the sides of the view volume a point in clip
+	// coordinates lies outside of. The view volume is what lands on the
+	// device, in front of the near plane.
+	static const unsigned int OUT_LEFT = 1;
+	static const unsigned int OUT_RIGHT = 2;
+	static const unsigned int OUT_TOP = 4;
+	static const unsigned int OUT_BOTTOM = 8;
+	static const unsigned int OUT_NEAR = 16;
+	// outside the guard band (see GUARD_BAND)
+	static const unsigned int OUT_GUARD = 32;
+	// the points of anything with one of these bits must be clipped
+	// before they are divided by w
+	static const unsigned int OUT_NEEDS_CLIP = OUT_NEAR | OUT_GUARD;
+	// The bits of single sides. Points all sharing one of these are out
+	// of view together. OUT_GUARD isn't one: points can be beyond the
+	// guard band on opposite sides of the view, with the view in between.
+	static const unsigned int OUT_SIDES = OUT_LEFT | OUT_RIGHT | OUT_TOP | 
+			OUT_BOTTOM | OUT_NEAR;
+	
+	// Points whose w is below this are too near the viewer (or behind
+	// them) to be projected: the divide by w would blow them up or flip
+	// them over.
+	static constexpr double NEAR_W = 0.01;
+	
+	// Lines and triangles are only clipped where they reach this many
+	// pixels beyond an edge of the device. Anything within the band is
+	// sent as it is (whatever draws it skips the pixels off the device);
+	// anything reaching further is cut down to the band, so no
+	// coordinate drawn gets further off than this.
+	static constexpr double GUARD_BAND = 4096;
+	
+	// The planes clipLine and clipTriangle clip against: the near plane
+	// and the four sides of the guard band
+	static const unsigned int CLIP_PLANES = 5;
+	
+	// How much of the last frame was skipped by culling. Shapes count
+	// themselves in; Image::draw starts a frame by resetting them.
+	struct CullStats
+	{
+		// shapes drawn, and skipped for lying wholly outside the view
+		unsigned int shapesDrawn, shapesCulled;
+		// mesh facets drawn, skipped for being outside the view (or
+		// reaching behind the near plane), and skipped for facing away
+		unsigned int facetsDrawn, facetsOutside, facetsBackfacing;
+	};
+	
 	// default constructor -- sets the composite matrix and its
 	// inverse to its reset state.
 	// It configures the translation, rotation, and zoom matrices to the
@@ -71,6 +119,82 @@ public:
 	// @throws matrixException if numPoints is incorrect or points rows < 4
 	matrix deviceToModel(const matrix& points) const;
 	
+	// Computes the clip coordinates of all column vectors in the matrix
+	// parameter: their device coordinates before the divide by w. These
+	// are what outcode works on.
+	// @points a matrix with 4 rows (x y z 1) and numPoints columns
+	// @returns a 4xnumPoints matrix representing the clip points
+	// @throws matrixException if points rows < 4
+	matrix modelToClip(const matrix& points) const;
+	
+	// The same, for points held a row per array as ShapeArrays keeps
+	// them, so they needn't be gathered into a matrix first
+	// @params (x,y,z,w) the model coordinates of the points
+	// @param numPoints how many points each array holds
+	// @returns a 4xnumPoints matrix representing the clip points
+	matrix modelToClip(const double* x, const double* y, const double* z,
+			const double* w, unsigned int numPoints) const;
+	
+	// Divides clip points by their w, turning them into device points.
+	// Points with an outcode of OUT_NEAR can't be divided meaningfully.
+	// @param clipPts a 4xn matrix of clip points
+	// @returns the 4xn matrix of device points
+	matrix clipToDevice(const matrix& clipPts) const;
+	
+	// @params (x,y,w) a point in clip coordinates
+	// @returns the OUT_ bits of the sides of the view volume the point
+	//			is outside of, 0 if it's inside. OUT_GUARD is added
+	//			if it's outside the guard band too.
+	unsigned int outcode(double x, double y, double w) const;
+	
+	// Clips a line in clip coordinates to the part in front of the near
+	// plane and within the guard band
+	// @params (a,b) the end points, moved onto the planes they're cut by
+	// @returns false if no part of the line is left
+	bool clipLine(Vec4 &a, Vec4 &b) const;
+	
+	// Clips a triangle in clip coordinates to the part in front of the
+	// near plane and within the guard band. What is left is a convex
+	// polygon, to be drawn as a fan of triangles around its first corner.
+	// @param points the 3 corners of the triangle in its first entries.
+	//		  Replaced by the corners of the polygon left, in order.
+	// @returns the number of corners left, 0 if nothing is
+	unsigned int clipTriangle(Vec4 points[3 + CLIP_PLANES]) const;
+	
+	// Tests a box in model coordinates against the view volume. The
+	// test is conservative: a box that is reported visible may still
+	// turn out to be just off the device.
+	// @param low the smallest x, y and z of the box
+	// @param high the largest x, y and z of the box
+	// @returns false if the box lies wholly outside the view volume
+	bool isBoxVisible(const double low[3], const double high[3]) const;
+	
+	// Turns culling of facets facing away from the viewer on or off.
+	// Only valid for closed meshes whose facets are wound
+	// counter-clockwise seen from outside, as STL requires. Off by default.
+	void setBackfaceCulling(bool cull);
+	
+	// @returns true if facets facing away from the viewer are skipped
+	bool isBackfaceCulling() const;
+	
+	// @returns the culling counts of the frame drawn last, or the one
+	//			being drawn. Shapes add to them as they draw.
+	CullStats& getCullStats();
+	const CullStats& getCullStats() const;
+	
+	// zeroes the culling counts, for a new frame
+	void resetCullStats();
+	
+	// @returns a number that changes whenever the composite does. No two
+	//			ViewContexts hand out the same number, so it identifies
+	//			the transform for anything caching points converted by it.
+	unsigned long getRevision() const;
+	
+	// @returns the transform from model coordinates to view (camera)
+	// coordinates, where the viewer looks down -z. It combines every
+	// transformation applied to the model, without the projection, so
+	// it's the one to take model normals into the view with.
+	const Mat4& getModelView() const;
 	
 	// Translates the view by the configured transformation matrix
 	// This Transforms the composite matrix and recomputes its inverse
@@ -119,6 +243,11 @@ public:
 	
 private:	
 	
+	// signed distance of a clip point from one of the CLIP_PLANES,
+	// scaled by w: positive on the side kept
+	// @param plane 0 for the near plane, 1-4 for the guard band sides
+	double clipDistance(unsigned int plane, const Vec4 &p) const;
+	
 	// Internal configuration of model to view
 	// computes matrices for conversion  from x,y,z to L,M,N
 	// viewing coordinates. This changes as the viewing point 
@@ -144,57 +273,78 @@ private:
 	
 	// internal function that computes a translation matrix
 	// @params (dx,dy,dz) amounts of translation in all components
-	matrix computeTranslation(double dx, double dy, double dz=0);
+	Mat4 computeTranslation(double dx, double dy, double dz=0);
 	
 	// internal function that computes a rotation matrix
 	// @params (x,y,z) represent the center of rotation
 	// @param angle angle of rotation in radians
-	matrix computeRotation(double angle, double x=0, double y=0, double z=0);
+	Mat4 computeRotation(double angle, double x=0, double y=0, double z=0);
 	
 	// internal function that computes a scale matrix
 	// @param multiplier the amount to scale. must be non-zero positive
 	// @params (x,y,z) center of zooming
 	// @throws viewContextException if multiplier is non-positive
-	matrix computeZoom(double multiplier, double x=0, double y=0, double z=0);
+	Mat4 computeZoom(double multiplier, double x=0, double y=0, double z=0);
+	
+	// All of the transforms below are fixed 4x4 matrices stored inline,
+	// so recomputing the composite never allocates.
 	
 	// composite matrix used to transform a point
 	// from model coordinates to device coordinates
 	// its inverse is also needed for the inverse (in case of 2D)
-	matrix composite, compositeInv;
+	Mat4 composite, compositeInv;
+	
+	// the part of composite up to view coordinates, kept for lighting
+	Mat4 modelView;
 	
 	// matrices for forming the complete 3D composite matrix!
 	// in order to go from model to device, we have to traverse
 	// the view (camera) coordinates, the view plane, and then the device!
-	matrix vTm, pTv, dTp;
+	Mat4 vTm, pTv, dTp;
 	
 	// the translation matrix and its inverse. 
 	// When the image is translated, they are applied
 	// to the netTranslation matrix and its inverse
-	matrix translation, translationInv;
+	Mat4 translation, translationInv;
 		
 	// The rotation matrix and its inverse. 
 	// When the image on the screen is rotated,
 	// the netRotation matrix and its inverse are transformed by it
-	matrix rotation, rotationInv;
+	Mat4 rotation, rotationInv;
 		
 	// Scale matrix and its inverse. For zooming into or out of an image 
-	matrix scale, scaleInv;
+	Mat4 scale, scaleInv;
 	
 	// the total amount of translation to be applied to the composite matrix
-	matrix netTranslation, netTranslationInv;
+	Mat4 netTranslation, netTranslationInv;
 	
 	// represents the total amount of rotation applied to the composite matrix
 	// stored as a matrix instead of a double because of the possiblity
 	// of rotating around a focus point
-	matrix netRotation, netRotationInv;	
+	Mat4 netRotation, netRotationInv;	
 	
 	// represents the net amount of zooming applied to the composite matrix
 	// stored as a matrix instead of a double because of the possibility
 	// of zooming into a focus point
-	matrix netScale, netScaleInv;
+	Mat4 netScale, netScaleInv;
 		
 	// dimensions of the device, repersenting the maximum x,y coordinates in it
 	const double deviceWidth, deviceHeight;
+	
+	bool backfaceCulling;
+	CullStats cullStats;
+	
+	// see getRevision. Taken from nextRevision whenever the composite is
+	// recomputed.
+	unsigned long revision;
+	static std::atomic<unsigned long> nextRevision;
 };
 
+// global overloading of the stream insertion operator for CullStats
+// Output Format: "shapes: <drawn> drawn, <culled> culled; facets: ..."
+// @param os output stream to the left of the << operator
+// @param stats the counts to insert into os
+// @return os to allow for chaining
+std::ostream& operator<<(std::ostream &os, const ViewContext::CullStats &stats);
+
 #endif
\ No newline at end of file
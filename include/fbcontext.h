@@ -0,0 +1,131 @@
+#ifndef FB_CONTEXT_H
+#define FB_CONTEXT_H
+/**
+ * This class is an implementation of the GraphicsContext class that
+ * draws into a block of memory instead of a window. It needs no display,
+ * so it can render frames on machines without an X server and in
+ * benchmarks. Frames can be written out as PPM or PNG files.
+ * 
+ * A framebuffer may also hold just a rectangle of a larger window, as
+ * the tiles of a TiledContext do. Every drawing operation produces the
+ * same pixels whichever rectangle the buffer holds, so such pieces fit
+ * together seamlessly.
+ * */
+
+#include "gcontext.h"	// base class
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+class FramebufferContext : public GraphicsContext
+{
+	public:
+		// Creates a framebuffer of the given size, cleared to bg_color
+		FramebufferContext(unsigned int sizex = 400, unsigned int sizey = 400,
+				unsigned int bg_color = GraphicsContext::BLACK);
+
+		// Creates a framebuffer for part of a window
+		// @params (sizex, sizey) size of the part in pixels
+		// @param bg_color color the buffer is cleared to
+		// @params (originX, originY) window coordinates of its top left pixel
+		FramebufferContext(unsigned int sizex, unsigned int sizey,
+				unsigned int bg_color, int originX, int originY);
+
+		// Creates a framebuffer drawing into pixels it doesn't own, such
+		// as memory shared with an X server
+		// @param pixels room for sizex*sizey pixels, which must outlive
+		//		  the framebuffer. They're cleared to bg_color.
+		FramebufferContext(unsigned int sizex, unsigned int sizey,
+				unsigned int bg_color, uint32_t* pixels);
+
+		// Destructor
+		virtual ~FramebufferContext();
+
+		// The pixels may not be the framebuffer's own
+		FramebufferContext(const FramebufferContext &f) = delete;
+		FramebufferContext& operator=(const FramebufferContext &rhs) = delete;
+
+		// Drawing Operations. Pixels outside the buffer are ignored,
+		// and read back as the background color.
+		void setMode(drawMode newMode);
+		void setColor(unsigned int color);
+		void setPixel(int x, int y);
+		unsigned int getPixel(int x, int y);
+		void getPixels(int x, int y, int width, int height,
+				unsigned int* pixels);
+		void clear();
+
+		// These write straight into the buffer. Only the part of a line
+		// inside the buffer is walked, so long lines off screen cost
+		// little. Both touch every pixel once, so drawing twice in XOR
+		// mode restores the buffer.
+		void drawLine(int x1, int y1, int x2, int y2);
+		void drawCircle(int x, int y, unsigned int radius);
+
+		// Visible pixels are written straight into the buffer
+		void fillTriangle(double x0, double y0, double z0,
+				double x1, double y1, double z1,
+				double x2, double y2, double z2);
+		void clearDepth();
+
+		// There are no events. The drawing is painted and flushed once,
+		// and this returns.
+		void runLoop(DrawingBase* drawing);
+
+		// Utility functions
+		int getWindowWidth();
+		int getWindowHeight();
+
+		// The pixels, row by row from the top, each 0x00RRGGBB
+		const uint32_t* data() const;
+
+		// Writes the frame as a binary PPM (P6) file
+		// @param path the file to write
+		// @throws fileException if the file can't be written
+		void savePPM(const std::string &path) const;
+
+		// Writes the frame as an 8-bit RGB PNG file. The image data is
+		// stored without compression, so no compression library is needed.
+		// @param path the file to write
+		// @throws fileException if the file can't be written
+		void savePNG(const std::string &path) const;
+
+		// Writes a PNG if path ends in ".png", a PPM otherwise
+		// @param path the file to write
+		// @throws fileException if the file can't be written
+		void save(const std::string &path) const;
+
+	protected:
+		// writes one pixel, which must be inside the buffer
+		void plot(int x, int y)
+		{
+			uint32_t &pixel = pixels[(y - originY)*width + (x - originX)];
+			pixel = (mode == MODE_XOR) ? (pixel ^ color) : color;
+		}
+
+		// same as plot, but ignores pixels outside the buffer
+		void plotClipped(int x, int y)
+		{
+			if (x >= originX && y >= originY && x < originX + width && 
+					y < originY + height)
+			{
+				plot(x, y);
+			}
+		}
+
+		int width;
+		int height;
+		// window coordinates of pixels[0]
+		int originX;
+		int originY;
+		// the pixels, unless they were handed to the constructor
+		std::vector<uint32_t> storage;
+		// width*height pixels, in storage or elsewhere
+		uint32_t* pixels;
+
+		uint32_t background;
+		uint32_t color;
+		drawMode mode;
+};
+
+#endif
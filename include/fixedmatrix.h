@@ -0,0 +1,269 @@
+// @file fixedmatrix.h
+// Compile-time sized matrix type. Unlike matrix, the elements live inside the
+// object itself, so creating, copying and multiplying these never touches the
+// heap. This is intended for the small transforms used every frame (4x4
+// composites, 4x1 points). matrix remains the type for dynamically sized data.
+
+#ifndef FIXED_MATRIX_H
+#define FIXED_MATRIX_H
+
+#include <iostream> // for std::ostream
+#include <iomanip>  // for std::setw
+#include <cmath>    // for rotation factories
+#include "matrix.h"
+
+template <unsigned int ROWS, unsigned int COLS>
+class fixedMatrix
+{
+	static_assert(ROWS > 0 && COLS > 0, "fixedMatrix dimensions must be positive");
+
+public:
+	// Creates a matrix with all elements cleared to 0.0
+	constexpr fixedMatrix() : the_matrix{} {}
+
+	// Named constructor - produce the identity matrix. Only square
+	// matrices have an identity.
+	static constexpr fixedMatrix identity()
+	{
+		static_assert(ROWS == COLS, "identity requires a square matrix");
+		fixedMatrix m;
+		for (unsigned int i=0; i<ROWS; i++)
+		{
+			m[i][i] = 1;
+		}
+		return m;
+	}
+
+	// Named constructor - homogeneous 4x4 translation matrix
+	// @params (dx,dy,dz) amounts of translation in all components
+	static constexpr fixedMatrix translation(double dx, double dy, double dz=0)
+	{
+		static_assert(ROWS == 4 && COLS == 4, "translation is a 4x4 transform");
+		fixedMatrix m = identity();
+		m[0][3] = dx;
+		m[1][3] = dy;
+		m[2][3] = dz;
+		return m;
+	}
+
+	// Named constructor - homogeneous 4x4 scale matrix about the origin
+	// @params (sx,sy,sz) the scale factor for each axis
+	static constexpr fixedMatrix scale(double sx, double sy, double sz)
+	{
+		static_assert(ROWS == 4 && COLS == 4, "scale is a 4x4 transform");
+		fixedMatrix m = identity();
+		m[0][0] = sx;
+		m[1][1] = sy;
+		m[2][2] = sz;
+		return m;
+	}
+
+	// Named constructor - homogeneous 4x4 rotation about the z axis from
+	// precomputed cosine and sine of the angle. This is the constexpr form;
+	// the overload below computes them from an angle.
+	static constexpr fixedMatrix rotationZ(double cosA, double sinA)
+	{
+		static_assert(ROWS == 4 && COLS == 4, "rotation is a 4x4 transform");
+		fixedMatrix m = identity();
+		m[0][0] = cosA;
+		m[0][1] = -sinA;
+		m[1][0] = sinA;
+		m[1][1] = cosA;
+		return m;
+	}
+
+	// Same as above, but takes the angle itself (radians, from x towards y+).
+	// std::cos/std::sin are not constexpr, so neither is this.
+	static fixedMatrix rotationZ(double angle)
+	{
+		return rotationZ(std::cos(angle), std::sin(angle));
+	}
+
+	// getters for the dimensions, to mirror matrix
+	constexpr int getRows() const { return ROWS; }
+	constexpr int getCols() const { return COLS; }
+
+	// Access Operators. The dimensions are known at compile time and every
+	// caller in this code base indexes with constants or bounded loops, so
+	// unlike matrix these are not range-checked: m[r][c] is a plain array
+	// access.
+	constexpr double* operator[](unsigned int row)
+	{
+		return &the_matrix[row*COLS];
+	}
+
+	constexpr const double* operator[](unsigned int row) const
+	{
+		return &the_matrix[row*COLS];
+	}
+
+	// Matrix addition - dimensions are checked by the compiler
+	constexpr fixedMatrix operator+(const fixedMatrix& rhs) const
+	{
+		fixedMatrix retVal;
+		for (unsigned int i=0; i<ROWS*COLS; i++)
+		{
+			retVal.the_matrix[i] = the_matrix[i] + rhs.the_matrix[i];
+		}
+		return retVal;
+	}
+
+	// Matrix subtraction - dimensions are checked by the compiler
+	constexpr fixedMatrix operator-(const fixedMatrix& rhs) const
+	{
+		fixedMatrix retVal;
+		for (unsigned int i=0; i<ROWS*COLS; i++)
+		{
+			retVal.the_matrix[i] = the_matrix[i] - rhs.the_matrix[i];
+		}
+		return retVal;
+	}
+
+	// Matrix multiplication - inner dimensions are checked by the compiler
+	template <unsigned int RHS_COLS>
+	constexpr fixedMatrix<ROWS, RHS_COLS>
+	operator*(const fixedMatrix<COLS, RHS_COLS>& rhs) const
+	{
+		fixedMatrix<ROWS, RHS_COLS> retVal;
+		for (unsigned int r=0; r<ROWS; r++)
+		{
+			for (unsigned int c=0; c<RHS_COLS; c++)
+			{
+				double sum = 0;
+				for (unsigned int i=0; i<COLS; i++)
+				{
+					sum += (*this)[r][i] * rhs[i][c];
+				}
+				retVal[r][c] = sum;
+			}
+		}
+		return retVal;
+	}
+
+	// Scalar multiplication, someMatrixObject * 5.0
+	constexpr fixedMatrix operator*(const double scale) const
+	{
+		fixedMatrix retVal;
+		for (unsigned int i=0; i<ROWS*COLS; i++)
+		{
+			retVal.the_matrix[i] = the_matrix[i] * scale;
+		}
+		return retVal;
+	}
+
+	// In-place addition
+	constexpr fixedMatrix& operator+=(const fixedMatrix& rhs)
+	{
+		for (unsigned int i=0; i<ROWS*COLS; i++)
+		{
+			the_matrix[i] += rhs.the_matrix[i];
+		}
+		return *this;
+	}
+
+	// In-place multiplication, this = this * rhs. Only square rhs keeps
+	// the dimensions of this.
+	constexpr fixedMatrix& operator*=(const fixedMatrix<COLS, COLS>& rhs)
+	{
+		*this = *this * rhs;
+		return *this;
+	}
+
+	// In-place scalar multiplication
+	constexpr fixedMatrix& operator*=(const double scale)
+	{
+		for (unsigned int i=0; i<ROWS*COLS; i++)
+		{
+			the_matrix[i] *= scale;
+		}
+		return *this;
+	}
+
+	// Transpose of a Matrix
+	constexpr fixedMatrix<COLS, ROWS> operator~() const
+	{
+		fixedMatrix<COLS, ROWS> retVal;
+		for (unsigned int r=0; r<ROWS; r++)
+		{
+			for (unsigned int c=0; c<COLS; c++)
+			{
+				retVal[c][r] = (*this)[r][c];
+			}
+		}
+		return retVal;
+	}
+
+	// Clear Matrix to all members 0.0
+	void clear()
+	{
+		for (unsigned int i=0; i<ROWS*COLS; i++)
+		{
+			the_matrix[i] = 0;
+		}
+	}
+
+	// I/O - same layout as matrix::out
+	std::ostream& out(std::ostream& os) const
+	{
+		os << "[";
+		for (unsigned int r=0; r<ROWS; r++)
+		{
+			os << "[";
+			for (unsigned int c=0; c<COLS; c++)
+			{
+				os << std::setw(5) << (*this)[r][c] << " ";
+			}
+			os << "]";
+			if (r < ROWS - 1)
+				os << std::endl << " ";
+		}
+		os << "]";
+		return os;
+	}
+
+private:
+	// row-major storage, inline in the object
+	double the_matrix[ROWS*COLS];
+};
+
+// The fixed sizes used by the 3D pipeline
+typedef fixedMatrix<4,4> Mat4;
+typedef fixedMatrix<4,1> Vec4;
+
+// Scalar multiplication with a global function, 5.0 * someMatrixObject
+template <unsigned int ROWS, unsigned int COLS>
+constexpr fixedMatrix<ROWS, COLS> operator*(const double scale,
+		const fixedMatrix<ROWS, COLS>& rhs)
+{
+	return rhs * scale;
+}
+
+// Overloaded global << to match matrix
+template <unsigned int ROWS, unsigned int COLS>
+std::ostream& operator<<(std::ostream& os, const fixedMatrix<ROWS, COLS>& rhs)
+{
+	return rhs.out(os);
+}
+
+// Applies a 4x4 transform to every column of a dynamically sized 4xn matrix
+// of points. This is the bridge between the fixed-size transforms and the
+// heap-backed point lists the shapes own.
+// @throws matrixException if rhs does not have 4 rows
+matrix operator*(const Mat4& lhs, const matrix& rhs);
+
+// Converts a fixed-size matrix into a heap-backed one of the same size
+template <unsigned int ROWS, unsigned int COLS>
+matrix toMatrix(const fixedMatrix<ROWS, COLS>& m)
+{
+	matrix retVal(ROWS, COLS);
+	for (unsigned int r=0; r<ROWS; r++)
+	{
+		for (unsigned int c=0; c<COLS; c++)
+		{
+			retVal[r][c] = m[r][c];
+		}
+	}
+	return retVal;
+}
+
+#endif
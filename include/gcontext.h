@@ -20,6 +20,8 @@
  * */    
 
 
+#include "Rasterizer.h"
+
 // forward reference - needed because runLoop needs a target for events
 class DrawingBase;
 
@@ -82,6 +84,17 @@ class GraphicsContext
 		// possible 64-bit on some 64-bit systems.  In either case,
 		// it is large enough to hold a 16-bit color.
 		virtual unsigned int getPixel(int x, int y) = 0;
+		
+		// Get the 24-bit RGB colors of a rectangle of pixels, row by row
+		// from the top. Contexts that have to fetch pixels from somewhere
+		// else (a display server) fetch the whole rectangle at once, so
+		// this is much faster than a getPixel per pixel.
+		// The default calls getPixel for every pixel.
+		// @params (x, y) top left pixel of the rectangle
+		// @params (width, height) size of the rectangle
+		// @param pixels receives width*height colors
+		virtual void getPixels(int x, int y, int width, int height,
+				unsigned int* pixels);
 
 		// This should reset entire context to the current background
 		virtual void clear()=0;
@@ -113,6 +126,38 @@ class GraphicsContext
 		 * Returns: void
 		 */
 		virtual void drawCircle(int x0, int y0, unsigned int radius);
+		
+		// Contexts may queue drawing operations and send them to the
+		// display in batches, or draw into a back buffer. This pushes out
+		// anything still queued and shows the finished frame, so drawings
+		// should call it once they finish painting a frame.
+		// The default does nothing, for contexts that draw immediately.
+		virtual void flush();
+		
+		/* Fills a triangle in the current color, leaving out the parts
+		 * hidden behind triangles filled earlier in the frame. The corners
+		 * are device coordinates; z is the depth from the ViewContext,
+		 * larger meaning nearer. Call clearDepth before the first triangle
+		 * of every frame.
+		 * 
+		 * This implementation rasterizes into the depth buffer and draws
+		 * the visible pixels as horizontal runs with drawLine. Contexts
+		 * that own their pixels can write them directly instead.
+		 * 
+		 * Parameters:
+		 * 	x0, y0, z0 - first corner
+		 *  x1, y1, z1 - second corner
+		 *  x2, y2, z2 - third corner
+		 * 
+		 * Returns: void
+		 */
+		virtual void fillTriangle(double x0, double y0, double z0,
+				double x1, double y1, double z1,
+				double x2, double y2, double z2);
+		
+		// Starts a new frame of filled triangles: nothing is hidden
+		// until it is drawn again. This also picks up the window size.
+		virtual void clearDepth();
 
 
 		/*********************************************************
@@ -128,6 +173,13 @@ class GraphicsContext
 		// This method will end the current loop if one is running
 		// a default version is supplied
 		virtual void endLoop();
+		
+		// Asks for the drawing to be painted because something it shows
+		// changed. Contexts with an event loop may put this off until the
+		// events already waiting are handled, and paint at most once per
+		// frame interval, so a burst of input costs one frame. The default
+		// paints right away.
+		virtual void repaint(DrawingBase* drawing);
 
 
 		/*********************************************************
@@ -145,6 +197,9 @@ class GraphicsContext
 		// continues to run.
 		bool run;
 		
+		// scan conversion and depth buffer for fillTriangle
+		Rasterizer rasterizer;
+		
 };
 
 #endif
@@ -0,0 +1,35 @@
+// @file matkernel.h
+// Raw multiplication kernels used by matrix and the 3D pipeline.
+// These operate on contiguous row-major double arrays and do no range
+// checking; callers (matrix, ViewContext) are responsible for the sizes.
+//
+// The main case is a small transform times a wide point matrix, e.g. the
+// 4x4 composite times a 4xN matrix of model points. The kernel is blocked
+// over the columns of the wide operand so the block stays in cache, and uses
+// AVX2 or SSE2 when the CPU has them. The implementation is selected once at
+// runtime; all paths perform the same multiplies and adds in the same order,
+// so they produce identical results.
+
+#ifndef MATKERNEL_H
+#define MATKERNEL_H
+
+// Computes out = a * b.
+// @param a     aRows x k matrix, row-major
+// @param aRows number of rows of a (and of out)
+// @param k     inner dimension: columns of a, rows of b
+// @param b     k x n matrix, row-major
+// @param n     number of columns of b (and of out)
+// @param out   aRows x n result, row-major. Must not overlap a or b.
+void multiplyWide(const double* a, unsigned int aRows, unsigned int k,
+		const double* b, unsigned int n, double* out);
+
+// Same as multiplyWide, but always uses the portable scalar loop.
+// Exposed for benchmarking and for checking the vector paths against.
+void multiplyWideScalar(const double* a, unsigned int aRows, unsigned int k,
+		const double* b, unsigned int n, double* out);
+
+// @return the name of the implementation multiplyWide selected on this CPU:
+//         "avx2", "sse2" or "scalar"
+const char* multiplyWideImpl();
+
+#endif
@@ -87,16 +87,36 @@ class matrix
 		//
 		matrix(unsigned int rows, unsigned int cols);
  
+		// Constructor over storage the matrix doesn't own, such as a block
+		// of an Arena.  storage must hold rows*cols elements and outlive
+		// the matrix; it is not cleared, and not freed by the destructor.
+		// If the matrix is later resized, it moves to storage of its own.
+		//
+		// throw (matrixException)
+		//
+		matrix(unsigned int rows, unsigned int cols, double* storage);
+ 
 		// Copy constructor - make a new Matrix just like rhs
 		matrix(const matrix& from);
  
+		// Move constructor - takes over the storage of from instead of
+		// copying it.  from is left empty (0x0) and may only be assigned
+		// to or destroyed afterwards.
+		matrix(matrix&& from) noexcept;
+ 
 		// Destructor.  Free allocated memory
 		~matrix();
  
 		// Assignment operator - make this just like rhs.  Must function
-	    // correctly even if rhs is a different size than this.
+	    // correctly even if rhs is a different size than this.  If this
+		// already holds the same number of elements as rhs, the existing
+		// storage is reused rather than reallocated.
 		matrix& operator=(const matrix& rhs);
  
+		// Move assignment - swaps storage with rhs, so assigning the result
+		// of an expression (m = a * b) never copies element data.
+		matrix& operator=(matrix&& rhs) noexcept;
+ 
 		// "Named" constructor(s).  This is not a language mechanism, rather
 		// a common programming idiom.  The underlying issue is that with
 		// overloaded operators, you can lose sight of what various
@@ -121,6 +141,10 @@ class matrix
 		// getter in order to know the number of columns in th matrix
 		int getCols() const;
 		
+		// whether the elements were allocated by the matrix, and are freed
+		// with it: false for storage handed to the constructor
+		bool ownsStorage() const;
+		
  
  
 		// Matrix addition - lhs and rhs must be same size otherwise
@@ -144,6 +168,32 @@ class matrix
 		// Transpose of a Matrix - should always work, hence no exception
 		matrix operator~() const;
  
+		// In-place matrix addition.  Same rules as operator+, but the
+		// result is accumulated into this, so nothing is allocated.
+		//
+		// throw (matrixException)
+		//
+		matrix& operator+=(const matrix& rhs);
+ 
+		// In-place matrix multiplication, this = this * rhs.  rhs must be
+		// square (cols x cols) so the result keeps the size of this, which
+		// lets the product be formed one row at a time in place.
+		//
+		// throw (matrixException)
+		//
+		matrix& operator*=(const matrix& rhs);
+ 
+		// In-place scalar multiplication
+		matrix& operator*=(const double scale);
+ 
+		// Computes dst = a * b without creating a temporary.  dst is resized
+		// (reusing its storage when the element count already matches) and
+		// may safely alias a or b.
+		//
+		// throw (matrixException)
+		//
+		static void multiplyInto(matrix& dst, const matrix& a, const matrix& b);
+ 
 		// Clear Matrix to all members 0.0
 		void clear();
   
@@ -175,6 +225,24 @@ class matrix
 		//
 		const matrix::row operator[](unsigned int row) const;
  
+		// Unchecked element access, m.uncheckedAt(r, c).  operator[] stays
+		// the checked, user-facing way in; this is for internal loops whose
+		// indices are already known to be in range (kernels, drawing).
+		// Compiling with MATRIX_DEBUG defined turns the range checks back on
+		// here too, throwing the same matrixException as operator[].
+		double& uncheckedAt(unsigned int row, unsigned int col);
+		double uncheckedAt(unsigned int row, unsigned int col) const;
+ 
+		// Raw access to the elements, stored row-major and contiguously:
+		// element [r][c] is data()[r*stride() + c].  Intended for the
+		// kernels in matkernel.h; no range checking is possible through these.
+		double* data();
+		const double* data() const;
+ 
+		// distance in elements between the starts of consecutive rows of
+		// data()
+		unsigned int stride() const;
+ 
 		// I/O - for convenience - this is intended to be called by the global
 		// << operator declared below.
 		std::ostream& out(std::ostream& os) const;
@@ -188,6 +256,8 @@ class matrix
 		double* the_matrix;
 		unsigned int rows;
 		unsigned int cols;
+		// whether the_matrix was allocated by, and is freed by, this
+		bool owner;
 
 
 		/** routines **/
@@ -195,9 +265,54 @@ class matrix
 		// add any "helper" routine here, such as routines to support
 		// matrix inversion
 		
+		// Makes this a rows x cols matrix.  The current storage is kept if it
+		// already holds exactly rows*cols elements, otherwise it is replaced.
+		// Element values are left unspecified.
+		void resize(unsigned int rows, unsigned int cols);
+		
 
 };
 
+/** Inline accessors - these sit in every hot loop, so they are defined here
+ ** where the compiler can see through them **/
+
+inline double& matrix::uncheckedAt(unsigned int row, unsigned int col)
+{
+#ifdef MATRIX_DEBUG
+	if (row >= rows || col >= cols)
+	{
+		throw matrixException("Element accessed is out of range");
+	}
+#endif
+	return the_matrix[row*cols + col];
+}
+
+inline double matrix::uncheckedAt(unsigned int row, unsigned int col) const
+{
+#ifdef MATRIX_DEBUG
+	if (row >= rows || col >= cols)
+	{
+		throw matrixException("Element accessed is out of range");
+	}
+#endif
+	return the_matrix[row*cols + col];
+}
+
+inline double* matrix::data()
+{
+	return the_matrix;
+}
+
+inline const double* matrix::data() const
+{
+	return the_matrix;
+}
+
+inline unsigned int matrix::stride() const
+{
+	return cols;
+}
+
 /** Some Related Global Functions **/
  
 // Overloaded global << with std::ostream as lhs, Matrix as rhs.  This method
@@ -30,7 +30,9 @@ public:
 	// Destructor, frees image and view context
 	virtual ~MyDrawing();
 	
-	// erases the previous drawing and draws a new one
+	// Brings the display up to date. The image is only drawn again if
+	// it, or the view of it, changed since it was last drawn; either way
+	// the frame is then shown with the GraphicsContext's flush.
 	virtual void paint(GraphicsContext *gc);
 	
 	// Handles continuously applying transformations
@@ -70,11 +72,23 @@ private:
 		// Translate the model -step in x
 		left = 65361,
 				
+		/* Rendering Commands */
+		// Switches between wireframe and filled, shaded surfaces
+		fill = 'f',
+		// Switches culling of facets facing away from the viewer on or off
+		backface = 'b',
+		// Prints how much of the last frame was culled
+		cullStats = 'c',
+		// Switches between storing shapes as objects and in per-type arrays
+		packed = 'k',
+		
 		/* Saving Commands */
 		// Loads saved image (if any)
 		load = 'i',
-		// Saves current image
+		// Saves current image, in the compact binary format
 		save = 'o',
+		// Saves current image as text, for reading or other programs
+		saveText = 't',
 		
 		/* Coloring Commands */
 		// Set color to Black
@@ -106,6 +120,18 @@ private:
 	
 	// The viewcontext used to seperate the model from the device's view
 	ViewContext *vc;
+	
+	// What the frame on display was drawn from: the revisions of the
+	// image and the view, and the culling setting. If they all still
+	// match, painting only needs to show the frame again.
+	// Nothing has been drawn while drawn is false.
+	bool drawn;
+	unsigned long drawnImageRevision;
+	unsigned long drawnViewRevision;
+	bool drawnBackface;
+	
+	// Erases the previous drawing and draws the image afresh
+	void render(GraphicsContext *gc);
 			
 	// Handles image-changing commands
 	// Handles saving/loading, and color changing commands
@@ -114,7 +140,7 @@ private:
 	
 	// Handles actions that concern the view of the image, not the image
 	// itself Handles transformations. This manipulates the viewcontext
-	// Also redraws the image when called after handling the transformation
+	// Also asks for the image to be redrawn after handling the transformation
 	// this will also store the previous key to make sure that transformations
 	// are only configured once when necessary. This should speed this function
 	// considerably. 
@@ -0,0 +1,112 @@
+#ifndef TILED_CONTEXT_H
+#define TILED_CONTEXT_H
+/**
+ * A FramebufferContext that draws on every core. Drawing operations are
+ * not carried out right away but recorded, together with the color and
+ * mode at the time. On flush the recorded operations are sorted into
+ * 64x64 pixel tiles by the area they touch, and the tiles are drawn in
+ * parallel, each into its own color and depth buffer, replaying just the
+ * operations that touch it in the order they were recorded. The finished
+ * tiles are copied into the framebuffer.
+ *
+ * Every tile draws exactly the pixels a single FramebufferContext would,
+ * so the frames are identical to FramebufferContext's; only the pixels
+ * (getPixel, data, save...) reflect nothing drawn since the last flush.
+ * getPixel and getPixels flush first.
+ *
+ * With a pool of one thread there is nothing to draw in parallel, and
+ * recording and binning would only add to the work: operations are then
+ * drawn straight into the framebuffer, as FramebufferContext draws them.
+ * */
+
+#include "fbcontext.h"	// base class
+#include "ThreadPool.h"
+#include <vector>
+#include <memory>
+
+class TiledContext : public FramebufferContext
+{
+	public:
+		// width and height of the tiles, in pixels
+		static constexpr int TILE_SIZE = 64;
+
+		// Creates a framebuffer of the given size, cleared to bg_color
+		// @param pool the threads tiles are drawn on
+		TiledContext(unsigned int sizex = 400, unsigned int sizey = 400,
+				unsigned int bg_color = GraphicsContext::BLACK,
+				ThreadPool &pool = ThreadPool::shared());
+
+		// Destructor
+		virtual ~TiledContext();
+
+		// Drawing Operations. These are recorded and carried out on flush,
+		// unless the pool has a single thread.
+		void setPixel(int x, int y);
+		void clear();
+		void drawLine(int x1, int y1, int x2, int y2);
+		void drawCircle(int x, int y, unsigned int radius);
+		void fillTriangle(double x0, double y0, double z0,
+				double x1, double y1, double z1,
+				double x2, double y2, double z2);
+		void clearDepth();
+
+		// Flush, then read the pixels
+		unsigned int getPixel(int x, int y);
+		void getPixels(int x, int y, int width, int height,
+				unsigned int* pixels);
+
+		// Draws everything recorded since the last flush into the tiles,
+		// in parallel, and copies them into the framebuffer
+		void flush();
+
+	private:
+		// one recorded drawing operation
+		struct Command
+		{
+			enum Type {PIXEL, LINE, CIRCLE, TRIANGLE, CLEAR, CLEAR_DEPTH};
+			Type type;
+			uint32_t color;
+			drawMode mode;
+			// the arguments of the operation, in order
+			double args[9];
+		};
+
+		// records an operation in the current color and mode
+		void record(Command::Type type, int numArgs, const double* args);
+
+		// sorts commands [begin, end) into bins[chunk], by the tiles
+		// they touch
+		void binCommands(unsigned int chunk, size_t begin, size_t end);
+
+		// widens [low, high] to the x coordinates of the part of the
+		// segment (x1, y1) - (x2, y2) within row ty of the tiles, with a
+		// pixel to spare above and below
+		void segmentExtent(double x1, double y1, double x2, double y2,
+				int ty, double &low, double &high) const;
+
+		// replays the commands binned for a tile into it, then copies it
+		// into the framebuffer
+		void drawTile(unsigned int tile);
+
+		ThreadPool &pool;
+		// the pool has one thread: nothing is recorded, and there are
+		// no tiles
+		bool direct;
+
+		// drawn into by the threads. Tile t covers the pixels from
+		// ((t % tilesX)*TILE_SIZE, (t / tilesX)*TILE_SIZE)
+		std::vector<std::unique_ptr<FramebufferContext> > tiles;
+		int tilesX;
+		int tilesY;
+
+		// recorded since the last flush
+		std::vector<Command> commands;
+
+		// bins[chunk][tile] lists the commands of one chunk of the
+		// command list that touch the tile, in order. Commands are binned
+		// in chunks so that binning runs in parallel too. Kept between
+		// frames so the lists don't need to be allocated again.
+		std::vector<std::vector<std::vector<unsigned int> > > bins;
+};
+
+#endif
@@ -3,17 +3,50 @@
 /**
  * This class is a sample implementation of the GraphicsContext class
  * for the X11 / XWindows system.
+ *
+ * Drawing goes into a back buffer the size the window was created with,
+ * and flush() puts it on the window at once, so a frame is never seen
+ * half drawn. The window is repaired from the back buffer when uncovered
+ * without asking the drawing to paint again. There are three ways of
+ * doing this (see presentMode); the constructor takes the best one the
+ * display supports, up to the one asked for.
  * */    
  
 #include <X11/Xlib.h>   // Every Xlib program must include this
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
 #include "gcontext.h"	// base class
+#include "fbcontext.h"
+#include <vector>
+#include <memory>
 
 class X11Context : public GraphicsContext
 {
 	public:
+		// How frames get to the window
+		enum presentMode {
+			// Primitives are sent to the server as X requests and
+			// drawn into a Pixmap, which is copied to the window.
+			// Works with every display.
+			PRESENT_PIXMAP,
+			// Frames are drawn here, in a FramebufferContext, and sent
+			// whole with XPutImage: one bulk transfer instead of a
+			// request per batch of primitives. Needs a 24 bit true
+			// color display.
+			PRESENT_IMAGE,
+			// Like PRESENT_IMAGE, but frames are drawn straight into
+			// memory shared with the server (MIT-SHM) rather than
+			// sent over the connection. Needs a local server with
+			// the extension.
+			PRESENT_SHM
+		};
+		
 		// Default Constructor
+		// @param mode the preferred way of presenting frames. If the
+		//		  display can't do it, the next one down is tried.
 		X11Context(unsigned int sizex = 400, unsigned int sizey = 400,
-                           unsigned int bg_color = GraphicsContext::BLACK);
+                           unsigned int bg_color = GraphicsContext::BLACK,
+                           presentMode mode = PRESENT_SHM);
 
 		// Destructor
 		virtual ~X11Context();
@@ -24,30 +57,172 @@ class X11Context : public GraphicsContext
 		void setPixel(int x, int y);
 		unsigned int getPixel(int x, int y);
 		void clear();
+		
+		// With PRESENT_PIXMAP the pixels are read from the server, a
+		// rectangle per XGetImage, and kept: only what was drawn since
+		// the last read is fetched again. Pixels set in MODE_NORMAL are
+		// written into the kept copy as well, so only lines, circles and
+		// XOR drawing make a fetch. In the other modes they're read from
+		// the frame.
+		void getPixels(int x, int y, int width, int height,
+				unsigned int* pixels);
 
 		/*
-		 * These are not currently overridden, but could be as XLib
-		 * has much more efficient implementations available.
+		 * Points, lines and circles are not sent one request at a
+		 * time. They are queued and sent as XDrawPoints/XDrawSegments/
+		 * XDrawArcs batches when the color or mode changes, before a
+		 * pixel is read back, and on flush.
 		 */
 		void drawLine(int x1, int y1, int x2, int y2);
-		void drawCircle(int x, int y, int radius);
+		void drawCircle(int x, int y, unsigned int radius);
+		void flush();
+		
+		// Drawn into the client side buffer in PRESENT_IMAGE and
+		// PRESENT_SHM, the default way otherwise
+		void fillTriangle(double x0, double y0, double z0,
+				double x1, double y1, double z1,
+				double x2, double y2, double z2);
+		void clearDepth();
+		
+		// @returns the way frames are presented, after any fallback
+		presentMode getPresentMode() const;
 
 
 		// Event looop functions
+		// Events are handled in batches: everything already queued is
+		// taken at once, mouse motion is merged into its last position,
+		// and uncovered areas into one rectangle. Paints asked for with
+		// repaint are done after the batch, at most once per
+		// FRAME_INTERVAL_MS, so however slow a frame is, input is never
+		// more than a frame and a batch behind.
 		void runLoop(DrawingBase* drawing);		
 		
 		// we will use endLoop provided by base class
 		
+		// Within runLoop, marks the drawing for painting after the
+		// current batch of events; outside it, paints right away
+		void repaint(DrawingBase* drawing);
+		
+		// the shortest time between two paints, about one refresh of
+		// a 60Hz display
+		static const int FRAME_INTERVAL_MS = 16;
+		
 		// Utility functions
 		int getWindowWidth();
 		int getWindowHeight();
 		
 
 	private:
+		// sends the queued primitives, without flushing the connection
+		void submitPending();
+		
+		// passes one event on to the drawing. Expose events are only
+		// added to the exposed rectangle.
+		void handleEvent(DrawingBase* drawing, XEvent &e);
+		
+		// notes that the back buffer may have changed within the given
+		// bounds (inclusive), so the readback there is out of date
+		void markDrawn(int left, int top, int right, int bottom);
+		
+		// fetches the part of the back buffer drawn since the last
+		// readback, in one XGetImage
+		void refreshReadback();
+		
+		// @returns the 24-bit RGB color of a pixel value of the visual,
+		//			for true color visuals
+		unsigned int toRGB(unsigned long pixel) const;
+		
+		// copies the given area of the back buffer to the window
+		void present(int x, int y, unsigned int width, unsigned int height);
+		
+		// PRESENT_SHM: waits until the server has read the shared pixels
+		// for every XShmPutImage sent, so they can be drawn over
+		void waitForShm();
+		
+		// @returns whether the display takes the frame's 0x00RRGGBB
+		//			pixels as they are, as the image modes need
+		bool takesFramePixels();
+		
+		// Sets up the client side buffer and the XImage wrapping it
+		// @returns false if the display can't show it, leaving nothing
+		//			set up
+		bool createImage();
+		
+		// Sets up the XImage in memory shared with the server, and the
+		// frame drawing into it
+		// @returns false if the server can't share memory with us,
+		//			leaving nothing set up
+		bool createShmImage();
+		
 		// X11 stuff - specific to this context
 		Display* display;
 		Window window;
 		GC graphics_context;
+		
+		// PRESENT_PIXMAP: what is drawn into (None in the other modes).
+		// copy_context is what it, or the image, is copied to the window
+		// with (the drawing GC may be in XOR mode)
+		Pixmap backBuffer;
+		GC copy_context;
+		unsigned int bufferWidth, bufferHeight;
+		unsigned int background;
+		// true once a frame has been flushed, so the back buffer holds
+		// what the window should show
+		bool presented;
+		
+		presentMode mode;
+		// PRESENT_IMAGE and PRESENT_SHM: where the frame is drawn, and
+		// the image it's presented through. With PRESENT_IMAGE the
+		// image uses the frame's pixels; with PRESENT_SHM the frame
+		// draws into the image's, in shmInfo.
+		std::unique_ptr<FramebufferContext> frame;
+		XImage* image;
+		XShmSegmentInfo shmInfo;
+		// PRESENT_SHM: the type of the events saying the server has
+		// read the shared pixels, and how many are still to come
+		int shmCompletionType;
+		unsigned int shmPending;
+		
+		// queued primitives, all in the GC's current color and mode
+		std::vector<XPoint> pendingPoints;
+		std::vector<XSegment> pendingSegments;
+		std::vector<XArc> pendingArcs;
+		
+		// the color set in the GC, to skip redundant changes
+		unsigned int currentColor;
+		// the GC draws with XOR rather than copying
+		bool xorMode;
+		
+		// PRESENT_PIXMAP: the back buffer's pixels as 24-bit RGB, up to
+		// date outside the drawn rectangle (empty if left > right)
+		std::vector<uint32_t> readback;
+		int drawnLeft, drawnTop, drawnRight, drawnBottom;
+		
+		// where one color channel is in the visual's pixel values
+		struct Channel
+		{
+			unsigned long mask;
+			int shift;
+			// maximum value of the channel once shifted down
+			unsigned long max;
+		};
+		// true color visuals are converted with these, others by
+		// looking the pixel values up in the colormap
+		bool trueColor;
+		Channel red, green, blue;
+		// pixel values are the 24-bit RGB colors set, so what setPixel
+		// draws can be put in the readback without asking the server
+		bool rgbPixels;
+		
+		// set by repaint during runLoop, cleared by the next paint
+		bool paintRequested;
+		// the area uncovered during the current batch of events (empty
+		// if left > right), repaired once the batch is handled
+		int exposedLeft, exposedTop, exposedRight, exposedBottom;
+		
+		// past this many queued primitives they are sent early, which
+		// keeps the queues from growing without bound
+		static const unsigned int MAX_PENDING = 65536;
 
 };
 
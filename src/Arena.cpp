@@ -0,0 +1,119 @@
+// @file Arena.cpp
+// Implementation of the region allocator
+
+#include "Arena.h"
+#include <cstdint>	// for uintptr_t
+
+Arena::Arena()
+	: blocks(NULL), position(NULL), end(NULL)
+{ }
+
+Arena::~Arena()
+{
+	while (blocks)
+	{
+		Block* next = blocks->next;
+		::operator delete(blocks);
+		blocks = next;
+	}
+}
+
+Arena::Block* Arena::newBlock(size_t bytes)
+{
+	Block* block = static_cast<Block*>(::operator new(sizeof(Block) + bytes));
+	block->next = NULL;
+	block->size = bytes;
+	return block;
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment)
+{
+	uintptr_t start = ((uintptr_t)position + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (blocks && start + bytes <= (uintptr_t)end)
+	{
+		position = (char*)(start + bytes);
+		return (void*)start;
+	}
+
+	// Something too big to share a block gets one of its own, behind the
+	// newest, which goes on being allocated from
+	if (bytes > BLOCK_SIZE/4)
+	{
+		Block* block = newBlock(bytes);
+		if (blocks)
+		{
+			block->next = blocks->next;
+			blocks->next = block;
+		}
+		else
+		{
+			// nothing to allocate from yet: it's full from the start
+			blocks = block;
+			position = end = (char*)(block + 1) + bytes;
+		}
+		return block + 1;
+	}
+
+	// the rest of the newest block goes unused
+	Block* block = newBlock(BLOCK_SIZE);
+	block->next = blocks;
+	blocks = block;
+	position = (char*)(block + 1) + bytes;
+	end = (char*)(block + 1) + BLOCK_SIZE;
+	return block + 1;
+}
+
+void Arena::absorb(Arena &other)
+{
+	if (!other.blocks)
+	{
+		return;
+	}
+	if (!blocks)
+	{
+		blocks = other.blocks;
+		position = other.position;
+		end = other.end;
+	}
+	else
+	{
+		// behind the newest block, which goes on being allocated from
+		Block* last = other.blocks;
+		while (last->next)
+		{
+			last = last->next;
+		}
+		last->next = blocks->next;
+		blocks->next = other.blocks;
+	}
+	other.blocks = NULL;
+	other.position = other.end = NULL;
+}
+
+void Arena::release()
+{
+	if (!blocks)
+	{
+		return;
+	}
+	Block* block = blocks->next;
+	while (block)
+	{
+		Block* next = block->next;
+		::operator delete(block);
+		block = next;
+	}
+	blocks->next = NULL;
+	position = (char*)(blocks + 1);
+	end = position + blocks->size;
+}
+
+size_t Arena::getCapacity() const
+{
+	size_t capacity = 0;
+	for (Block* block = blocks; block; block = block->next)
+	{
+		capacity += block->size;
+	}
+	return capacity;
+}
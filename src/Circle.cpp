@@ -28,6 +28,10 @@ Circle::Circle(const Circle &s)
 	: Shape(s)
 { }
 
+Circle::Circle(const Circle &s, Arena &arena)
+	: Shape(s, arena)
+{ }
+
 Circle::~Circle()
 {
 	// does nothing, but must be defined
@@ -47,11 +51,23 @@ void Circle::draw(GraphicsContext *gc, ViewContext *vc) const
 	gc->setColor(this->color);
 	
 	// Convert to device coordinates
-	matrix devPts = vc->modelToDevice(this->pts);
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
+	
+	// the circle is drawn whole or not at all: not if its center or the
+	// point on it is behind the near plane or far off the device
+	for (int p=0; p<2; p++)
+	{
+		if (vc->outcode(clipPts.uncheckedAt(0, p), clipPts.uncheckedAt(1, p),
+				clipPts.uncheckedAt(3, p)) & ViewContext::OUT_NEEDS_CLIP)
+		{
+			return;
+		}
+	}
 	
 	// Compute the radius...
-	double dx = (devPts[0][0] - devPts[0][1]);
-	double dy = (devPts[1][0] - devPts[1][1]);
+	double dx = (devPts.uncheckedAt(0, 0) - devPts.uncheckedAt(0, 1));
+	double dy = (devPts.uncheckedAt(1, 0) - devPts.uncheckedAt(1, 1));
 	// Check if one of them is zero. Please no sqrt!
 	double r;
 	if (dx == 0) r = std::abs(dy);
@@ -59,7 +75,12 @@ void Circle::draw(GraphicsContext *gc, ViewContext *vc) const
 	else r = std::sqrt(dx*dx + dy*dy);
 	
 	// utilize Circle drawing algorithm in GraphicsContext
-	gc->drawCircle(devPts[0][0], devPts[1][0], r);
+	gc->drawCircle(devPts.uncheckedAt(0, 0), devPts.uncheckedAt(1, 0), r);
+}
+
+bool Circle::getModelBounds(double low[3], double high[3]) const
+{
+	return false;
 }
 
 void Circle::out(std::ostream & os) const
@@ -129,6 +150,16 @@ Shape* Circle::clone() const
 	return c;
 }
 
+Shape* Circle::clone(Arena &arena) const
+{
+	return new (arena.allocate<Circle>()) Circle(*this, arena);
+}
+
+char Circle::getType() const
+{
+	return 'c';
+}
+
 std::ostream& operator<<(std::ostream &os, const Circle &c)
 {
 	c.out(os);
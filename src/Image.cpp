@@ -2,19 +2,29 @@
 // Implementation file for the Image class
 
 #include "Image.h"
+#include "MappedFile.h"
+#include "StlParser.h"
+#include "SceneFile.h"
+#include "ImgParser.h"
+#include <cstring> // for memset
+#include <algorithm> // for std::min
+#include <chrono> // for timing parseStl
+#include <memory> // for std::unique_ptr
 
 Image::Image()
-	: spaceLevel(0)
+	: packed(false), spaceLevel(0), loadVerbosity(LOAD_QUIET), filled(false), 
+	  revision(0)
 { }
 
 Image::Image(const Image &i)
-	: spaceLevel(i.spaceLevel)
+	: arrays(i.arrays), packed(i.packed), spaceLevel(i.spaceLevel), 
+	  loadVerbosity(i.loadVerbosity), filled(i.filled), revision(0)
 {	
 	// deep-Copy each Shape pointer found in the image's shapes
-	std::vector<Shape*>::const_iterator it;
+	std::vector<OwnedShape>::const_iterator it;
 	for (it = i.shapes.begin(); it != i.shapes.end(); it++)
 	{
-		this->add(*it);
+		this->add(it->get());
 	}
 }
 
@@ -28,15 +38,20 @@ Image& Image::operator=(const Image &rhs)
 	// First, destroy all shapes in the container
 	this->erase();
 	
-	// Now, deep-copy all shapes in rhs
-	std::vector<Shape*>::const_iterator it;
+	// Now, deep-copy all shapes in rhs, packed or not
+	this->packed = rhs.packed;
+	this->arrays = rhs.arrays;
+	std::vector<OwnedShape>::const_iterator it;
 	for (it = rhs.shapes.begin(); it != rhs.shapes.end(); it++)
 	{
-		this->add(*it);
+		this->add(it->get());
 	}
 	
-	// also copy the spaceLevel of the image
+	// also copy the spaceLevel, verbosity and fill mode of the image
 	this->spaceLevel = rhs.spaceLevel;
+	this->loadVerbosity = rhs.loadVerbosity;
+	this->filled = rhs.filled;
+	revision++;
 	
 	return *this;
 	
@@ -44,44 +59,203 @@ Image& Image::operator=(const Image &rhs)
 
 void Image::add(const Shape *s)
 {
-	// Clone shape and add the clone to the container
-	shapes.push_back(s->clone());
+	// Clone shape and add the clone to the container, out of the arena
+	if (packed)
+	{
+		arrays.add(*s);
+	}
+	else
+	{
+		shapes.push_back(inArena(s->clone(arena)));
+	}
+	revision++;
+}
+
+void Image::add(std::unique_ptr<Shape> s)
+{
+	if (packed)
+	{
+		arrays.add(std::move(s));
+	}
+	else
+	{
+		// s lets go only once the container has room for it
+		shapes.push_back(OwnedShape(NULL, ShapeOwner{ShapeOwner::DELETE}));
+		shapes.back().reset(s.release());
+	}
+	revision++;
+}
+
+void Image::reserve(size_t n)
+{
+	if (packed)
+	{
+		arrays.reserve(n);
+	}
+	else
+	{
+		shapes.reserve(n);
+	}
+}
+
+size_t Image::getNumShapes() const
+{
+	return packed ? arrays.size() : shapes.size();
+}
+
+Shape* Image::getShape(size_t i) const
+{
+	if (i >= getNumShapes())
+	{
+		throw imageException("no shape " + std::to_string(i) + " in the image");
+	}
+	return packed ? arrays.get(i) : shapes[i]->clone();
+}
+
+void Image::setShape(size_t i, const Shape *s)
+{
+	if (i >= getNumShapes())
+	{
+		throw imageException("no shape " + std::to_string(i) + " in the image");
+	}
+	if (packed)
+	{
+		arrays.set(i, *s);
+	}
+	else
+	{
+		// On the heap: an edit gives back the memory of the shape it
+		// replaces, and a copy in the arena would stay there until erase
+		shapes[i] = OwnedShape(s->clone(), ShapeOwner{ShapeOwner::DELETE});
+	}
+	revision++;
+}
+
+void Image::setPacked(bool packed)
+{
+	if (this->packed == packed)
+	{
+		return;
+	}
+	if (packed)
+	{
+		for (unsigned int i=0; i<shapes.size(); i++)
+		{
+			arrays.add(*shapes[i]);
+		}
+		shapes.clear();
+		arena.release();
+	}
+	else
+	{
+		shapes.reserve(arrays.size());
+		for (unsigned int i=0; i<arrays.size(); i++)
+		{
+			shapes.push_back(OwnedShape(arrays.get(i), 
+					ShapeOwner{ShapeOwner::DELETE}));
+		}
+		arrays.clear();
+	}
+	this->packed = packed;
+	// drawn in another order
+	revision++;
+}
+
+bool Image::isPacked() const
+{
+	return packed;
 }
 
 void Image::draw(GraphicsContext *gc, ViewContext *vc)
 {
-	// draw all shapes!
-	std::vector<Shape*>::const_iterator it;
+	// a new frame: nothing culled, and nothing hides anything yet
+	vc->resetCullStats();
+	ViewContext::CullStats &stats = vc->getCullStats();
+	if (filled)
+	{
+		gc->clearDepth();
+	}
+	
+	// a loop per type over its arrays
+	if (packed)
+	{
+		arrays.draw(gc, vc, filled);
+		return;
+	}
+	
+	// draw all shapes in view!
+	std::vector<OwnedShape>::const_iterator it;
 	for (it = shapes.begin(); it != shapes.end(); it++)
 	{
-		(*it)->draw(gc, vc);
+		double low[3], high[3];
+		if ((*it)->getModelBounds(low, high) && !vc->isBoxVisible(low, high))
+		{
+			stats.shapesCulled++;
+			continue;
+		}
+		stats.shapesDrawn++;
+		if (filled)
+		{
+			(*it)->fill(gc, vc);
+		}
+		else
+		{
+			(*it)->draw(gc, vc);
+		}
+	}
+}
+
+void Image::setFilled(bool filled)
+{
+	if (this->filled != filled)
+	{
+		this->filled = filled;
+		revision++;
 	}
 }
 
+bool Image::isFilled() const
+{
+	return filled;
+}
+
+unsigned long Image::getRevision() const
+{
+	return revision;
+}
+
 void Image::setSpaceLevel(unsigned int spaceLevel)
 {
 	this->spaceLevel = spaceLevel;
 }
 
+void Image::setLoadVerbosity(LoadVerbosity verbosity)
+{
+	this->loadVerbosity = verbosity;
+}
+
 std::ostream& Image::out(std::ostream &os) const
 {
-	std::vector<Shape*>::const_iterator it;
-	
 	// print spacelevel*' ' after every shape so that
 	// the first line of next shape can be printed on the same level
 	const std::string NEW_LINE_PAD(this->spaceLevel, ' ');
 	
-	for (unsigned int i=0; i<shapes.size(); i++)
+	size_t numShapes = getNumShapes();
+	for (unsigned int i=0; i<numShapes; i++)
 	{
+		// packed shapes are written through a copy
+		std::unique_ptr<Shape> copy(packed ? arrays.get(i) : NULL);
+		Shape* shape = packed ? copy.get() : shapes[i].get();
+		
 		// set the space level for each shape in case the output is appended to 
 		// extra text
-		shapes[i]->setSpaceLevel(this->spaceLevel);
+		shape->setSpaceLevel(this->spaceLevel);
 
-		os << *shapes[i];
+		os << *shape;
 		
 		// if not the last shape, set up the line pad for the next
 		// so it prints on the same padding as the previous line...
-		if (i != shapes.size() - 1)
+		if (i != numShapes - 1)
 		{
 			os << std::endl << NEW_LINE_PAD;
 		}
@@ -90,11 +264,52 @@ std::ostream& Image::out(std::ostream &os) const
 	return os;
 }
 
+template <typename Read>
+void Image::addRead(Shape &blank, Read read)
+{
+	if (packed)
+	{
+		read(blank);
+		arrays.add(blank);
+	}
+	else
+	{
+		Shape* shape = blank.clone(arena);
+		try
+		{
+			read(*shape);
+		}
+		catch (...)
+		{
+			// the arena takes back its memory, not what it holds
+			shape->~Shape();
+			throw;
+		}
+		// disposed of by what it holds once read: a polygon may have
+		// outgrown its points in the arena
+		shapes.push_back(inArena(shape));
+	}
+	revision++;
+}
+
 std::istream& Image::in(std::istream &is)
 {
 	// clear image, since new data is being input
 	this->erase();
 	
+	// A blank shape of each type to build the shapes read from. Meshes
+	// are new'd and handed over instead: their arrays are worth not
+	// copying even when packed.
+	const matrix blank(4, 4);
+	Point p(1,2,3,0xFFFFFF);
+	Line l(blank, 0);
+	Triangle t(blank, 0);
+	Circle c(blank, 0);
+	Rectangle r(blank, 0);
+	Polygon g(blank, 0);
+	
+	auto readText = [&is](Shape &shape) { is >> shape; };
+	
 	// parse in a character to determine type
 	char shapeSpecifier = '\0';
 	
@@ -104,147 +319,319 @@ std::istream& Image::in(std::istream &is)
 	{
 		switch (shapeSpecifier)
 		{
-			case 'p': 
+			case 'p': addRead(p, readText); break;
+			case 'l': addRead(l, readText); break;
+			case 't': addRead(t, readText); break;
+			case 'c': addRead(c, readText); break;
+			case 'r': addRead(r, readText); break;
+			case 'g': addRead(g, readText); break;
+			case 'm':
 			{
-				Point p(1,2,3,0xFFFFFF);
-				is >> p;
-				this->add(&p);
+				std::unique_ptr<Mesh> m(new Mesh(0));
+				is >> *m;
+				this->add(std::move(m));
 			}
 			break;
-			case 'l':
+			default:
+				detectedNonShape = true;
+		}
+	}
+	
+	return is;
+}
+
+std::ostream& Image::outBinary(std::ostream &os, bool compress) const
+{
+	SceneFile::Header header;
+	std::memset(&header, 0, sizeof(header));
+	header.numShapes = getNumShapes();
+	
+	std::string payload;
+	SceneFile::Writer writer(payload);
+	for (unsigned int i=0; i<header.numShapes; i++)
+	{
+		std::unique_ptr<Shape> copy(packed ? arrays.get(i) : NULL);
+		const Shape* shape = packed ? copy.get() : shapes[i].get();
+		int type = SceneFile::typeIndex(shape->getType());
+		if (type < SceneFile::NUM_TYPES)
+		{
+			header.typeCounts[type]++;
+		}
+		shape->outBinary(writer);
+	}
+	
+	try
+	{
+		SceneFile::write(os, header, payload, compress);
+	}
+	catch (fileException &e)
+	{
+		throw imageException(e.what());
+	}
+	return os;
+}
+
+void Image::inBinary(const char* data, size_t size)
+{
+	// clear image, since new data is being input
+	this->erase();
+	
+	try
+	{
+		SceneFile::Header header;
+		std::vector<char> storage;
+		const char* payload = SceneFile::read(data, size, header, storage);
+		SceneFile::Reader reader(payload, payload + header.payloadSize);
+		
+		// The counts are as yet unchecked: room is made for no more shapes
+		// than the payload could hold
+		size_t most = header.payloadSize / sizeof(SceneFile::Record);
+		reserve(std::min<size_t>(header.numShapes, most));
+		if (packed)
+		{
+			// and in each type's arrays
+			for (int t=0; t<SceneFile::NUM_TYPES; t++)
 			{
-				matrix m_l(4,2);
-				Line l(m_l, 0);
-				is >> l;
-				this->add(&l);
+				arrays.reserve(SceneFile::TYPES[t], 
+						std::min<size_t>(header.typeCounts[t], most));
 			}
-			break;
-			case 't':
+		}
+		// as in, a blank shape of each type to build the shapes read from
+		const matrix blank(4, 4);
+		Point p(1,2,3,0xFFFFFF);
+		Line l(blank, 0);
+		Triangle t(blank, 0);
+		Circle c(blank, 0);
+		Rectangle r(blank, 0);
+		Polygon g(blank, 0);
+		while (reader.more())
+		{
+			const SceneFile::Record &record = reader.next();
+			auto readRecord = [&reader, &record](Shape &shape)
+			{
+				shape.inBinary(reader, record);
+			};
+			switch (record.type)
 			{
-				matrix m_t(4,3);
-				Triangle t(m_t, 0);
-				is >> t;
-				this->add(&t);
+				case 'p': addRead(p, readRecord); break;
+				case 'l': addRead(l, readRecord); break;
+				case 't': addRead(t, readRecord); break;
+				case 'c': addRead(c, readRecord); break;
+				case 'r': addRead(r, readRecord); break;
+				case 'g': addRead(g, readRecord); break;
+				case 'm':
+				{
+					std::unique_ptr<Mesh> m(new Mesh(0));
+					m->inBinary(reader, record);
+					this->add(std::move(m));
+				}
+				break;
+				default:
+					throw imageException("binary image holds an unknown shape type");
 			}
-			break;
-			case 'c':
+		}
+		if (getNumShapes() != header.numShapes)
+		{
+			throw imageException("binary image has the wrong number of shapes");
+		}
+	}
+	catch (fileException &e)
+	{
+		this->erase();
+		throw imageException(e.what());
+	}
+	catch (shapeException &e)
+	{
+		this->erase();
+		throw imageException(e.what());
+	}
+	catch (imageException &e)
+	{
+		this->erase();
+		throw;
+	}
+}
+
+void Image::save(const std::string &path, SaveFormat format) const
+{
+	std::ofstream ofs(path, std::ios::binary);
+	if (!ofs)
+	{
+		throw imageException("could not open " + path + " for writing");
+	}
+	if (format == SAVE_TEXT)
+	{
+		out(ofs);
+	}
+	else
+	{
+		outBinary(ofs, format == SAVE_COMPRESSED);
+	}
+	ofs.close();
+	if (!ofs)
+	{
+		throw imageException("could not write " + path);
+	}
+}
+
+void Image::load(const std::string &path)
+{
+	try
+	{
+		// binary files are read in place out of the mapping
+		MappedFile file(path);
+		if (SceneFile::isBinary(file.data(), file.size()))
+		{
+			inBinary(file.data(), file.size());
+		}
+		else
+		{
+			// built straight into the image's arena, no copies unless packed
+			this->erase();
+			std::vector<Shape*> parsed;
+			ImgParser::parseParallel(file.data(), file.data() + file.size(), 
+					path, parsed, arena, ThreadPool::shared());
+			reserve(parsed.size());
+			if (packed)
 			{
-				matrix m_c(4,2);
-				Circle c(m_c, 0);
-				is >> c;
-				this->add(&c);
+				// each type's arrays are made room for at once
+				size_t counts[SceneFile::NUM_TYPES] = {0};
+				size_t polygonPoints = 0;
+				for (const Shape* shape : parsed)
+				{
+					counts[SceneFile::typeIndex(shape->getType())]++;
+					if (shape->getType() == 'g')
+					{
+						polygonPoints += shape->getNumPoints();
+					}
+				}
+				for (int t=0; t<SceneFile::NUM_TYPES; t++)
+				{
+					arrays.reserve(SceneFile::TYPES[t], counts[t], 
+							SceneFile::TYPES[t] == 'g' ? polygonPoints : 0);
+				}
 			}
-			break;
-			case 'r':
+			for (unsigned int i=0; i<parsed.size(); i++)
 			{
-				matrix m_r(4,4);
-				Rectangle r(m_r, 0);
-				is >> r;
-				this->add(&r);
+				OwnedShape shape = inArena(parsed[i]);
+				if (packed)
+				{
+					arrays.add(*shape);
+				}
+				else
+				{
+					shapes.push_back(std::move(shape));
+				}
 			}
-			break;
-			case 'g':
+			if (packed)
 			{
-				matrix m_g(4,1);
-				Polygon g(m_g, 0);
-				is >> g;
-				this->add(&g);
+				arena.release();
 			}
-			break;
-			default:
-				detectedNonShape = true;
+			revision++;
 		}
 	}
-	
-	return is;
+	catch (fileException &e)
+	{
+		throw imageException(e.what());
+	}
 }
 
-void Image::parseStl(const std::string &stlPath) throw(imageException)
+void Image::parseStl(const std::string &stlPath)
 {
-	std::ifstream stlFile(stlPath.c_str());
-
-	// parse all facets within the file to create summary
-	while (stlFile){
-		// if at a valid facet start, it gets parsed
-		Triangle* facet = parseFacet(stlFile);
-		if (facet)
+	// all facets go into one mesh: contiguous vertex arrays instead of
+	// a Triangle (and its matrix) per facet. The image takes the mesh over
+	// once it's parsed, so the arrays are never copied.
+	std::unique_ptr<Mesh> model(new Mesh());
+	Mesh &mesh = *model;
+	size_t bytes = 0;
+	bool binary = false;
+	
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	try
+	{
+		// both formats are parsed straight out of the mapped file
+		MappedFile file(stlPath);
+		bytes = file.size();
+		binary = StlParser::isBinary(file.data(), file.size());
+		if (binary)
 		{
-			// valid facet parsed is not NULL!
-			add(facet);
-			delete facet;
+			StlParser::parseBinary(file.data(), file.size(), mesh);
+		}
+		else
+		{
+			StlParser::parseAsciiParallel(file.data(), file.data() + file.size(),
+					mesh, ThreadPool::shared());
 		}
 	}
-
+	catch (fileException &e)
+	{
+		throw imageException(e.what());
+	}
+	unsigned int numCorners = mesh.getNumVertices();
+	// as many as the file has
+	unsigned int numFacets = mesh.getNumFacets();
+	mesh.weld();
+	// mesh lives on in the image
+	add(std::move(model));
+	std::chrono::duration<double, std::milli> elapsed = 
+			std::chrono::steady_clock::now() - start;
+	
+	if (loadVerbosity == LOAD_QUIET)
+	{
+		return;
+	}
+	
 	// The file was parsed completely. Thank you for your service!
-	std::cout << "Parsed content:" << std::endl;
-	std::cout << *this << std::endl;
-	stlFile.close();
-
+	std::cout << std::dec << "Loaded " << stlPath << (binary ? " (binary STL)" : " (ASCII STL)") 
+			<< std::endl;
+	std::cout << "  facets: " << numFacets << " (" << numFacets - mesh.getNumFacets() 
+			<< " dropped)" << std::endl;
+	std::cout << "  vertices: " << mesh.getNumVertices() << " (welded from " 
+			<< numCorners << ")" << std::endl;
+	std::cout << "  bytes:  " << bytes << std::endl;
+	std::cout << "  time:   " << elapsed.count() << " ms" << std::endl;
+	if (mesh.getNumVertices() > 0)
+	{
+		double low[3], high[3];
+		mesh.getBounds(low, high);
+		std::cout << "  bounds: [" << low[0] << " " << low[1] << " " << low[2] 
+				<< "] to [" << high[0] << " " << high[1] << " " << high[2] << "]"
+				<< std::endl;
+	}
+	
+	if (loadVerbosity == LOAD_DUMP)
+	{
+		std::cout << "Parsed content:" << std::endl;
+		std::cout << *this << std::endl;
+	}
 }
 
 void Image::erase()
 {	
-	// Loop through all shapes! delete shapes and remove from container!
-	std::vector<Shape*>::iterator it;
-	for (it = shapes.begin(); it != shapes.end(); it++)
-	{
-		delete *it;
-	}
+	// Loop through all shapes! They're deleted or destroyed as they came,
+	// though most in the arena need nothing done, and the memory of those
+	// in the arena is given back a block at a time
 	shapes.clear();
+	arena.release();
+	arrays.clear();
+	revision++;
 }
 
 
-Triangle* Image::parseFacet(std::ifstream & stlFile) const throw(imageException) {
-	std::string s1, s2, line;
-	matrix v(3,3);
-	
-	getline(stlFile, line);
-	// Ensure we're at the start of a valid facet before parsing data
-	// once confirmed to be a facet, we throw exceptions if parsing fails
-	if(not isFacetStart(line))
-		return NULL;
-	
-	// confirm "outer loop"
-	stlFile >> s1 >> s2;
-	if (s1.compare("outer") != 0 or s2.compare("loop") != 0) 
-		throw imageException("Encountered facet with no outer loop");
-	
-	// parse "vertex <double> <double> <double>" 3 times
-	for(int i = 0; i<3; i++){
-		stlFile >> s1;
-		if (s1.compare("vertex") != 0) 
-			throw imageException("failed while parsing facet vertices");
-		stlFile >> v[0][i] >> v[1][i] >> v[2][i];
-	}
-	// confirm "endloop"
-	stlFile >> s1;
-	if (s1.compare("endloop") != 0) 
-		throw imageException("Encountered facet with no endloop");
-	// confirm "endfacet"
-	stlFile >> s1;
-	if (s1.compare("endfacet") != 0) 
-		throw imageException("Encountered faced with no endfacet");
-	
-	// remove '\n' after having obtained "endfacet" for the getline next iteration
-	stlFile.ignore(10, '\n');
-	
-	// we have the vertices, create the triangle		
-	return new Triangle(v);
+void Image::ShapeOwner::operator()(Shape *s) const
+{
+	switch (disposal)
+	{
+		case DELETE: delete s; break;
+		case DESTROY: s->~Shape(); break;
+		case NOTHING: break;
+	}
 }
 
-bool Image::isFacetStart(const std::string &line) const {
-	bool output = false;
-	std::string s1, s2;
-	
-	std::stringstream ss(line);
-	// TODO: is this safe? what if the line is just "beep\0" ? Will it attempt to read invalid memory?
-	ss >> s1 >> s2;
-	// first word must be 'facet', second word must be "normal"
-	if (s1.compare("facet") == 0 and s2.compare("normal") == 0){
-		output = true;
-	}
-	
-	return output;
+Image::OwnedShape Image::inArena(Shape *s)
+{
+	return OwnedShape(s, ShapeOwner{s->ownsMemory() ? ShapeOwner::DESTROY : 
+			ShapeOwner::NOTHING});
 }
 
 std::ostream& operator<<(std::ostream &os, const Image &o)
@@ -0,0 +1,381 @@
+// @file ImgParser.cpp
+// Implementation of the text image parser
+
+#include "ImgParser.h"
+#include <cstring>	// for strlen/memcmp/memchr
+#include <cstdio>	// for snprintf
+#include <charconv>	// for std::from_chars
+#include <memory>	// for std::unique_ptr
+#include <algorithm> // for std::count
+
+// whitespace as far as iostream's >> is concerned
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || 
+			c == '\f';
+}
+
+// @returns the name Image::out's shape specifier stands for
+static std::string typeName(char type)
+{
+	switch (type)
+	{
+		case 'p': return "point";
+		case 'l': return "line";
+		case 't': return "triangle";
+		case 'c': return "circle";
+		case 'r': return "rectangle";
+		case 'g': return "polygon";
+		default: return "mesh";
+	}
+}
+
+void ImgParser::skipSpace(Cursor &cur)
+{
+	while (cur.pos < cur.end && isSpace(*cur.pos))
+	{
+		cur.pos++;
+	}
+}
+
+bool ImgParser::accept(Cursor &cur, const char* text)
+{
+	skipSpace(cur);
+	size_t length = strlen(text);
+	if ((size_t)(cur.end - cur.pos) < length || memcmp(cur.pos, text, length) != 0)
+	{
+		return false;
+	}
+	cur.pos += length;
+	return true;
+}
+
+void ImgParser::expect(Cursor &cur, const char* text)
+{
+	if (!accept(cur, text))
+	{
+		fail(cur, std::string("\"") + text + "\"");
+	}
+}
+
+double ImgParser::parseNumber(Cursor &cur)
+{
+	skipSpace(cur);
+	// from_chars doesn't take an explicit plus sign, >> does
+	if (cur.pos < cur.end && *cur.pos == '+')
+	{
+		cur.pos++;
+	}
+	double value;
+	std::from_chars_result result = std::from_chars(cur.pos, cur.end, value);
+	if (result.ec != std::errc())
+	{
+		fail(cur, "a number");
+	}
+	cur.pos = result.ptr;
+	return value;
+}
+
+unsigned long ImgParser::parseUnsigned(Cursor &cur, int base)
+{
+	skipSpace(cur);
+	unsigned long value;
+	std::from_chars_result result = std::from_chars(cur.pos, cur.end, value, base);
+	if (result.ec != std::errc())
+	{
+		fail(cur, base == 16 ? "a hexadecimal number" : "a whole number");
+	}
+	cur.pos = result.ptr;
+	return value;
+}
+
+void ImgParser::fail(const Cursor &cur, const std::string &what)
+{
+	// only worked out now: errors are rare, positions are needed for all
+	const char* lineStart = cur.pos;
+	while (lineStart > cur.begin && lineStart[-1] != '\n')
+	{
+		lineStart--;
+	}
+	size_t line = std::count(cur.begin, lineStart, '\n') + 1;
+	size_t column = cur.pos - lineStart + 1;
+	throw imageException(*cur.name + ":" + std::to_string(line) + ":" + 
+			std::to_string(column) + ": expected " + what);
+}
+
+// destroys a shape built in an arena, for std::unique_ptr
+struct DestroyShape
+{
+	void operator()(Shape* shape) const
+	{
+		shape->~Shape();
+	}
+};
+
+Shape* ImgParser::parseShape(Cursor &cur, std::vector<double> &coords,
+		Arena &arena)
+{
+	char type = *cur.pos;
+	if (SceneFile::typeIndex(type) == SceneFile::NUM_TYPES)
+	{
+		fail(cur, "a shape (one of \"" + std::string(SceneFile::TYPES) + "\")");
+	}
+	cur.pos++;
+	expect(cur, "(");
+	expect(cur, "color=");
+	if (!accept(cur, "0x"))
+	{
+		accept(cur, "0X");
+	}
+	int color = (int)parseUnsigned(cur, 16);
+	
+	// p1, which every shape has
+	coords.clear();
+	expect(cur, "p1=[");
+	for (int i=0; i<4; i++)
+	{
+		coords.push_back(parseNumber(cur));
+	}
+	expect(cur, "]'");
+	
+	// a mesh is built as its vertices and facets are read
+	std::unique_ptr<Mesh, DestroyShape> mesh;
+	if (type == 'm')
+	{
+		mesh.reset(new (arena.allocate<Mesh>()) Mesh(color));
+	}
+	
+	// the other points, vertices and facets, up to the closing parenthesis
+	while (!accept(cur, ")"))
+	{
+		unsigned int numPoints = coords.size()/4;
+		if (mesh && accept(cur, "v=["))
+		{
+			double x = parseNumber(cur);
+			double y = parseNumber(cur);
+			double z = parseNumber(cur);
+			mesh->addVertex(x, y, z);
+		}
+		else if (mesh && accept(cur, "f=["))
+		{
+			unsigned int v[3];
+			for (int i=0; i<3; i++)
+			{
+				skipSpace(cur);
+				Cursor at = cur;
+				unsigned long index = parseUnsigned(cur, 10);
+				if (index >= mesh->getNumVertices())
+				{
+					fail(at, "the index of a vertex (there are " + 
+							std::to_string(mesh->getNumVertices()) + ")");
+				}
+				v[i] = index;
+			}
+			mesh->addFacet(v[0], v[1], v[2]);
+		}
+		else if (!mesh && type != 'p' && accept(cur, "p"))
+		{
+			// points are numbered from p2 on, in hex
+			Cursor at = cur;
+			if (parseUnsigned(cur, 16) != numPoints + 1)
+			{
+				char label[16];
+				snprintf(label, sizeof(label), "%X", numPoints + 1);
+				fail(at, std::string("point p") + label);
+			}
+			expect(cur, "=[");
+			for (int i=0; i<4; i++)
+			{
+				coords.push_back(parseNumber(cur));
+			}
+		}
+		else
+		{
+			fail(cur, mesh ? "\"v=[\", \"f=[\" or \")\"" : 
+					(type == 'p' ? "\")\"" : "another point or \")\""));
+		}
+		expect(cur, "]'");
+	}
+	
+	// the number of points has to fit the type
+	unsigned int numPoints = coords.size()/4;
+	unsigned int required = 0;
+	switch (type)
+	{
+		case 'l': case 'c': required = 2; break;
+		case 't': required = 3; break;
+		case 'r': required = 4; break;
+		case 'g': required = numPoints; break;
+		default: required = 1; break;
+	}
+	if (numPoints != required)
+	{
+		// point at the closing parenthesis
+		cur.pos--;
+		fail(cur, "a " + typeName(type) + " to have " + std::to_string(required) + 
+				" points, not " + std::to_string(numPoints));
+	}
+	
+	// Shapes are copied into the arena from blank ones of their type, as
+	// only copies go there. The points are written straight into the
+	// copy afterwards, w included.
+	static const matrix blank(4, 4);
+	static const Point point(0, 0, 0, 0);
+	static const Line line(blank, 0);
+	static const Triangle triangle(blank, 0);
+	static const Circle circle(blank, 0);
+	static const Rectangle rectangle(blank, 0);
+	Shape* shape = NULL;
+	switch (type)
+	{
+		case 'p': shape = point.clone(arena); break;
+		case 'l': shape = line.clone(arena); break;
+		case 't': shape = triangle.clone(arena); break;
+		case 'c': shape = circle.clone(arena); break;
+		case 'r': shape = rectangle.clone(arena); break;
+		case 'g': shape = Polygon(numPoints, matrix(4, numPoints), 0).clone(arena); break;
+		default: shape = mesh.release(); break;
+	}
+	shape->color = color;
+	double* data = shape->pts.data();
+	unsigned int stride = shape->pts.stride();
+	for (unsigned int c=0; c<numPoints; c++)
+	{
+		for (int r=0; r<4; r++)
+		{
+			data[r*stride + c] = coords[c*4 + r];
+		}
+	}
+	return shape;
+}
+
+void ImgParser::parseRange(const char* begin, const char* from, 
+		const char* to, const std::string &name, std::vector<Shape*> &shapes,
+		Arena &arena)
+{
+	Cursor cur = {begin, from, to, &name};
+	std::vector<Shape*> parsed;
+	std::vector<double> coords;
+	try
+	{
+		skipSpace(cur);
+		while (cur.pos < cur.end)
+		{
+			parsed.push_back(parseShape(cur, coords, arena));
+			skipSpace(cur);
+		}
+	}
+	catch (...)
+	{
+		destroy(parsed);
+		throw;
+	}
+	shapes.insert(shapes.end(), parsed.begin(), parsed.end());
+}
+
+void ImgParser::destroy(const std::vector<Shape*> &shapes)
+{
+	for (Shape* shape : shapes)
+	{
+		shape->~Shape();
+	}
+}
+
+void ImgParser::parse(const char* begin, const char* end,
+		const std::string &name, std::vector<Shape*> &shapes, Arena &arena)
+{
+	parseRange(begin, begin, end, name, shapes, arena);
+}
+
+const char* ImgParser::findShapeStart(const char* from, const char* end)
+{
+	const char* line = from;
+	while (line < end)
+	{
+		// only spaces and tabs may come before the type on its line
+		const char* pos = line;
+		while (pos < end && (*pos == ' ' || *pos == '\t'))
+		{
+			pos++;
+		}
+		if (end - pos >= 2 && pos[1] == '(' && 
+				SceneFile::typeIndex(pos[0]) < SceneFile::NUM_TYPES)
+		{
+			return line;
+		}
+		const char* newline = static_cast<const char*>(
+				memchr(pos, '\n', end - pos));
+		line = newline ? newline + 1 : end;
+	}
+	return end;
+}
+
+void ImgParser::parseParallel(const char* begin, const char* end,
+		const std::string &name, std::vector<Shape*> &shapes, Arena &arena,
+		ThreadPool &pool)
+{
+	size_t size = end - begin;
+	size_t numChunks = pool.getNumThreads() * CHUNKS_PER_THREAD;
+	if (numChunks > size / MIN_CHUNK_SIZE)
+	{
+		numChunks = size / MIN_CHUNK_SIZE;
+	}
+	if (numChunks < 2)
+	{
+		parse(begin, end, name, shapes, arena);
+		return;
+	}
+	
+	// Cut at evenly spaced points, each moved forward to the next line
+	// starting a shape. Inside a shape, lines start with its points, so
+	// the serial parser would be between shapes at each cut as well.
+	std::vector<const char*> cuts;
+	cuts.push_back(begin);
+	for (size_t i=1; i<numChunks; i++)
+	{
+		const char* from = begin + i*size/numChunks;
+		// from may be in the middle of a line, start with the next one
+		const char* newline = static_cast<const char*>(
+				memchr(from, '\n', end - from));
+		const char* cut = newline ? findShapeStart(newline + 1, end) : end;
+		if (cut > cuts.back() && cut < end)
+		{
+			cuts.push_back(cut);
+		}
+	}
+	cuts.push_back(end);
+	
+	std::vector<std::vector<Shape*> > parts(cuts.size() - 1);
+	std::vector<Arena> arenas(parts.size());
+	try
+	{
+		pool.parallelFor(parts.size(), [&](unsigned int i)
+		{
+			parseRange(begin, cuts[i], cuts[i+1], name, parts[i], arenas[i]);
+		});
+	}
+	catch (...)
+	{
+		// the chunks that did parse are thrown away too
+		for (std::vector<Shape*> &part : parts)
+		{
+			destroy(part);
+		}
+		throw;
+	}
+	for (Arena &part : arenas)
+	{
+		arena.absorb(part);
+	}
+	
+	size_t total = shapes.size();
+	for (const std::vector<Shape*> &part : parts)
+	{
+		total += part.size();
+	}
+	shapes.reserve(total);
+	for (const std::vector<Shape*> &part : parts)
+	{
+		shapes.insert(shapes.end(), part.begin(), part.end());
+	}
+}
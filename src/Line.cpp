@@ -26,6 +26,10 @@ Line::Line(const Line &s)
 	: Shape(s)
 { }
 
+Line::Line(const Line &s, Arena &arena)
+	: Shape(s, arena)
+{ }
+
 Line::~Line()
 {
 	// does nothing, but must be defined
@@ -45,10 +49,11 @@ void Line::draw(GraphicsContext *gc, ViewContext *vc) const
 	gc->setColor(this->color);
 	
 	// convert to device coordinates
-	matrix devPts = vc->modelToDevice(this->pts);
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
 	
 	// utilize line drawing algorithm in GraphicsContext
-	gc->drawLine(devPts[0][0], devPts[1][0], devPts[0][1], devPts[1][1]);
+	drawEdge(gc, vc, clipPts, devPts, 0, 1);
 }
 
 void Line::out(std::ostream & os) const
@@ -118,6 +123,16 @@ Shape* Line::clone() const
 	return l;
 }
 
+Shape* Line::clone(Arena &arena) const
+{
+	return new (arena.allocate<Line>()) Line(*this, arena);
+}
+
+char Line::getType() const
+{
+	return 'l';
+}
+
 std::ostream& operator<<(std::ostream &os, const Line &l)
 {
 	l.out(os);
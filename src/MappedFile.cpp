@@ -0,0 +1,61 @@
+// @file MappedFile.cpp
+// Implementation of the MappedFile class, POSIX mmap based
+
+#include "MappedFile.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path)
+	: base(NULL), length(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw fileException("could not open " + path);
+	}
+	
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		close(fd);
+		throw fileException("could not stat " + path);
+	}
+	length = info.st_size;
+	
+	// mmap refuses empty mappings; an empty file is just an empty buffer
+	if (length > 0)
+	{
+		void* mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED)
+		{
+			close(fd);
+			throw fileException("could not map " + path);
+		}
+		base = static_cast<char*>(mapping);
+		// parsers read front to back, let the kernel read ahead aggressively
+		madvise(base, length, MADV_SEQUENTIAL);
+	}
+	
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (base)
+	{
+		munmap(base, length);
+	}
+}
+
+const char* MappedFile::data() const
+{
+	return base;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
@@ -0,0 +1,561 @@
+// @file Mesh.cpp
+// Implementation cpp file for the Mesh concrete class and operator<</>> overloads
+
+#include "Mesh.h"
+#include <string>
+#include <algorithm> // for std::copy
+#include <unordered_map>
+#include <cstring> // for memcpy
+#include <stdint.h>
+#include <iomanip> // for std::setprecision
+#include <limits>
+
+Mesh::TransformCache::TransformCache(const matrix &modelPts)
+	: revision(0), modelPts(modelPts), clipPts(modelPts), devPts(modelPts)
+{ }
+
+Mesh::Mesh(int color)
+	: Shape(0, 0, 0, color, 1)
+{ }
+
+Mesh::Mesh(const Mesh &s)
+	: Shape(s), vertX(s.vertX), vertY(s.vertY), vertZ(s.vertZ), 
+	  facetIndices(s.facetIndices)
+{ }
+
+Mesh::Mesh(const Mesh &s, Arena &arena)
+	: Shape(s, arena), vertX(s.vertX), vertY(s.vertY), vertZ(s.vertZ), 
+	  facetIndices(s.facetIndices)
+{ }
+
+Mesh::~Mesh()
+{
+	// does nothing, but must be defined
+}
+
+Mesh& Mesh::operator=(const Mesh& rhs)
+{
+	// Shape data
+	assignShapeData(rhs);
+	cache.reset();
+	
+	this->vertX = rhs.vertX;
+	this->vertY = rhs.vertY;
+	this->vertZ = rhs.vertZ;
+	this->facetIndices = rhs.facetIndices;
+	
+	return *this;
+}
+
+void Mesh::reserve(unsigned int numVertices, unsigned int numFacets)
+{
+	vertX.reserve(numVertices);
+	vertY.reserve(numVertices);
+	vertZ.reserve(numVertices);
+	facetIndices.reserve(3*numFacets);
+}
+
+unsigned int Mesh::addVertex(double x, double y, double z)
+{
+	cache.reset();
+	vertX.push_back(x);
+	vertY.push_back(y);
+	vertZ.push_back(z);
+	return vertX.size() - 1;
+}
+
+void Mesh::addFacet(unsigned int v0, unsigned int v1, unsigned int v2)
+{
+	unsigned int numVertices = getNumVertices();
+	if (v0 >= numVertices || v1 >= numVertices || v2 >= numVertices)
+	{
+		throw shapeException("Mesh facet refers to a vertex that doesn't exist");
+	}
+	facetIndices.push_back(v0);
+	facetIndices.push_back(v1);
+	facetIndices.push_back(v2);
+}
+
+void Mesh::getBounds(double low[3], double high[3]) const
+{
+	const std::vector<float>* coords[3] = {&vertX, &vertY, &vertZ};
+	for (int axis=0; axis<3; axis++)
+	{
+		std::pair<std::vector<float>::const_iterator, 
+				std::vector<float>::const_iterator> range = 
+				std::minmax_element(coords[axis]->begin(), coords[axis]->end());
+		low[axis] = *range.first;
+		high[axis] = *range.second;
+	}
+}
+
+bool Mesh::getModelBounds(double low[3], double high[3]) const
+{
+	if (vertX.empty())
+	{
+		return false;
+	}
+	getBounds(low, high);
+	for (int axis=0; axis<3; axis++)
+	{
+		low[axis] += pts.uncheckedAt(axis, 0);
+		high[axis] += pts.uncheckedAt(axis, 0);
+	}
+	return true;
+}
+
+unsigned int Mesh::getNumVertices() const
+{
+	return vertX.size();
+}
+
+void Mesh::append(const Mesh &other)
+{
+	cache.reset();
+	unsigned int base = getNumVertices();
+	vertX.insert(vertX.end(), other.vertX.begin(), other.vertX.end());
+	vertY.insert(vertY.end(), other.vertY.begin(), other.vertY.end());
+	vertZ.insert(vertZ.end(), other.vertZ.begin(), other.vertZ.end());
+	
+	facetIndices.reserve(facetIndices.size() + other.facetIndices.size());
+	for (unsigned int i=0; i<other.facetIndices.size(); i++)
+	{
+		facetIndices.push_back(other.facetIndices[i] + base);
+	}
+}
+
+void Mesh::append(const std::vector<Mesh> &parts, ThreadPool &pool)
+{
+	cache.reset();
+	// where each part lands in the combined arrays
+	std::vector<unsigned int> vertexBase(parts.size());
+	std::vector<unsigned int> indexBase(parts.size());
+	unsigned int numVertices = vertX.size();
+	unsigned int numIndices = facetIndices.size();
+	for (unsigned int i=0; i<parts.size(); i++)
+	{
+		vertexBase[i] = numVertices;
+		indexBase[i] = numIndices;
+		numVertices += parts[i].vertX.size();
+		numIndices += parts[i].facetIndices.size();
+	}
+	
+	vertX.resize(numVertices);
+	vertY.resize(numVertices);
+	vertZ.resize(numVertices);
+	facetIndices.resize(numIndices);
+	
+	// the destination ranges don't overlap, so no locking is needed
+	pool.parallelFor(parts.size(), [&](unsigned int i)
+	{
+		const Mesh &part = parts[i];
+		std::copy(part.vertX.begin(), part.vertX.end(), vertX.begin() + vertexBase[i]);
+		std::copy(part.vertY.begin(), part.vertY.end(), vertY.begin() + vertexBase[i]);
+		std::copy(part.vertZ.begin(), part.vertZ.end(), vertZ.begin() + vertexBase[i]);
+		
+		unsigned int* dst = facetIndices.data() + indexBase[i];
+		for (unsigned int j=0; j<part.facetIndices.size(); j++)
+		{
+			dst[j] = part.facetIndices[j] + vertexBase[i];
+		}
+	});
+}
+
+namespace
+{
+	// the bit patterns of a vertex's coordinates, which Mesh::weld
+	// compares vertices by
+	struct WeldKey
+	{
+		uint32_t x, y, z;
+		
+		bool operator==(const WeldKey &rhs) const
+		{
+			return x == rhs.x && y == rhs.y && z == rhs.z;
+		}
+	};
+	
+	struct WeldKeyHash
+	{
+		size_t operator()(const WeldKey &key) const
+		{
+			// large odd multipliers spread nearby values apart
+			uint64_t h = key.x * 0x9E3779B97F4A7C15ull;
+			h ^= key.y * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+			h ^= key.z * 0x165667B19E3779F9ull + (h >> 32);
+			return h;
+		}
+	};
+	
+	// @returns the bits of a coordinate, with -0 as 0 since they're the
+	//			same place
+	uint32_t weldBits(float value)
+	{
+		value += 0.0f;
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+}
+
+unsigned int Mesh::weld()
+{
+	unsigned int numVertices = getNumVertices();
+	if (numVertices == 0)
+	{
+		return 0;
+	}
+	cache.reset();
+	
+	// the first of equal vertices stays, the others are mapped onto it
+	std::unordered_map<WeldKey, unsigned int, WeldKeyHash> kept;
+	kept.reserve(numVertices);
+	std::vector<unsigned int> newIndex(numVertices);
+	unsigned int numKept = 0;
+	for (unsigned int i=0; i<numVertices; i++)
+	{
+		WeldKey key = {weldBits(vertX[i]), weldBits(vertY[i]), weldBits(vertZ[i])};
+		std::pair<std::unordered_map<WeldKey, unsigned int, WeldKeyHash>::iterator, 
+				bool> found = kept.insert(std::make_pair(key, numKept));
+		if (found.second)
+		{
+			// vertices only ever move down, so this doesn't overwrite
+			// one that's still to be read
+			vertX[numKept] = vertX[i];
+			vertY[numKept] = vertY[i];
+			vertZ[numKept] = vertZ[i];
+			numKept++;
+		}
+		newIndex[i] = found.first->second;
+	}
+	vertX.resize(numKept);
+	vertY.resize(numKept);
+	vertZ.resize(numKept);
+	
+	// renumber the facets. Only equal corners were merged, so a facet has
+	// corners in common only if it had them in the file.
+	for (unsigned int &index : facetIndices)
+	{
+		index = newIndex[index];
+	}
+	
+	return numVertices - numKept;
+}
+
+unsigned int Mesh::getNumFacets() const
+{
+	return facetIndices.size() / 3;
+}
+
+matrix Mesh::modelPoints() const
+{
+	// Each coordinate array maps onto one row of the matrix, so these are
+	// straight contiguous copies (plus the origin offset).
+	unsigned int numVertices = getNumVertices();
+	matrix modelPts(4, numVertices);
+	const std::vector<float>* coords[3] = {&vertX, &vertY, &vertZ};
+	for (unsigned int r=0; r<3; r++)
+	{
+		const float* src = coords[r]->data();
+		double* dst = modelPts.data() + r*modelPts.stride();
+		double origin = pts.uncheckedAt(r, 0);
+		for (unsigned int i=0; i<numVertices; i++)
+		{
+			dst[i] = src[i] + origin;
+		}
+	}
+	double* w = modelPts.data() + 3*modelPts.stride();
+	for (unsigned int i=0; i<numVertices; i++)
+	{
+		w[i] = 1.0;
+	}
+	return modelPts;
+}
+
+const Mesh::TransformCache& Mesh::transformed(const ViewContext *vc) const
+{
+	if (!cache)
+	{
+		cache.reset(new TransformCache(modelPoints()));
+	}
+	if (cache->revision != vc->getRevision())
+	{
+		// one batched conversion for the whole mesh
+		cache->clipPts = vc->modelToClip(cache->modelPts);
+		cache->devPts = vc->clipToDevice(cache->clipPts);
+		const matrix &clipPts = cache->clipPts;
+		cache->outcodes.resize(clipPts.getCols());
+		for (int p=0; p<clipPts.getCols(); p++)
+		{
+			cache->outcodes[p] = vc->outcode(clipPts.uncheckedAt(0, p), 
+					clipPts.uncheckedAt(1, p), clipPts.uncheckedAt(3, p));
+		}
+		cache->revision = vc->getRevision();
+	}
+	return *cache;
+}
+
+bool Mesh::isFacetVisible(ViewContext *vc, const TransformCache &points, 
+		unsigned int f) const
+{
+	ViewContext::CullStats &stats = vc->getCullStats();
+	const matrix &clipPts = points.clipPts;
+	const std::vector<unsigned int> &outcodes = points.outcodes;
+	unsigned int a = facetIndices[f];
+	unsigned int b = facetIndices[f+1];
+	unsigned int c = facetIndices[f+2];
+	
+	// all corners beyond one side (the near plane included)
+	if ((outcodes[a] & outcodes[b] & outcodes[c] & ViewContext::OUT_SIDES) != 0)
+	{
+		stats.facetsOutside++;
+		return false;
+	}
+	
+	if (vc->isBackfaceCulling())
+	{
+		// Facets are counter-clockwise seen from the front. The device
+		// flips y, so the front of a facet is clockwise there. The
+		// determinant of the corners' clip (x, y, w) is the facet's
+		// signed area on the device times the three w's, so it has the
+		// sign of the area when the facet can be projected, and still
+		// tells which side faces the eye when it can't.
+		double xa = clipPts.uncheckedAt(0, a), ya = clipPts.uncheckedAt(1, a), 
+				wa = clipPts.uncheckedAt(3, a);
+		double xb = clipPts.uncheckedAt(0, b), yb = clipPts.uncheckedAt(1, b), 
+				wb = clipPts.uncheckedAt(3, b);
+		double xc = clipPts.uncheckedAt(0, c), yc = clipPts.uncheckedAt(1, c), 
+				wc = clipPts.uncheckedAt(3, c);
+		double det = xa*(yb*wc - wb*yc) - ya*(xb*wc - wb*xc) + wa*(xb*yc - yb*xc);
+		if (det > 0)
+		{
+			stats.facetsBackfacing++;
+			return false;
+		}
+	}
+	
+	stats.facetsDrawn++;
+	return true;
+}
+
+void Mesh::draw(GraphicsContext *gc, ViewContext *vc) const
+{
+	// nothing to draw, and a 4x0 matrix can't exist
+	if (facetIndices.empty())
+	{
+		return;
+	}
+	
+	// set the color to the shape's
+	gc->setColor(this->color);
+	
+	const TransformCache &points = transformed(vc);
+	const matrix &devPts = points.devPts;
+	const std::vector<unsigned int> &outcodes = points.outcodes;
+	
+	// connect the vertices of every facet
+	for (unsigned int f=0; f<facetIndices.size(); f+=3)
+	{
+		if (!isFacetVisible(vc, points, f))
+		{
+			continue;
+		}
+		unsigned int a = facetIndices[f];
+		unsigned int b = facetIndices[f+1];
+		unsigned int c = facetIndices[f+2];
+		if ((outcodes[a] | outcodes[b] | outcodes[c]) & ViewContext::OUT_NEEDS_CLIP)
+		{
+			drawEdge(gc, vc, points.clipPts, devPts, a, b);
+			drawEdge(gc, vc, points.clipPts, devPts, b, c);
+			drawEdge(gc, vc, points.clipPts, devPts, c, a);
+			continue;
+		}
+		gc->drawLine(devPts.uncheckedAt(0, a), devPts.uncheckedAt(1, a), 
+				devPts.uncheckedAt(0, b), devPts.uncheckedAt(1, b));
+		gc->drawLine(devPts.uncheckedAt(0, b), devPts.uncheckedAt(1, b), 
+				devPts.uncheckedAt(0, c), devPts.uncheckedAt(1, c));
+		gc->drawLine(devPts.uncheckedAt(0, c), devPts.uncheckedAt(1, c), 
+				devPts.uncheckedAt(0, a), devPts.uncheckedAt(1, a));
+	}
+}
+
+void Mesh::fill(GraphicsContext *gc, ViewContext *vc) const
+{
+	if (facetIndices.empty())
+	{
+		return;
+	}
+	
+	const TransformCache &points = transformed(vc);
+	for (unsigned int f=0; f<facetIndices.size(); f+=3)
+	{
+		if (isFacetVisible(vc, points, f))
+		{
+			fillFacet(gc, vc, points.modelPts, points.clipPts, points.devPts, 
+					facetIndices[f], facetIndices[f+1], facetIndices[f+2], color);
+		}
+	}
+}
+
+void Mesh::out(std::ostream & os) const
+{	
+	// output shape specifier
+	os << "m(";
+	
+	// output shape-specific data
+	Shape::out(os);
+	
+	// compute the string for a new Line, spaceLevel accounts for if previous level 
+	// was tabbed
+	std::string LineTab(sizeof("s(color=0xFFFFFF ")-1 + this->spaceLevel, ' ');
+
+	// output vertices, with the digits to read back the same floats
+	std::streamsize precision = os.precision();
+	os << std::setprecision(std::numeric_limits<float>::max_digits10);
+	for (unsigned int i=0; i<getNumVertices(); i++)
+	{
+		os << std::endl << LineTab << "v=[" << vertX[i] << " " << vertY[i] 
+				<< " " << vertZ[i] << "]'";
+	}
+	os.precision(precision);
+	
+	// output facets. Shape::out leaves the stream in hex, indices are decimal
+	for (unsigned int f=0; f<facetIndices.size(); f+=3)
+	{
+		os << std::endl << LineTab << "f=[" << std::dec << facetIndices[f] << " " 
+				<< facetIndices[f+1] << " " << facetIndices[f+2] << "]'";
+	}
+	
+	// End of output report
+	os << ")";
+}
+
+void Mesh::in(std::istream & is)
+{
+	// we're parsing new data
+	cache.reset();
+	vertX.clear();
+	vertY.clear();
+	vertZ.clear();
+	facetIndices.clear();
+	
+	// parse the shape-specific data
+	Shape::in(is);
+	
+	char cskip = '\0';
+	// Parse vertices and facets until the closing parenthesis
+	while (is >> cskip)
+	{
+		if (cskip == ')')
+		{
+			// End of the mesh! Quit!
+			return;
+		}
+		
+		is.ignore(sizeof("=[")-1);
+		if (cskip == 'v')
+		{
+			double x, y, z;
+			is >> x >> y >> z;
+			addVertex(x, y, z);
+		}
+		else if (cskip == 'f')
+		{
+			unsigned int v0, v1, v2;
+			is >> std::dec >> v0 >> v1 >> v2;
+			addFacet(v0, v1, v2);
+		}
+		else
+		{
+			throw shapeException("Invalid shape Format: Expected a vertex or a facet");
+		}
+		
+		// discard the rest of the entry ("]'")
+		is.ignore(sizeof("]'")-1);
+	}
+	
+	throw shapeException("Invalid shape Format: Expected End Parenthesis");
+}
+
+void Mesh::outBinary(SceneFile::Writer &writer) const
+{
+	writer.record(getType(), color, pts, 1, getNumVertices(), getNumFacets());
+	writer.array(vertX.data(), vertX.size()*sizeof(float));
+	writer.array(vertY.data(), vertY.size()*sizeof(float));
+	writer.array(vertZ.data(), vertZ.size()*sizeof(float));
+	writer.array(facetIndices.data(), facetIndices.size()*sizeof(unsigned int));
+}
+
+void Mesh::inBinary(SceneFile::Reader &reader, const SceneFile::Record &record)
+{
+	if (record.numPoints != 1)
+	{
+		throw shapeException("Invalid binary record: wrong number of points");
+	}
+	this->color = record.color;
+	reader.points(pts, 1);
+	
+	// a damaged count could ask for more memory than there is
+	size_t bytes = 3*((size_t)record.numVertices*sizeof(float) + 
+			(size_t)record.numFacets*sizeof(uint32_t));
+	if (bytes > reader.remaining())
+	{
+		throw shapeException("Invalid binary record: arrays run past the end");
+	}
+	vertX.resize(record.numVertices);
+	vertY.resize(record.numVertices);
+	vertZ.resize(record.numVertices);
+	facetIndices.resize(3*(size_t)record.numFacets);
+	reader.array(vertX.data(), vertX.size()*sizeof(float));
+	reader.array(vertY.data(), vertY.size()*sizeof(float));
+	reader.array(vertZ.data(), vertZ.size()*sizeof(float));
+	reader.array(facetIndices.data(), facetIndices.size()*sizeof(unsigned int));
+	cache.reset();
+	
+	// the indices were copied unchecked; one bad index would have
+	// drawing read past the vertices
+	for (unsigned int index : facetIndices)
+	{
+		if (index >= record.numVertices)
+		{
+			vertX.clear();
+			vertY.clear();
+			vertZ.clear();
+			facetIndices.clear();
+			throw shapeException("Invalid binary record: facet index out of range");
+		}
+	}
+}
+
+Shape* Mesh::clone() const
+{
+	Mesh *o = new Mesh(*this);
+	return o;
+}
+
+Shape* Mesh::clone(Arena &arena) const
+{
+	return new (arena.allocate<Mesh>()) Mesh(*this, arena);
+}
+
+bool Mesh::ownsMemory() const
+{
+	return true;
+}
+
+char Mesh::getType() const
+{
+	return 'm';
+}
+
+std::ostream& operator<<(std::ostream &os, const Mesh &o)
+{
+	o.out(os);
+	return os;
+}
+
+std::istream& operator>>(std::istream &is, Mesh &o)
+{
+	o.in(is);
+	return is;
+}
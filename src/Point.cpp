@@ -12,6 +12,10 @@ Point::Point(const Point &s)
 	: Shape(s)
 { }
 
+Point::Point(const Point &s, Arena &arena)
+	: Shape(s, arena)
+{ }
+
 Point::~Point()
 {
 	// does nothing, but must be defined
@@ -30,8 +34,14 @@ void Point::draw(GraphicsContext *gc, ViewContext *vc) const
 {	
 	// Set the color and draw the device converted point
 	gc->setColor(this->color);
-	matrix devPts = vc->modelToDevice(this->pts);
-	gc->setPixel(devPts[0][0], devPts[1][0]);
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
+	// points behind the near plane or far off the device aren't drawn
+	if ((vc->outcode(clipPts.uncheckedAt(0, 0), clipPts.uncheckedAt(1, 0), 
+			clipPts.uncheckedAt(3, 0)) & ViewContext::OUT_NEEDS_CLIP) == 0)
+	{
+		gc->setPixel(devPts.uncheckedAt(0, 0), devPts.uncheckedAt(1, 0));
+	}
 }
 
 void Point::out(std::ostream & os) const
@@ -65,6 +75,16 @@ Shape* Point::clone() const
 	return p;
 }
 
+Shape* Point::clone(Arena &arena) const
+{
+	return new (arena.allocate<Point>()) Point(*this, arena);
+}
+
+char Point::getType() const
+{
+	return 'p';
+}
+
 std::ostream& operator<<(std::ostream &os, const Point &p)
 {
 	p.out(os);
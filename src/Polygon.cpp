@@ -4,6 +4,8 @@
 
 #include "Polygon.h"
 #include <string>
+#include <utility> // for std::move
+#include <algorithm> // for std::min/std::max
 
 Polygon::Polygon(const matrix &pts, int color)
 	: Shape(pts[0][0], pts[1][0], pts[2][0], color, Polygon::INITIAL_CAPACITY), 
@@ -30,6 +32,10 @@ Polygon::Polygon(const Polygon &s)
 	: Shape(s), numColumns(s.numColumns), columnCapacity(s.columnCapacity)
 { }
 
+Polygon::Polygon(const Polygon &s, Arena &arena)
+	: Shape(s, arena), numColumns(s.numColumns), columnCapacity(s.columnCapacity)
+{ }
+
 Polygon::~Polygon()
 {
 	// does nothing, but must be defined
@@ -51,8 +57,8 @@ void Polygon::updateColumnCapacity()
 				newMatrix[r][c] = pts[r][c];
 			}
 		}
-		// Yay! This is our new points matrix!
-		pts = newMatrix;		
+		// Yay! This is our new points matrix! (moved, not copied)
+		pts = std::move(newMatrix);		
 	}
 }
 
@@ -83,19 +89,12 @@ Polygon& Polygon::operator=(const Polygon& rhs)
 
 void Polygon::draw(GraphicsContext *gc, ViewContext *vc) const
 {
-	// polygon needs to at least be a triangle!
-	if (numColumns < 3)
-	{
-		throw shapeException("Less than 3 points: Polygon needs to " \
-				"at least be a triangle");
-
-	}
-	
 	// set the color to the shape's
 	gc->setColor(this->color);
 		
 	// convert to device coordinates
-	matrix devPts = vc->modelToDevice(this->pts);
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
 	
 	
 	// utilize the line drawing algorithm in GraphicsContext
@@ -103,10 +102,44 @@ void Polygon::draw(GraphicsContext *gc, ViewContext *vc) const
 	for (unsigned int c=0; c<numColumns; c++)
 	{
 		int nextC = (c+1) % numColumns;
-		gc->drawLine(devPts[0][c], devPts[1][c], 
-				devPts[0][nextC], devPts[1][nextC]);
+		drawEdge(gc, vc, clipPts, devPts, c, nextC);
+	}
+	
+}
+
+void Polygon::fill(GraphicsContext *gc, ViewContext *vc) const
+{
+	// no area to fill, only edges
+	if (numColumns < 3)
+	{
+		draw(gc, vc);
+		return;
 	}
 	
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
+	for (unsigned int c=1; c+1<numColumns; c++)
+	{
+		fillFacet(gc, vc, this->pts, clipPts, devPts, 0, c, c+1, color);
+	}
+}
+
+bool Polygon::getModelBounds(double low[3], double high[3]) const
+{
+	if (numColumns == 0)
+	{
+		return false;
+	}
+	for (int r=0; r<3; r++)
+	{
+		low[r] = high[r] = pts.uncheckedAt(r, 0);
+		for (unsigned int c=1; c<numColumns; c++)
+		{
+			low[r] = std::min(low[r], pts.uncheckedAt(r, c));
+			high[r] = std::max(high[r], pts.uncheckedAt(r, c));
+		}
+	}
+	return true;
 }
 
 void Polygon::out(std::ostream & os) const
@@ -187,12 +220,54 @@ void Polygon::in(std::istream & is)
 	
 }
 
+unsigned int Polygon::getNumPoints() const
+{
+	return numColumns;
+}
+
+void Polygon::inBinary(SceneFile::Reader &reader, 
+		const SceneFile::Record &record)
+{
+	if (record.numPoints < 1 || record.numVertices != 0 || 
+			record.numFacets != 0)
+	{
+		throw shapeException("Invalid binary record: wrong number of points");
+	}
+	// a damaged count could ask for more memory than there is
+	if ((size_t)record.numPoints*4*sizeof(double) > reader.remaining())
+	{
+		throw shapeException("Invalid binary record: points run past the end");
+	}
+	
+	// Room for the points, and at least the usual capacity. Storage with
+	// room enough is kept: a polygon built in an arena stays there, and
+	// one read into over and over allocates only to grow.
+	if (record.numPoints > columnCapacity)
+	{
+		columnCapacity = std::max<unsigned int>(record.numPoints, INITIAL_CAPACITY);
+		pts = matrix(4, columnCapacity);
+	}
+	numColumns = record.numPoints;
+	this->color = record.color;
+	reader.points(pts, numColumns);
+}
+
 Shape* Polygon::clone() const
 {
 	Polygon *o = new Polygon(*this);
 	return o;
 }
 
+Shape* Polygon::clone(Arena &arena) const
+{
+	return new (arena.allocate<Polygon>()) Polygon(*this, arena);
+}
+
+char Polygon::getType() const
+{
+	return 'g';
+}
+
 std::ostream& operator<<(std::ostream &os, const Polygon &o)
 {
 	o.out(os);
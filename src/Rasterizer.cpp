@@ -0,0 +1,35 @@
+// @file Rasterizer.cpp
+// Implementation of the non-template parts of the Rasterizer class
+
+#include "Rasterizer.h"
+#include <limits>
+
+Rasterizer::Rasterizer()
+	: width(0), height(0), originX(0), originY(0)
+{ }
+
+void Rasterizer::resize(int width, int height, int originX, int originY)
+{
+	this->width = width;
+	this->height = height;
+	this->originX = originX;
+	this->originY = originY;
+	depth.resize(width*height);
+	clearDepth();
+}
+
+int Rasterizer::getWidth() const
+{
+	return width;
+}
+
+int Rasterizer::getHeight() const
+{
+	return height;
+}
+
+void Rasterizer::clearDepth()
+{
+	// larger is nearer, so everything is in front of this
+	std::fill(depth.begin(), depth.end(), -std::numeric_limits<float>::infinity());
+}
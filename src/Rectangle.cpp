@@ -64,6 +64,10 @@ Rectangle::Rectangle(const Rectangle &s)
 	: Shape(s)
 { }
 
+Rectangle::Rectangle(const Rectangle &s, Arena &arena)
+	: Shape(s, arena)
+{ }
+
 Rectangle::~Rectangle()
 {
 	// does nothing, but must be defined
@@ -82,18 +86,27 @@ void Rectangle::draw(GraphicsContext *gc, ViewContext *vc) const
 	gc->setColor(this->color);
 	
 	// convert to device coordinates
-	matrix devPts = vc->modelToDevice(this->pts);
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
 	
 	// utilize the line drawing algorithm in GraphicsContext
 	// connect all four vertices together!
 	for (int c=0; c<4; c++)
 	{
 		int nextC = (c+1) % 4;
-		gc->drawLine(devPts[0][c], devPts[1][c], 
-				devPts[0][nextC], devPts[1][nextC]);
+		drawEdge(gc, vc, clipPts, devPts, c, nextC);
 	}
 }
 
+void Rectangle::fill(GraphicsContext *gc, ViewContext *vc) const
+{
+	// split along the diagonal from the first vertex to the third
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
+	fillFacet(gc, vc, this->pts, clipPts, devPts, 0, 1, 2, color);
+	fillFacet(gc, vc, this->pts, clipPts, devPts, 0, 2, 3, color);
+}
+
 void Rectangle::out(std::ostream & os) const
 {	
 	// output shape specifier
@@ -168,6 +181,16 @@ Shape* Rectangle::clone() const
 	return o;
 }
 
+Shape* Rectangle::clone(Arena &arena) const
+{
+	return new (arena.allocate<Rectangle>()) Rectangle(*this, arena);
+}
+
+char Rectangle::getType() const
+{
+	return 'r';
+}
+
 std::ostream& operator<<(std::ostream &os, const Rectangle &o)
 {
 	o.out(os);
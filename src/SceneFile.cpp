@@ -0,0 +1,431 @@
+// @file SceneFile.cpp
+// Implementation of the binary image format
+
+#include "SceneFile.h"
+#include "MappedFile.h" // for fileException
+#include "ThreadPool.h"
+#include <cstring> // for memcpy/memcmp/memset
+#include <algorithm> // for std::min
+#include <ostream>
+
+const char SceneFile::MAGIC[4] = {'I', 'M', 'G', 'B'};
+const char SceneFile::TYPES[] = "pltcrgm";
+
+// arrays are padded to this many bytes, which keeps doubles aligned
+static const size_t ALIGNMENT = 8;
+
+// compressBlock: matches are at least this long, and no further back than
+// MAX_OFFSET, the most a 16 bit offset holds. Candidates are found by
+// hashing the next MIN_MATCH bytes into a table of 2^HASH_BITS entries.
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+static const int HASH_BITS = 16;
+
+// @returns bytes rounded up to a multiple of ALIGNMENT
+static size_t padded(size_t bytes)
+{
+	return (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// The format is little-endian; other machines would have to swap every
+// number, which defeats reading the file in place
+static bool isLittleEndian()
+{
+	const uint16_t one = 1;
+	return *(const unsigned char*)&one == 1;
+}
+
+SceneFile::Writer::Writer(std::string &payload)
+	: payload(payload)
+{ }
+
+void SceneFile::Writer::record(char type, unsigned int color,
+		const matrix &pts, unsigned int numPoints, unsigned int numVertices,
+		unsigned int numFacets)
+{
+	Record header;
+	memset(&header, 0, sizeof(header));
+	header.type = type;
+	header.color = color;
+	header.numPoints = numPoints;
+	header.numVertices = numVertices;
+	header.numFacets = numFacets;
+	payload.append((const char*)&header, sizeof(header));
+
+	// point by point, where the matrix keeps them row by row
+	std::vector<double> points(4*numPoints);
+	const double* data = pts.data();
+	unsigned int stride = pts.stride();
+	for (unsigned int p=0; p<numPoints; p++)
+	{
+		for (unsigned int r=0; r<4; r++)
+		{
+			points[p*4 + r] = data[r*stride + p];
+		}
+	}
+	array(points.data(), points.size()*sizeof(double));
+}
+
+void SceneFile::Writer::array(const void* data, size_t bytes)
+{
+	payload.append((const char*)data, bytes);
+	payload.append(padded(bytes) - bytes, '\0');
+}
+
+SceneFile::Reader::Reader(const char* begin, const char* end)
+	: position(begin), end(end)
+{
+	memset(&current, 0, sizeof(current));
+}
+
+bool SceneFile::Reader::more() const
+{
+	return position < end;
+}
+
+size_t SceneFile::Reader::remaining() const
+{
+	return end - position;
+}
+
+const SceneFile::Record& SceneFile::Reader::next()
+{
+	if ((size_t)(end - position) < sizeof(Record))
+	{
+		throw fileException("binary image ends within a shape");
+	}
+	memcpy(&current, position, sizeof(Record));
+	position += sizeof(Record);
+	return current;
+}
+
+void SceneFile::Reader::array(void* target, size_t bytes)
+{
+	// empty arrays have no storage to copy into, target may be null
+	if (bytes == 0)
+	{
+		return;
+	}
+	if (padded(bytes) > (size_t)(end - position))
+	{
+		throw fileException("binary image ends within a shape");
+	}
+	memcpy(target, position, bytes);
+	position += padded(bytes);
+}
+
+void SceneFile::Reader::points(matrix &pts, unsigned int numPoints)
+{
+	size_t bytes = 4*(size_t)numPoints*sizeof(double);
+	if (bytes > remaining())
+	{
+		throw fileException("binary image ends within a shape");
+	}
+	// straight from the payload into the rows of pts: the payload holds
+	// a point after another, pts a coordinate after another
+	double* data = pts.data();
+	unsigned int stride = pts.stride();
+	for (unsigned int p=0; p<numPoints; p++)
+	{
+		for (unsigned int r=0; r<4; r++)
+		{
+			memcpy(&data[r*stride + p], position + (p*4 + r)*sizeof(double),
+					sizeof(double));
+		}
+	}
+	position += bytes;
+}
+
+bool SceneFile::isBinary(const char* data, size_t size)
+{
+	return size >= sizeof(MAGIC) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+int SceneFile::typeIndex(char type)
+{
+	for (int i=0; i<NUM_TYPES; i++)
+	{
+		if (TYPES[i] == type)
+		{
+			return i;
+		}
+	}
+	return NUM_TYPES;
+}
+
+void SceneFile::write(std::ostream &os, Header header,
+		const std::string &payload, bool compress)
+{
+	if (!isLittleEndian())
+	{
+		throw fileException("binary images are only written on little-endian machines");
+	}
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.flags = compress ? COMPRESSED : 0;
+	header.payloadSize = payload.size();
+	os.write((const char*)&header, sizeof(header));
+	if (!compress)
+	{
+		os.write(payload.data(), payload.size());
+		return;
+	}
+
+	// the blocks are independent, so they're compressed in parallel
+	uint32_t numBlocks = (payload.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	std::vector<std::string> blocks(numBlocks);
+	ThreadPool::shared().parallelFor(numBlocks, [&](unsigned int b)
+	{
+		size_t begin = b*BLOCK_SIZE;
+		size_t size = std::min(BLOCK_SIZE, payload.size() - begin);
+		compressBlock(payload.data() + begin, size, blocks[b]);
+		if (blocks[b].size() >= size)
+		{
+			blocks[b].assign(payload, begin, size);
+		}
+	});
+
+	uint32_t count[2] = {numBlocks, 0};
+	os.write((const char*)count, sizeof(count));
+	for (uint32_t b=0; b<numBlocks; b++)
+	{
+		BlockInfo info;
+		info.rawSize = std::min(BLOCK_SIZE, payload.size() - b*BLOCK_SIZE);
+		info.storedSize = blocks[b].size();
+		os.write((const char*)&info, sizeof(info));
+	}
+	for (uint32_t b=0; b<numBlocks; b++)
+	{
+		os.write(blocks[b].data(), blocks[b].size());
+	}
+}
+
+const char* SceneFile::read(const char* data, size_t size, Header &header,
+		std::vector<char> &storage)
+{
+	if (!isBinary(data, size) || size < sizeof(Header))
+	{
+		throw fileException("not a binary image");
+	}
+	memcpy(&header, data, sizeof(Header));
+	if (!isLittleEndian() || header.version != VERSION)
+	{
+		throw fileException("unsupported binary image version");
+	}
+	const char* position = data + sizeof(Header);
+	const char* end = data + size;
+	if (!(header.flags & COMPRESSED))
+	{
+		if (header.payloadSize != (uint64_t)(end - position))
+		{
+			throw fileException("binary image is truncated");
+		}
+		return position;
+	}
+
+	uint32_t count[2];
+	if ((size_t)(end - position) < sizeof(count))
+	{
+		throw fileException("binary image is truncated");
+	}
+	memcpy(count, position, sizeof(count));
+	position += sizeof(count);
+	uint32_t numBlocks = count[0];
+	if ((uint64_t)numBlocks*sizeof(BlockInfo) > (uint64_t)(end - position))
+	{
+		throw fileException("binary image is truncated");
+	}
+
+	// where each block's bytes are, in the file and in the payload
+	std::vector<BlockInfo> blocks(numBlocks);
+	memcpy(blocks.data(), position, numBlocks*sizeof(BlockInfo));
+	position += numBlocks*sizeof(BlockInfo);
+	std::vector<size_t> stored(numBlocks), raw(numBlocks);
+	uint64_t storedTotal = 0, rawTotal = 0;
+	for (uint32_t b=0; b<numBlocks; b++)
+	{
+		// no block is written bigger, nor bigger than it was raw
+		if (blocks[b].rawSize > BLOCK_SIZE || 
+				blocks[b].storedSize > blocks[b].rawSize)
+		{
+			throw fileException("damaged block in binary image");
+		}
+		stored[b] = storedTotal;
+		raw[b] = rawTotal;
+		storedTotal += blocks[b].storedSize;
+		rawTotal += blocks[b].rawSize;
+	}
+	if (storedTotal != (uint64_t)(end - position) ||
+			rawTotal != header.payloadSize)
+	{
+		throw fileException("binary image is truncated");
+	}
+
+	storage.resize(rawTotal);
+	ThreadPool::shared().parallelFor(numBlocks, [&](unsigned int b)
+	{
+		const char* block = position + stored[b];
+		if (blocks[b].storedSize == blocks[b].rawSize)
+		{
+			memcpy(storage.data() + raw[b], block, blocks[b].rawSize);
+		}
+		else
+		{
+			decompressBlock(block, blocks[b].storedSize,
+					storage.data() + raw[b], blocks[b].rawSize);
+		}
+	});
+	return storage.data();
+}
+
+// A compressed block is a series of sequences, each
+//   token: literal count (high 4 bits), match length - MIN_MATCH (low 4)
+//   more literal count bytes if the count is 15 or more
+//   the literals
+//   16 bit offset back to the match
+//   more match length bytes if the length field is 15 or more
+// The last sequence ends after its literals.
+// A count continues in bytes of 255 until a byte below it.
+static void appendCount(std::string &out, size_t count)
+{
+	while (count >= 255)
+	{
+		out.push_back((char)255);
+		count -= 255;
+	}
+	out.push_back((char)count);
+}
+
+static void appendSequence(std::string &out, const char* literals,
+		size_t numLiterals, size_t offset, size_t matchLength)
+{
+	size_t matchField = matchLength ? matchLength - MIN_MATCH : 0;
+	unsigned char token = (std::min<size_t>(numLiterals, 15) << 4) |
+			std::min<size_t>(matchField, 15);
+	out.push_back((char)token);
+	if (numLiterals >= 15)
+	{
+		appendCount(out, numLiterals - 15);
+	}
+	out.append(literals, numLiterals);
+	if (matchLength == 0)
+	{
+		return;
+	}
+	out.push_back((char)(offset & 0xFF));
+	out.push_back((char)(offset >> 8));
+	if (matchField >= 15)
+	{
+		appendCount(out, matchField - 15);
+	}
+}
+
+void SceneFile::compressBlock(const char* data, size_t size, std::string &out)
+{
+	// the latest position each hash of MIN_MATCH bytes was seen at
+	std::vector<int32_t> table(1 << HASH_BITS, -1);
+	size_t anchor = 0;
+	size_t position = 0;
+	while (position + MIN_MATCH <= size)
+	{
+		uint32_t sequence;
+		memcpy(&sequence, data + position, MIN_MATCH);
+		uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+		int32_t candidate = table[hash];
+		table[hash] = position;
+
+		uint32_t found;
+		if (candidate < 0 || position - candidate > MAX_OFFSET ||
+				(memcpy(&found, data + candidate, MIN_MATCH), found != sequence))
+		{
+			position++;
+			continue;
+		}
+		size_t length = MIN_MATCH;
+		while (position + length < size &&
+				data[candidate + length] == data[position + length])
+		{
+			length++;
+		}
+		appendSequence(out, data + anchor, position - anchor,
+				position - candidate, length);
+		position += length;
+		anchor = position;
+	}
+	appendSequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+// reads a count continued in bytes of 255
+// @returns false if the input ends first
+static bool readCount(const unsigned char* &in, const unsigned char* end,
+		size_t &count)
+{
+	unsigned char byte;
+	do
+	{
+		if (in == end)
+		{
+			return false;
+		}
+		byte = *in++;
+		count += byte;
+	} while (byte == 255);
+	return true;
+}
+
+void SceneFile::decompressBlock(const char* data, size_t size, char* out,
+		size_t outSize)
+{
+	const unsigned char* in = (const unsigned char*)data;
+	const unsigned char* inEnd = in + size;
+	size_t written = 0;
+	while (in < inEnd)
+	{
+		unsigned char token = *in++;
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !readCount(in, inEnd, numLiterals))
+		{
+			throw fileException("damaged block in binary image");
+		}
+		if (numLiterals > (size_t)(inEnd - in) ||
+				numLiterals > outSize - written)
+		{
+			throw fileException("damaged block in binary image");
+		}
+		memcpy(out + written, in, numLiterals);
+		in += numLiterals;
+		written += numLiterals;
+		if (in == inEnd)
+		{
+			break;
+		}
+
+		if (inEnd - in < 2)
+		{
+			throw fileException("damaged block in binary image");
+		}
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		size_t length = token & 15;
+		if (length == 15 && !readCount(in, inEnd, length))
+		{
+			throw fileException("damaged block in binary image");
+		}
+		length += MIN_MATCH;
+		if (offset == 0 || offset > written || length > outSize - written)
+		{
+			throw fileException("damaged block in binary image");
+		}
+		// byte by byte: a match may overlap what it copies
+		const char* source = out + written - offset;
+		for (size_t i=0; i<length; i++)
+		{
+			out[written + i] = source[i];
+		}
+		written += length;
+	}
+	if (written != outSize)
+	{
+		throw fileException("damaged block in binary image");
+	}
+}
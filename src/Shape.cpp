@@ -4,6 +4,8 @@
 
 #include "Shape.h"
 #include <iomanip>
+#include <cmath>
+#include <algorithm> // for std::min/std::max
 
 
 Shape::Shape(double x, double y, double z, int color, int numPoints) 
@@ -20,6 +22,15 @@ Shape::Shape(const Shape &s)
 	: color(s.color), pts(s.pts), spaceLevel(s.spaceLevel)
 {	}
 
+Shape::Shape(const Shape &s, Arena &arena)
+	: color(s.color), 
+	  pts(s.pts.getRows(), s.pts.getCols(), 
+			arena.allocate<double>(s.pts.getRows()*s.pts.getCols())), 
+	  spaceLevel(s.spaceLevel)
+{
+	pts = s.pts;
+}
+
 Shape::~Shape()
 {
 	// does nothing, but is needed!
@@ -41,6 +52,141 @@ void Shape::setSpaceLevel(unsigned int spaceLevel)
 	this->spaceLevel = spaceLevel;
 }
 
+void Shape::fill(GraphicsContext *gc, ViewContext *vc) const
+{
+	draw(gc, vc);
+}
+
+bool Shape::getModelBounds(double low[3], double high[3]) const
+{
+	for (int r=0; r<3; r++)
+	{
+		low[r] = high[r] = pts.uncheckedAt(r, 0);
+		for (int c=1; c<pts.getCols(); c++)
+		{
+			low[r] = std::min(low[r], pts.uncheckedAt(r, c));
+			high[r] = std::max(high[r], pts.uncheckedAt(r, c));
+		}
+	}
+	return true;
+}
+
+// @returns column c of a 4xn matrix
+static Vec4 column(const matrix &points, unsigned int c)
+{
+	Vec4 point;
+	for (int r=0; r<4; r++)
+	{
+		point[r][0] = points.uncheckedAt(r, c);
+	}
+	return point;
+}
+
+// @returns the clip point divided by its w
+static Vec4 toDevice(const Vec4 &point)
+{
+	return 1/point[3][0] * point;
+}
+
+void Shape::drawEdge(GraphicsContext *gc, const ViewContext *vc,
+		const matrix &clipPts, const matrix &devPts,
+		unsigned int a, unsigned int b)
+{
+	unsigned int codeA = vc->outcode(clipPts.uncheckedAt(0, a), 
+			clipPts.uncheckedAt(1, a), clipPts.uncheckedAt(3, a));
+	unsigned int codeB = vc->outcode(clipPts.uncheckedAt(0, b), 
+			clipPts.uncheckedAt(1, b), clipPts.uncheckedAt(3, b));
+	if (((codeA | codeB) & ViewContext::OUT_NEEDS_CLIP) == 0)
+	{
+		gc->drawLine(devPts.uncheckedAt(0, a), devPts.uncheckedAt(1, a), 
+				devPts.uncheckedAt(0, b), devPts.uncheckedAt(1, b));
+		return;
+	}
+	
+	Vec4 from = column(clipPts, a);
+	Vec4 to = column(clipPts, b);
+	if (vc->clipLine(from, to))
+	{
+		from = toDevice(from);
+		to = toDevice(to);
+		gc->drawLine(from[0][0], from[1][0], to[0][0], to[1][0]);
+	}
+}
+
+void Shape::fillFacet(GraphicsContext *gc, const ViewContext *vc, 
+		const matrix &modelPts, const matrix &clipPts, const matrix &devPts,
+		unsigned int a, unsigned int b, unsigned int c, int color)
+{
+	// normal of the triangle in model coordinates
+	double ux = modelPts.uncheckedAt(0, b) - modelPts.uncheckedAt(0, a);
+	double uy = modelPts.uncheckedAt(1, b) - modelPts.uncheckedAt(1, a);
+	double uz = modelPts.uncheckedAt(2, b) - modelPts.uncheckedAt(2, a);
+	double vx = modelPts.uncheckedAt(0, c) - modelPts.uncheckedAt(0, a);
+	double vy = modelPts.uncheckedAt(1, c) - modelPts.uncheckedAt(1, a);
+	double vz = modelPts.uncheckedAt(2, c) - modelPts.uncheckedAt(2, a);
+	fillFacet(gc, vc, uy*vz - uz*vy, uz*vx - ux*vz, ux*vy - uy*vx, clipPts,
+			devPts, a, b, c, color);
+}
+
+void Shape::fillFacet(GraphicsContext *gc, const ViewContext *vc, 
+		double nx, double ny, double nz, const matrix &clipPts, 
+		const matrix &devPts,
+		unsigned int a, unsigned int b, unsigned int c, int color)
+{
+	// The model view only rotates, translates and scales evenly, so its
+	// 3x3 part takes normals into view coordinates (up to length).
+	// Only the z component is needed: the viewer looks down -z.
+	const Mat4 &mv = vc->getModelView();
+	double viewX = mv[0][0]*nx + mv[0][1]*ny + mv[0][2]*nz;
+	double viewY = mv[1][0]*nx + mv[1][1]*ny + mv[1][2]*nz;
+	double viewZ = mv[2][0]*nx + mv[2][1]*ny + mv[2][2]*nz;
+	double length = std::sqrt(viewX*viewX + viewY*viewY + viewZ*viewZ);
+	if (length == 0)
+	{
+		// no area, nothing to fill
+		return;
+	}
+	
+	// lit from the viewer, on both sides
+	double brightness = AMBIENT + (1 - AMBIENT) * std::fabs(viewZ) / length;
+	unsigned int red = ((color >> 16) & 0xFF) * brightness;
+	unsigned int green = ((color >> 8) & 0xFF) * brightness;
+	unsigned int blue = (color & 0xFF) * brightness;
+	gc->setColor((red << 16) | (green << 8) | blue);
+	
+	unsigned int codeA = vc->outcode(clipPts.uncheckedAt(0, a), 
+			clipPts.uncheckedAt(1, a), clipPts.uncheckedAt(3, a));
+	unsigned int codeB = vc->outcode(clipPts.uncheckedAt(0, b), 
+			clipPts.uncheckedAt(1, b), clipPts.uncheckedAt(3, b));
+	unsigned int codeC = vc->outcode(clipPts.uncheckedAt(0, c), 
+			clipPts.uncheckedAt(1, c), clipPts.uncheckedAt(3, c));
+	if (((codeA | codeB | codeC) & ViewContext::OUT_NEEDS_CLIP) == 0)
+	{
+		gc->fillTriangle(
+				devPts.uncheckedAt(0, a), devPts.uncheckedAt(1, a), devPts.uncheckedAt(2, a),
+				devPts.uncheckedAt(0, b), devPts.uncheckedAt(1, b), devPts.uncheckedAt(2, b),
+				devPts.uncheckedAt(0, c), devPts.uncheckedAt(1, c), devPts.uncheckedAt(2, c));
+		return;
+	}
+	
+	// what's left after clipping is convex: fill it as a fan
+	Vec4 corners[3 + ViewContext::CLIP_PLANES];
+	corners[0] = column(clipPts, a);
+	corners[1] = column(clipPts, b);
+	corners[2] = column(clipPts, c);
+	unsigned int numCorners = vc->clipTriangle(corners);
+	for (unsigned int i=0; i<numCorners; i++)
+	{
+		corners[i] = toDevice(corners[i]);
+	}
+	for (unsigned int i=1; i+1<numCorners; i++)
+	{
+		const Vec4 &p = corners[0], &q = corners[i], &r = corners[i+1];
+		gc->fillTriangle(p[0][0], p[1][0], p[2][0], q[0][0], q[1][0], q[2][0],
+				r[0][0], r[1][0], r[2][0]);
+	}
+}
+
 
 void Shape::out(std::ostream & os) const
 {
@@ -93,6 +239,32 @@ void Shape::in(std::istream & is)
 	is.ignore(sizeof("]'")-1);
 }
 
+unsigned int Shape::getNumPoints() const
+{
+	return pts.getCols();
+}
+
+bool Shape::ownsMemory() const
+{
+	return pts.ownsStorage();
+}
+
+void Shape::outBinary(SceneFile::Writer &writer) const
+{
+	writer.record(getType(), color, pts, getNumPoints());
+}
+
+void Shape::inBinary(SceneFile::Reader &reader, const SceneFile::Record &record)
+{
+	if (record.numPoints != (unsigned int)pts.getCols() || 
+			record.numVertices != 0 || record.numFacets != 0)
+	{
+		throw shapeException("Invalid binary record: wrong number of points");
+	}
+	this->color = record.color;
+	reader.points(pts, record.numPoints);
+}
+
 std::ostream& operator<<(std::ostream &os, const Shape &s)
 {
 	s.out(os);
@@ -0,0 +1,605 @@
+// @file ShapeArrays.cpp
+// Implementation of the per-type shape storage
+
+#include "ShapeArrays.h"
+#include "Point.h"
+#include "Line.h"
+#include "Triangle.h"
+#include "Circle.h"
+#include "Rectangle.h"
+#include "Polygon.h"
+#include <cmath>
+#include <cstring> // for memcpy
+#include <string> // for std::to_string
+
+ShapeArrays::Converted::Converted(unsigned int numPoints)
+	: revision(0), clipPts(4, numPoints), devPts(4, numPoints)
+{ }
+
+size_t ShapeArrays::Batch::size() const
+{
+	return colors.size();
+}
+
+unsigned int ShapeArrays::Batch::firstPoint(size_t i,
+		unsigned int numPoints) const
+{
+	return numPoints ? i*numPoints : first[i];
+}
+
+ShapeArrays::ShapeArrays()
+{
+	batches[SceneFile::typeIndex('g')].first.push_back(0);
+}
+
+ShapeArrays::ShapeArrays(const ShapeArrays &s)
+{
+	batches[SceneFile::typeIndex('g')].first.push_back(0);
+	append(s);
+}
+
+ShapeArrays::~ShapeArrays()
+{
+	clear();
+}
+
+ShapeArrays& ShapeArrays::operator=(const ShapeArrays &rhs)
+{
+	if (this != &rhs)
+	{
+		clear();
+		append(rhs);
+	}
+	return *this;
+}
+
+unsigned int ShapeArrays::pointsPerShape(unsigned int batch)
+{
+	switch (SceneFile::TYPES[batch])
+	{
+		case 'p': return 1;
+		case 'l': case 'c': return 2;
+		case 't': return 3;
+		case 'r': return 4;
+		default: return 0;
+	}
+}
+
+void ShapeArrays::append(const ShapeArrays &from)
+{
+	// the arrays are copied whole, so every index moves up by the size of
+	// the batch it's in
+	unsigned int offsets[NUM_BATCHES + 1];
+	for (int b=0; b<NUM_BATCHES; b++)
+	{
+		Batch &to = batches[b];
+		const Batch &batch = from.batches[b];
+		offsets[b] = to.size();
+		unsigned int numPoints = to.x.size();
+		to.colors.insert(to.colors.end(), batch.colors.begin(), batch.colors.end());
+		to.x.insert(to.x.end(), batch.x.begin(), batch.x.end());
+		to.y.insert(to.y.end(), batch.y.begin(), batch.y.end());
+		to.z.insert(to.z.end(), batch.z.begin(), batch.z.end());
+		to.w.insert(to.w.end(), batch.w.begin(), batch.w.end());
+		for (size_t i=1; i<batch.first.size(); i++)
+		{
+			to.first.push_back(numPoints + batch.first[i]);
+		}
+		to.converted.reset();
+	}
+	offsets[NUM_BATCHES] = meshes.size();
+	for (size_t i=0; i<from.meshes.size(); i++)
+	{
+		meshes.push_back(from.meshes[i]->clone());
+	}
+	for (size_t i=0; i<from.order.size(); i++)
+	{
+		Entry entry = from.order[i];
+		entry.index += offsets[entry.batch];
+		order.push_back(entry);
+	}
+}
+
+void ShapeArrays::add(const Shape &s)
+{
+	Entry entry;
+	entry.batch = batchOf(s);
+	entry.index = entry.batch == NUM_BATCHES ? meshes.size() :
+			batches[entry.batch].size();
+	insert(entry, s);
+	order.push_back(entry);
+}
+
+void ShapeArrays::add(std::unique_ptr<Shape> s)
+{
+	if (SceneFile::typeIndex(s->getType()) < NUM_BATCHES)
+	{
+		add(*s);
+		return;
+	}
+	Entry entry = {NUM_BATCHES, (unsigned int)meshes.size()};
+	order.push_back(entry);
+	try
+	{
+		meshes.push_back(s.get());
+	}
+	catch (...)
+	{
+		order.pop_back();
+		throw;
+	}
+	s.release();
+}
+
+void ShapeArrays::reserve(size_t n)
+{
+	order.reserve(n);
+}
+
+void ShapeArrays::reserve(char type, size_t count, size_t numPoints)
+{
+	unsigned int b = SceneFile::typeIndex(type);
+	if (b >= (unsigned int)NUM_BATCHES)
+	{
+		meshes.reserve(meshes.size() + count);
+		return;
+	}
+	Batch &batch = batches[b];
+	if (pointsPerShape(b) != 0)
+	{
+		numPoints = count*pointsPerShape(b);
+	}
+	else
+	{
+		batch.first.reserve(batch.first.size() + count);
+	}
+	batch.colors.reserve(batch.size() + count);
+	numPoints += batch.x.size();
+	batch.x.reserve(numPoints);
+	batch.y.reserve(numPoints);
+	batch.z.reserve(numPoints);
+	batch.w.reserve(numPoints);
+}
+
+size_t ShapeArrays::size() const
+{
+	return order.size();
+}
+
+Shape* ShapeArrays::get(size_t i) const
+{
+	if (i >= order.size())
+	{
+		throw shapeException("No shape " + std::to_string(i) + " to get");
+	}
+	const Entry &entry = order[i];
+	if (entry.batch == NUM_BATCHES)
+	{
+		return meshes[entry.index]->clone();
+	}
+
+	// The constructors copy x, y and z out of a matrix. All but the
+	// polygon's get a blank one, and the points are written straight into
+	// the shape afterwards, w included.
+	static const matrix blank(4, 4);
+	const Batch &batch = batches[entry.batch];
+	unsigned int numPoints = pointsPerShape(entry.batch);
+	unsigned int first = batch.firstPoint(entry.index, numPoints);
+	int color = batch.colors[entry.index];
+	Shape* shape = NULL;
+	switch (SceneFile::TYPES[entry.batch])
+	{
+		case 'p': shape = new Point(0, 0, 0, color); break;
+		case 'l': shape = new Line(blank, color); break;
+		case 't': shape = new Triangle(blank, color); break;
+		case 'c': shape = new Circle(blank, color); break;
+		case 'r': shape = new Rectangle(blank, color); break;
+		default:
+			numPoints = batch.first[entry.index + 1] - first;
+			shape = new Polygon(numPoints, matrix(4, numPoints), color);
+			break;
+	}
+	double* data = shape->pts.data();
+	unsigned int stride = shape->pts.stride();
+	std::memcpy(data, &batch.x[first], numPoints*sizeof(double));
+	std::memcpy(data + stride, &batch.y[first], numPoints*sizeof(double));
+	std::memcpy(data + 2*stride, &batch.z[first], numPoints*sizeof(double));
+	std::memcpy(data + 3*stride, &batch.w[first], numPoints*sizeof(double));
+	return shape;
+}
+
+void ShapeArrays::set(size_t i, const Shape &s)
+{
+	if (i >= order.size())
+	{
+		throw shapeException("No shape " + std::to_string(i) + " to set");
+	}
+	Entry &entry = order[i];
+	unsigned int batch = batchOf(s);
+	if (batch == entry.batch)
+	{
+		replace(entry, s);
+		return;
+	}
+
+	// A batch holds its shapes in the order added, so the shape goes
+	// after the shapes of its new type before it, and before those after
+	Entry to = {batch, 0};
+	for (size_t j=0; j<i; j++)
+	{
+		if (order[j].batch == batch)
+		{
+			to.index++;
+		}
+	}
+	insert(to, s);
+	remove(entry);
+	for (size_t j=i+1; j<order.size(); j++)
+	{
+		if (order[j].batch == entry.batch)
+		{
+			order[j].index--;
+		}
+		else if (order[j].batch == batch)
+		{
+			order[j].index++;
+		}
+	}
+	entry = to;
+}
+
+void ShapeArrays::clear()
+{
+	for (int b=0; b<NUM_BATCHES; b++)
+	{
+		Batch &batch = batches[b];
+		batch.colors.clear();
+		batch.x.clear();
+		batch.y.clear();
+		batch.z.clear();
+		batch.w.clear();
+		batch.first.resize(batch.first.empty() ? 0 : 1);
+		batch.converted.reset();
+	}
+	for (size_t i=0; i<meshes.size(); i++)
+	{
+		delete meshes[i];
+	}
+	meshes.clear();
+	order.clear();
+}
+
+unsigned int ShapeArrays::batchOf(const Shape &s)
+{
+	unsigned int batch = SceneFile::typeIndex(s.getType());
+	return batch < (unsigned int)NUM_BATCHES ? batch : NUM_BATCHES;
+}
+
+void ShapeArrays::insert(const Entry &entry, const Shape &s)
+{
+	if (entry.batch == NUM_BATCHES)
+	{
+		Shape* copy = s.clone();
+		try
+		{
+			meshes.insert(meshes.begin() + entry.index, copy);
+		}
+		catch (...)
+		{
+			delete copy;
+			throw;
+		}
+		return;
+	}
+
+	Batch &to = batches[entry.batch];
+	unsigned int numPoints = s.getNumPoints();
+	unsigned int first = to.firstPoint(entry.index, pointsPerShape(entry.batch));
+	const double* data = s.pts.data();
+	unsigned int stride = s.pts.stride();
+	to.colors.insert(to.colors.begin() + entry.index, s.color);
+	to.x.insert(to.x.begin() + first, data, data + numPoints);
+	to.y.insert(to.y.begin() + first, data + stride, data + stride + numPoints);
+	to.z.insert(to.z.begin() + first, data + 2*stride, data + 2*stride + numPoints);
+	to.w.insert(to.w.begin() + first, data + 3*stride, data + 3*stride + numPoints);
+	if (pointsPerShape(entry.batch) == 0)
+	{
+		// the polygons after it start numPoints later
+		for (size_t i=entry.index+1; i<to.first.size(); i++)
+		{
+			to.first[i] += numPoints;
+		}
+		to.first.insert(to.first.begin() + entry.index + 1, first + numPoints);
+	}
+	to.converted.reset();
+}
+
+void ShapeArrays::replace(const Entry &entry, const Shape &s)
+{
+	if (entry.batch == NUM_BATCHES)
+	{
+		Shape* copy = s.clone();
+		delete meshes[entry.index];
+		meshes[entry.index] = copy;
+		return;
+	}
+
+	Batch &to = batches[entry.batch];
+	unsigned int numPoints = s.getNumPoints();
+	unsigned int first = to.firstPoint(entry.index, pointsPerShape(entry.batch));
+	if (pointsPerShape(entry.batch) == 0)
+	{
+		// a polygon of another size: make it room, or take away what it
+		// no longer needs
+		unsigned int oldPoints = to.first[entry.index + 1] - first;
+		if (numPoints > oldPoints)
+		{
+			unsigned int at = first + oldPoints, more = numPoints - oldPoints;
+			to.x.insert(to.x.begin() + at, more, 0.0);
+			to.y.insert(to.y.begin() + at, more, 0.0);
+			to.z.insert(to.z.begin() + at, more, 0.0);
+			to.w.insert(to.w.begin() + at, more, 0.0);
+		}
+		else if (numPoints < oldPoints)
+		{
+			unsigned int at = first + numPoints, end = first + oldPoints;
+			to.x.erase(to.x.begin() + at, to.x.begin() + end);
+			to.y.erase(to.y.begin() + at, to.y.begin() + end);
+			to.z.erase(to.z.begin() + at, to.z.begin() + end);
+			to.w.erase(to.w.begin() + at, to.w.begin() + end);
+		}
+		for (size_t i=entry.index+1; i<to.first.size(); i++)
+		{
+			to.first[i] = to.first[i] + numPoints - oldPoints;
+		}
+	}
+	const double* data = s.pts.data();
+	unsigned int stride = s.pts.stride();
+	to.colors[entry.index] = s.color;
+	std::memcpy(&to.x[first], data, numPoints*sizeof(double));
+	std::memcpy(&to.y[first], data + stride, numPoints*sizeof(double));
+	std::memcpy(&to.z[first], data + 2*stride, numPoints*sizeof(double));
+	std::memcpy(&to.w[first], data + 3*stride, numPoints*sizeof(double));
+	to.converted.reset();
+}
+
+void ShapeArrays::remove(const Entry &entry)
+{
+	if (entry.batch == NUM_BATCHES)
+	{
+		delete meshes[entry.index];
+		meshes.erase(meshes.begin() + entry.index);
+	}
+	else
+	{
+		Batch &from = batches[entry.batch];
+		unsigned int numPoints = pointsPerShape(entry.batch);
+		unsigned int first = from.firstPoint(entry.index, numPoints);
+		unsigned int last = numPoints ? first + numPoints :
+				from.first[entry.index + 1];
+		from.colors.erase(from.colors.begin() + entry.index);
+		from.x.erase(from.x.begin() + first, from.x.begin() + last);
+		from.y.erase(from.y.begin() + first, from.y.begin() + last);
+		from.z.erase(from.z.begin() + first, from.z.begin() + last);
+		from.w.erase(from.w.begin() + first, from.w.begin() + last);
+		if (numPoints == 0)
+		{
+			from.first.erase(from.first.begin() + entry.index);
+			for (size_t i=entry.index; i<from.first.size(); i++)
+			{
+				from.first[i] -= last - first;
+			}
+		}
+		from.converted.reset();
+	}
+}
+
+const ShapeArrays::Converted& ShapeArrays::convert(const Batch &batch,
+		const ViewContext *vc)
+{
+	if (!batch.converted)
+	{
+		batch.converted.reset(new Converted(batch.x.size()));
+	}
+	Converted &points = *batch.converted;
+	if (points.revision != vc->getRevision())
+	{
+		// one batched conversion for every point of the type
+		points.clipPts = vc->modelToClip(batch.x.data(), batch.y.data(),
+				batch.z.data(), batch.w.data(), batch.x.size());
+		points.devPts = vc->clipToDevice(points.clipPts);
+		const matrix &clipPts = points.clipPts;
+		points.outcodes.resize(clipPts.getCols());
+		for (int p=0; p<clipPts.getCols(); p++)
+		{
+			points.outcodes[p] = vc->outcode(clipPts.uncheckedAt(0, p),
+					clipPts.uncheckedAt(1, p), clipPts.uncheckedAt(3, p));
+		}
+		points.revision = vc->getRevision();
+	}
+	return points;
+}
+
+void ShapeArrays::fillFacet(GraphicsContext *gc, const ViewContext *vc,
+		const Batch &batch, const Converted &points,
+		unsigned int a, unsigned int b, unsigned int c, int color)
+{
+	// normal of the triangle in model coordinates
+	double ux = batch.x[b] - batch.x[a];
+	double uy = batch.y[b] - batch.y[a];
+	double uz = batch.z[b] - batch.z[a];
+	double vx = batch.x[c] - batch.x[a];
+	double vy = batch.y[c] - batch.y[a];
+	double vz = batch.z[c] - batch.z[a];
+	Shape::fillFacet(gc, vc, uy*vz - uz*vy, uz*vx - ux*vz, ux*vy - uy*vx,
+			points.clipPts, points.devPts, a, b, c, color);
+}
+
+bool ShapeArrays::isVisible(ViewContext *vc, const Converted &points,
+		unsigned int first, unsigned int count)
+{
+	// all points beyond one side (the near plane included)
+	unsigned int common = ~0u;
+	for (unsigned int p=first; p<first+count; p++)
+	{
+		common &= points.outcodes[p];
+	}
+	ViewContext::CullStats &stats = vc->getCullStats();
+	if ((common & ViewContext::OUT_SIDES) != 0)
+	{
+		stats.shapesCulled++;
+		return false;
+	}
+	stats.shapesDrawn++;
+	return true;
+}
+
+void ShapeArrays::drawPoints(GraphicsContext *gc, ViewContext *vc,
+		const Batch &batch, const Converted &points)
+{
+	const matrix &devPts = points.devPts;
+	for (size_t i=0; i<batch.size(); i++)
+	{
+		if (!isVisible(vc, points, i, 1))
+		{
+			continue;
+		}
+		// points far off the device aren't drawn
+		if ((points.outcodes[i] & ViewContext::OUT_NEEDS_CLIP) == 0)
+		{
+			gc->setColor(batch.colors[i]);
+			gc->setPixel(devPts.uncheckedAt(0, i), devPts.uncheckedAt(1, i));
+		}
+	}
+}
+
+void ShapeArrays::drawCircles(GraphicsContext *gc, ViewContext *vc,
+		const Batch &batch, const Converted &points)
+{
+	const matrix &devPts = points.devPts;
+	ViewContext::CullStats &stats = vc->getCullStats();
+	for (size_t i=0; i<batch.size(); i++)
+	{
+		// like Circle, never culled, but drawn whole or not at all
+		stats.shapesDrawn++;
+		unsigned int center = 2*i, edge = 2*i + 1;
+		if ((points.outcodes[center] | points.outcodes[edge]) &
+				ViewContext::OUT_NEEDS_CLIP)
+		{
+			continue;
+		}
+		double dx = devPts.uncheckedAt(0, center) - devPts.uncheckedAt(0, edge);
+		double dy = devPts.uncheckedAt(1, center) - devPts.uncheckedAt(1, edge);
+		double r;
+		if (dx == 0) r = std::abs(dy);
+		else if (dy == 0) r = std::abs(dx);
+		else r = std::sqrt(dx*dx + dy*dy);
+		gc->setColor(batch.colors[i]);
+		gc->drawCircle(devPts.uncheckedAt(0, center),
+				devPts.uncheckedAt(1, center), r);
+	}
+}
+
+void ShapeArrays::drawOutlines(GraphicsContext *gc, ViewContext *vc,
+		const Batch &batch, const Converted &points, unsigned int numPoints,
+		bool filled)
+{
+	// a line is one edge, not one there and one back
+	unsigned int numEdges = numPoints == 2 ? 1 : numPoints;
+	for (size_t i=0; i<batch.size(); i++)
+	{
+		unsigned int first = i*numPoints;
+		if (!isVisible(vc, points, first, numPoints))
+		{
+			continue;
+		}
+		if (filled && numPoints >= 3)
+		{
+			// a fan: one triangle, or a rectangle split along its diagonal
+			for (unsigned int c=1; c+1<numPoints; c++)
+			{
+				fillFacet(gc, vc, batch, points, first, first + c,
+						first + c + 1, batch.colors[i]);
+			}
+			continue;
+		}
+		gc->setColor(batch.colors[i]);
+		for (unsigned int c=0; c<numEdges; c++)
+		{
+			Shape::drawEdge(gc, vc, points.clipPts, points.devPts, first + c,
+					first + (c+1) % numPoints);
+		}
+	}
+}
+
+void ShapeArrays::drawPolygons(GraphicsContext *gc, ViewContext *vc,
+		const Batch &batch, const Converted &points, bool filled)
+{
+	for (size_t i=0; i<batch.size(); i++)
+	{
+		unsigned int first = batch.first[i];
+		unsigned int numPoints = batch.first[i+1] - first;
+		if (!isVisible(vc, points, first, numPoints))
+		{
+			continue;
+		}
+		// fewer than 3 points have no area, and are drawn like lines
+		if (filled && numPoints >= 3)
+		{
+			for (unsigned int c=1; c+1<numPoints; c++)
+			{
+				fillFacet(gc, vc, batch, points, first, first + c,
+						first + c + 1, batch.colors[i]);
+			}
+			continue;
+		}
+		gc->setColor(batch.colors[i]);
+		for (unsigned int c=0; c<numPoints; c++)
+		{
+			Shape::drawEdge(gc, vc, points.clipPts, points.devPts, first + c,
+					first + (c+1) % numPoints);
+		}
+	}
+}
+
+void ShapeArrays::draw(GraphicsContext *gc, ViewContext *vc, bool filled) const
+{
+	for (int b=0; b<NUM_BATCHES; b++)
+	{
+		const Batch &batch = batches[b];
+		if (batch.size() == 0)
+		{
+			continue;
+		}
+		const Converted &points = convert(batch, vc);
+		switch (SceneFile::TYPES[b])
+		{
+			case 'p': drawPoints(gc, vc, batch, points); break;
+			case 'c': drawCircles(gc, vc, batch, points); break;
+			case 'g': drawPolygons(gc, vc, batch, points, filled); break;
+			default:
+				drawOutlines(gc, vc, batch, points, pointsPerShape(b), filled);
+				break;
+		}
+	}
+
+	ViewContext::CullStats &stats = vc->getCullStats();
+	for (size_t i=0; i<meshes.size(); i++)
+	{
+		double low[3], high[3];
+		if (meshes[i]->getModelBounds(low, high) && !vc->isBoxVisible(low, high))
+		{
+			stats.shapesCulled++;
+			continue;
+		}
+		stats.shapesDrawn++;
+		if (filled)
+		{
+			meshes[i]->fill(gc, vc);
+		}
+		else
+		{
+			meshes[i]->draw(gc, vc);
+		}
+	}
+}
@@ -0,0 +1,273 @@
+// @file StlParser.cpp
+// Implementation of the STL parsers
+
+#include "StlParser.h"
+#include <cstring>	// for memcpy/memchr/memcmp
+#include <charconv>	// for std::from_chars
+#include <stdint.h>
+
+// STL is little-endian regardless of the machine reading it, so multi-byte
+// fields are assembled byte by byte rather than cast in place
+static uint32_t readUint32(const char* p)
+{
+	const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) |
+			((uint32_t)b[3] << 24);
+}
+
+static float readFloat(const char* p)
+{
+	uint32_t bits = readUint32(p);
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+bool StlParser::isBinary(const char* data, size_t size)
+{
+	if (size >= BINARY_HEADER_SIZE)
+	{
+		uint32_t numFacets = readUint32(data + 80);
+		if (BINARY_HEADER_SIZE + (uint64_t)numFacets*BINARY_FACET_SIZE == size)
+		{
+			return true;
+		}
+	}
+	
+	// Otherwise it's ASCII if it looks like text: ASCII STL starts with
+	// "solid" (or, from sloppier writers, straight away with "facet"), 
+	// while binary headers and records are full of control bytes
+	size_t probe = (size < 512) ? size : 512;
+	for (size_t i=0; i<probe; i++)
+	{
+		unsigned char c = data[i];
+		if (c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\v' && 
+				c != '\f')
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+void StlParser::parseBinary(const char* data, size_t size, Mesh &mesh)
+{
+	if (size < BINARY_HEADER_SIZE)
+	{
+		throw imageException("binary STL is too short to hold its header");
+	}
+	
+	uint32_t numFacets = readUint32(data + 80);
+	if (BINARY_HEADER_SIZE + (uint64_t)numFacets*BINARY_FACET_SIZE > size)
+	{
+		throw imageException("binary STL is shorter than its facet count");
+	}
+	
+	// the counts are known, the vertex arrays never regrow
+	mesh.reserve(mesh.getNumVertices() + 3*numFacets, 
+			mesh.getNumFacets() + numFacets);
+	
+	const char* record = data + BINARY_HEADER_SIZE;
+	for (uint32_t f=0; f<numFacets; f++, record += BINARY_FACET_SIZE)
+	{
+		// skip the 12 byte normal, then three vertices of 3 floats each
+		const char* v = record + 12;
+		unsigned int first = mesh.addVertex(readFloat(v), readFloat(v+4), 
+				readFloat(v+8));
+		mesh.addVertex(readFloat(v+12), readFloat(v+16), readFloat(v+20));
+		mesh.addVertex(readFloat(v+24), readFloat(v+28), readFloat(v+32));
+		mesh.addFacet(first, first+1, first+2);
+	}
+}
+
+// whitespace as far as iostream's >> is concerned
+static inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || 
+			c == '\f';
+}
+
+void StlParser::skipSpace(Cursor &cur)
+{
+	while (cur.pos < cur.end && isSpace(*cur.pos))
+	{
+		cur.pos++;
+	}
+}
+
+void StlParser::skipLine(Cursor &cur)
+{
+	const char* newline = static_cast<const char*>(
+			memchr(cur.pos, '\n', cur.end - cur.pos));
+	cur.pos = newline ? newline + 1 : cur.end;
+}
+
+bool StlParser::matchWord(Cursor &cur, const char* keyword, size_t length)
+{
+	skipSpace(cur);
+	const char* word = cur.pos;
+	while (cur.pos < cur.end && !isSpace(*cur.pos))
+	{
+		cur.pos++;
+	}
+	return (size_t)(cur.pos - word) == length && memcmp(word, keyword, length) == 0;
+}
+
+bool StlParser::matchFacetStart(Cursor &cur)
+{
+	// only spaces and tabs may come before the words, they can't span lines
+	for (int w=0; w<2; w++)
+	{
+		while (cur.pos < cur.end && (*cur.pos == ' ' || *cur.pos == '\t'))
+		{
+			cur.pos++;
+		}
+		if (cur.pos < cur.end && (*cur.pos == '\n' || *cur.pos == '\r'))
+		{
+			return false;
+		}
+		if (!matchWord(cur, w == 0 ? "facet" : "normal", w == 0 ? 5 : 6))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool StlParser::parseNumber(Cursor &cur, double &value)
+{
+	skipSpace(cur);
+	// from_chars doesn't take an explicit plus sign, >> does
+	if (cur.pos < cur.end && *cur.pos == '+')
+	{
+		cur.pos++;
+	}
+	std::from_chars_result result = std::from_chars(cur.pos, cur.end, value);
+	if (result.ec != std::errc() || (result.ptr < cur.end && !isSpace(*result.ptr)))
+	{
+		return false;
+	}
+	cur.pos = result.ptr;
+	return true;
+}
+
+void StlParser::parseAscii(const char* begin, const char* end, Mesh &mesh)
+{
+	Cursor cur = {begin, end};
+	
+	while (cur.pos < cur.end)
+	{
+		// Ensure we're at the start of a valid facet before parsing data
+		// once confirmed to be a facet, we throw exceptions if parsing fails
+		const char* lineStart = cur.pos;
+		bool facet = matchFacetStart(cur);
+		// the rest of the line (the normal) is not needed
+		cur.pos = lineStart;
+		skipLine(cur);
+		if (!facet)
+		{
+			continue;
+		}
+		
+		// confirm "outer loop"
+		if (!matchWord(cur, "outer", 5) || !matchWord(cur, "loop", 4))
+		{
+			throw imageException("Encountered facet with no outer loop");
+		}
+		
+		// parse "vertex <double> <double> <double>" 3 times
+		double v[3][3];
+		for (int i=0; i<3; i++)
+		{
+			if (!matchWord(cur, "vertex", 6) || !parseNumber(cur, v[i][0]) ||
+					!parseNumber(cur, v[i][1]) || !parseNumber(cur, v[i][2]))
+			{
+				throw imageException("failed while parsing facet vertices");
+			}
+		}
+		
+		// confirm "endloop"
+		if (!matchWord(cur, "endloop", 7))
+		{
+			throw imageException("Encountered facet with no endloop");
+		}
+		// confirm "endfacet"
+		if (!matchWord(cur, "endfacet", 8))
+		{
+			throw imageException("Encountered faced with no endfacet");
+		}
+		
+		// anything else on the endfacet line is ignored
+		skipLine(cur);
+		
+		// we have the vertices, add the triangle
+		unsigned int first = mesh.addVertex(v[0][0], v[0][1], v[0][2]);
+		mesh.addVertex(v[1][0], v[1][1], v[1][2]);
+		mesh.addVertex(v[2][0], v[2][1], v[2][2]);
+		mesh.addFacet(first, first+1, first+2);
+	}
+}
+
+const char* StlParser::findFacetStart(const char* from, const char* end)
+{
+	Cursor cur = {from, end};
+	// from may be in the middle of a line, start with the next one
+	if (cur.pos < cur.end && cur.pos[-1] != '\n')
+	{
+		skipLine(cur);
+	}
+	
+	while (cur.pos < cur.end)
+	{
+		const char* lineStart = cur.pos;
+		if (matchFacetStart(cur))
+		{
+			return lineStart;
+		}
+		cur.pos = lineStart;
+		skipLine(cur);
+	}
+	return end;
+}
+
+void StlParser::parseAsciiParallel(const char* begin, const char* end, 
+		Mesh &mesh, ThreadPool &pool)
+{
+	size_t size = end - begin;
+	size_t numChunks = pool.getNumThreads() * CHUNKS_PER_THREAD;
+	if (numChunks > size / MIN_CHUNK_SIZE)
+	{
+		numChunks = size / MIN_CHUNK_SIZE;
+	}
+	if (numChunks < 2)
+	{
+		parseAscii(begin, end, mesh);
+		return;
+	}
+	
+	// Cut at evenly spaced points, each moved forward to the next facet.
+	// A facet line can't occur inside a well formed facet, so the serial
+	// parser would be between facets at each cut as well. If a facet is
+	// malformed, its chunk fails on the same token the serial parse would
+	// (the next facet line or the chunk end both fail to match).
+	std::vector<const char*> cuts;
+	cuts.push_back(begin);
+	for (size_t i=1; i<numChunks; i++)
+	{
+		const char* cut = findFacetStart(begin + i*size/numChunks, end);
+		if (cut > cuts.back() && cut < end)
+		{
+			cuts.push_back(cut);
+		}
+	}
+	cuts.push_back(end);
+	
+	std::vector<Mesh> parts(cuts.size() - 1);
+	pool.parallelFor(parts.size(), [&](unsigned int i)
+	{
+		parseAscii(cuts[i], cuts[i+1], parts[i]);
+	});
+	
+	mesh.append(parts, pool);
+}
@@ -0,0 +1,174 @@
+// @file ThreadPool.cpp
+// Implementation of the ThreadPool class
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+	: task(NULL), generation(0), activeWorkers(0), stopping(false), 
+	  errorIndex(0)
+{
+	if (numThreads == 0)
+	{
+		numThreads = std::thread::hardware_concurrency();
+	}
+	if (numThreads == 0)
+	{
+		// the count isn't known, go without helpers
+		numThreads = 1;
+	}
+	for (unsigned int i=0; i<numThreads; i++)
+	{
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue));
+	}
+	// the caller of parallelFor is always one of the threads
+	for (unsigned int i=1; i<numThreads; i++)
+	{
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	jobReady.notify_all();
+	for (unsigned int i=0; i<workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+unsigned int ThreadPool::getNumThreads() const
+{
+	return workers.size() + 1;
+}
+
+void ThreadPool::parallelFor(unsigned int count, 
+		const std::function<void(unsigned int)> &task)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	
+	// deal out contiguous shares, one per thread
+	unsigned int numThreads = queues.size();
+	for (unsigned int t=0; t<numThreads; t++)
+	{
+		unsigned int begin = (unsigned long long)count*t / numThreads;
+		unsigned int end = (unsigned long long)count*(t+1) / numThreads;
+		std::lock_guard<std::mutex> guard(queues[t]->lock);
+		for (unsigned int i=begin; i<end; i++)
+		{
+			queues[t]->tasks.push_back(i);
+		}
+	}
+	
+	// post the job and wake everybody up
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		this->task = &task;
+		error = NULL;
+		activeWorkers = workers.size();
+		generation++;
+	}
+	jobReady.notify_all();
+	
+	// help out, then wait for the stragglers
+	runTasks(0);
+	std::unique_lock<std::mutex> guard(lock);
+	jobDone.wait(guard, [this]() { return activeWorkers == 0; });
+	this->task = NULL;
+	
+	if (error)
+	{
+		std::exception_ptr failure = error;
+		error = NULL;
+		std::rethrow_exception(failure);
+	}
+}
+
+bool ThreadPool::nextTask(unsigned int self, unsigned int &task)
+{
+	// own work first, from the front
+	{
+		WorkQueue &own = *queues[self];
+		std::lock_guard<std::mutex> guard(own.lock);
+		if (!own.tasks.empty())
+		{
+			task = own.tasks.front();
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+	
+	// then someone else's, from the back, furthest from what they're on
+	for (unsigned int v=1; v<queues.size(); v++)
+	{
+		WorkQueue &victim = *queues[(self + v) % queues.size()];
+		std::lock_guard<std::mutex> guard(victim.lock);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+	
+	// nothing is added during a job, so nothing will turn up later either
+	return false;
+}
+
+void ThreadPool::runTasks(unsigned int self)
+{
+	unsigned int i;
+	while (nextTask(self, i))
+	{
+		try
+		{
+			(*task)(i);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (!error || i < errorIndex)
+			{
+				error = std::current_exception();
+				errorIndex = i;
+			}
+		}
+	}
+}
+
+void ThreadPool::workerLoop(unsigned int self)
+{
+	unsigned long seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			jobReady.wait(guard, [&]() { return stopping || generation != seen; });
+			if (stopping)
+			{
+				return;
+			}
+			seen = generation;
+		}
+		
+		runTasks(self);
+		
+		std::lock_guard<std::mutex> guard(lock);
+		if (--activeWorkers == 0)
+		{
+			jobDone.notify_all();
+		}
+	}
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
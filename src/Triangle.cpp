@@ -26,6 +26,10 @@ Triangle::Triangle(const Triangle &s)
 	: Shape(s)
 { }
 
+Triangle::Triangle(const Triangle &s, Arena &arena)
+	: Shape(s, arena)
+{ }
+
 Triangle::~Triangle()
 {
 	// does nothing, but must be defined
@@ -45,14 +49,22 @@ void Triangle::draw(GraphicsContext *gc, ViewContext *vc) const
 	gc->setColor(this->color);
 	
 	// Convert to device coordinates
-	matrix devPts = vc->modelToDevice(this->pts);
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
 	
 	// utilize the line drawing algorithm in GraphicsContext
 	// connect all three vertices together
-	gc->drawLine(devPts[0][0], devPts[1][0], devPts[0][1], devPts[1][1]);
-	gc->drawLine(devPts[0][1], devPts[1][1], devPts[0][2], devPts[1][2]);
-	gc->drawLine(devPts[0][2], devPts[1][2], devPts[0][0], devPts[1][0]);
+	drawEdge(gc, vc, clipPts, devPts, 0, 1);
+	drawEdge(gc, vc, clipPts, devPts, 1, 2);
+	drawEdge(gc, vc, clipPts, devPts, 2, 0);
+
+}
 
+void Triangle::fill(GraphicsContext *gc, ViewContext *vc) const
+{
+	matrix clipPts = vc->modelToClip(this->pts);
+	matrix devPts = vc->clipToDevice(clipPts);
+	fillFacet(gc, vc, this->pts, clipPts, devPts, 0, 1, 2, color);
 }
 
 void Triangle::out(std::ostream & os) const
@@ -129,6 +141,16 @@ Shape* Triangle::clone() const
 	return t;
 }
 
+Shape* Triangle::clone(Arena &arena) const
+{
+	return new (arena.allocate<Triangle>()) Triangle(*this, arena);
+}
+
+char Triangle::getType() const
+{
+	return 't';
+}
+
 std::ostream& operator<<(std::ostream &os, const Triangle &t)
 {
 	t.out(os);
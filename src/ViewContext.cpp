@@ -4,21 +4,35 @@
 
 #include "ViewContext.h"
 #include <cmath>
+#include <algorithm> // for std::min/std::max/std::copy
+
+std::atomic<unsigned long> ViewContext::nextRevision(1);
+
+// normalizes the 4th component of every column of points, in place
+static void divideByW(matrix& points)
+{
+	for(int p=0; p<points.getCols(); p++)
+	{
+		double w = 1/points.uncheckedAt(3, p);
+		for(int r=0; r<4; r++)
+		{
+			points.uncheckedAt(r, p) = w * points.uncheckedAt(r, p);
+		}
+	}
+}
 
 ViewContext::ViewContext(double deviceHeight, double deviceWidth)
-	: composite(4,4), compositeInv(4,4), vTm(4,4), pTv(4,4), dTp(4,4),
-	  translation(4,4), translationInv(4,4), rotation(4,4), rotationInv(4,4), 
-	  scale(4,4), scaleInv(4,4), netTranslation(4,4), netTranslationInv(4,4),
-	  netRotation(4,4), netRotationInv(4,4), netScale(4,4), netScaleInv(4,4),
-	  deviceWidth(deviceWidth), deviceHeight(deviceHeight)
+	: deviceWidth(deviceWidth), deviceHeight(deviceHeight),
+	  backfaceCulling(false)
 {
+	resetCullStats();
 	reset();
 }
 		
 matrix ViewContext::modelToDevice(double x, double y, double z) const 
 {
-	// make a 4x1 matrix out of the model point
-	matrix point(4,1);
+	// make a 4x1 vector out of the model point
+	Vec4 point;
 	point[0][0] = x;
 	point[1][0] = y;
 	point[2][0] = z;
@@ -31,28 +45,231 @@ matrix ViewContext::modelToDevice(double x, double y, double z) const
 	point = 1/point[3][0] * point;
 
 	
-	return point;
+	return toMatrix(point);
 }
 	
 matrix ViewContext::modelToDevice(const matrix& points) const
 {
-	matrix devPts = composite * points;
-	// normalize 4th component TODO: has to be done here?
-	for(int p=0; p<devPts.getCols(); p++)
+	matrix devPts = modelToClip(points);
+	divideByW(devPts);
+	return devPts;
+}
+
+matrix ViewContext::modelToClip(const matrix& points) const
+{
+	return composite * points;
+}
+
+matrix ViewContext::modelToClip(const double* x, const double* y,
+		const double* z, const double* w, unsigned int numPoints) const
+{
+	matrix clipPts(4, numPoints);
+	double* out = clipPts.data();
+	unsigned int stride = clipPts.stride();
+	const double* row0 = composite[0];
+	const double* row1 = composite[1];
+	const double* row2 = composite[2];
+	const double* row3 = composite[3];
+	for (unsigned int p=0; p<numPoints; p++)
 	{
-		for(int r=0; r<4; r++)
+		out[p] = row0[0]*x[p] + row0[1]*y[p] + row0[2]*z[p] + row0[3]*w[p];
+		out[stride + p] = row1[0]*x[p] + row1[1]*y[p] + row1[2]*z[p] + row1[3]*w[p];
+		out[2*stride + p] = row2[0]*x[p] + row2[1]*y[p] + row2[2]*z[p] + row2[3]*w[p];
+		out[3*stride + p] = row3[0]*x[p] + row3[1]*y[p] + row3[2]*z[p] + row3[3]*w[p];
+	}
+	return clipPts;
+}
+
+matrix ViewContext::clipToDevice(const matrix& clipPts) const
+{
+	matrix devPts = clipPts;
+	divideByW(devPts);
+	return devPts;
+}
+
+unsigned int ViewContext::outcode(double x, double y, double w) const
+{
+	// The sides are planes through the eye in clip coordinates, e.g.
+	// device x = x/w >= 0 is x >= 0 for w > 0. Being linear, they keep
+	// working on points that can't be divided, and on model points that
+	// went through a linear transform: a set of points all outside one
+	// plane is outside as a whole. A pixel of slack covers rounding.
+	unsigned int code = 0;
+	if (x < -w)
+	{
+		code |= OUT_LEFT;
+	}
+	if (x > (deviceWidth + 1)*w)
+	{
+		code |= OUT_RIGHT;
+	}
+	if (y < -w)
+	{
+		code |= OUT_TOP;
+	}
+	if (y > (deviceHeight + 1)*w)
+	{
+		code |= OUT_BOTTOM;
+	}
+	if (w < NEAR_W)
+	{
+		code |= OUT_NEAR;
+	}
+	if (x < -GUARD_BAND*w || x > (deviceWidth + GUARD_BAND)*w ||
+			y < -GUARD_BAND*w || y > (deviceHeight + GUARD_BAND)*w)
+	{
+		code |= OUT_GUARD;
+	}
+	return code;
+}
+
+double ViewContext::clipDistance(unsigned int plane, const Vec4 &p) const
+{
+	double x = p[0][0], y = p[1][0], w = p[3][0];
+	switch (plane)
+	{
+	case 0:
+		return w - NEAR_W;
+	case 1:
+		return x + GUARD_BAND*w;
+	case 2:
+		return (deviceWidth + GUARD_BAND)*w - x;
+	case 3:
+		return y + GUARD_BAND*w;
+	default:
+		return (deviceHeight + GUARD_BAND)*w - y;
+	}
+}
+
+bool ViewContext::clipLine(Vec4 &a, Vec4 &b) const
+{
+	// Liang-Barsky: the points of the line are a + t*(b - a). Each plane
+	// the ends are on opposite sides of narrows the range of t kept.
+	double tEnter = 0, tLeave = 1;
+	for (unsigned int plane=0; plane<CLIP_PLANES; plane++)
+	{
+		double da = clipDistance(plane, a);
+		double db = clipDistance(plane, b);
+		if (da < 0 && db < 0)
+		{
+			return false;
+		}
+		if (da < 0)
 		{
-			devPts[r][p] = 1/devPts[3][p] * devPts[r][p];
+			tEnter = std::max(tEnter, da / (da - db));
 		}
+		else if (db < 0)
+		{
+			tLeave = std::min(tLeave, da / (da - db));
+		}
+	}
+	if (tEnter > tLeave)
+	{
+		return false;
 	}
 	
-	return devPts;
+	Vec4 delta = b - a;
+	if (tLeave < 1)
+	{
+		b = a + tLeave*delta;
+	}
+	if (tEnter > 0)
+	{
+		a = a + tEnter*delta;
+	}
+	return true;
+}
+
+unsigned int ViewContext::clipTriangle(Vec4 points[3 + CLIP_PLANES]) const
+{
+	// Sutherland-Hodgman: clip against one plane at a time, each pass
+	// keeping the corners on the inside and adding one where an edge
+	// crosses the plane. A convex polygon stays convex and gains at most
+	// one corner per plane.
+	Vec4 clipped[3 + CLIP_PLANES];
+	Vec4 *in = points;
+	unsigned int n = 3;
+	for (unsigned int plane=0; plane<CLIP_PLANES && n > 0; plane++)
+	{
+		unsigned int kept = 0;
+		Vec4 *out = (in == points) ? clipped : points;
+		for (unsigned int i=0; i<n; i++)
+		{
+			const Vec4 &from = in[i];
+			const Vec4 &to = in[(i + 1) % n];
+			double dFrom = clipDistance(plane, from);
+			double dTo = clipDistance(plane, to);
+			if (dFrom >= 0)
+			{
+				out[kept++] = from;
+			}
+			if ((dFrom >= 0) != (dTo >= 0))
+			{
+				out[kept++] = from + dFrom / (dFrom - dTo) * (to - from);
+			}
+		}
+		n = kept;
+		in = out;
+	}
+	
+	if (in != points)
+	{
+		std::copy(in, in + n, points);
+	}
+	return n;
+}
+
+bool ViewContext::isBoxVisible(const double low[3], const double high[3]) const
+{
+	// the box is outside if all 8 corners are outside the same side
+	unsigned int common = ~0u;
+	for (int corner=0; corner<8 && common; corner++)
+	{
+		Vec4 point;
+		point[0][0] = (corner & 1) ? high[0] : low[0];
+		point[1][0] = (corner & 2) ? high[1] : low[1];
+		point[2][0] = (corner & 4) ? high[2] : low[2];
+		point[3][0] = 1;
+		point = composite * point;
+		common &= outcode(point[0][0], point[1][0], point[3][0]);
+	}
+	return (common & OUT_SIDES) == 0;
+}
+
+void ViewContext::setBackfaceCulling(bool cull)
+{
+	backfaceCulling = cull;
+}
+
+bool ViewContext::isBackfaceCulling() const
+{
+	return backfaceCulling;
+}
+
+ViewContext::CullStats& ViewContext::getCullStats()
+{
+	return cullStats;
+}
+
+const ViewContext::CullStats& ViewContext::getCullStats() const
+{
+	return cullStats;
+}
+
+void ViewContext::resetCullStats()
+{
+	cullStats = CullStats();
+}
+
+unsigned long ViewContext::getRevision() const
+{
+	return revision;
 }
 	
 matrix ViewContext::deviceToModel(double x, double y, double z) const
 {
-	// make a 4x1 matrix out of the device point
-	matrix point(4,1);
+	// make a 4x1 vector out of the device point
+	Vec4 point;
 	point[0][0] = x;
 	point[1][0] = y;
 	point[2][0] = z;
@@ -61,7 +278,7 @@ matrix ViewContext::deviceToModel(double x, double y, double z) const
 	// transform it into a model point
 	point = compositeInv * point;
 		
-	return point;
+	return toMatrix(point);
 }
 
 matrix ViewContext::deviceToModel(const matrix& points) const
@@ -69,11 +286,16 @@ matrix ViewContext::deviceToModel(const matrix& points) const
 	return compositeInv * points;
 }
 
+const Mat4& ViewContext::getModelView() const
+{
+	return modelView;
+}
+
 void ViewContext::reset()
 {
 	// reset all accumulations
 	netTranslation = netTranslationInv = netRotation = netRotationInv
-			= netScale = netScaleInv = matrix::identity(4);
+			= netScale = netScaleInv = Mat4::identity();
 	// reset rotate(), translate(), and zoom() to have no effect
 	configTranslation(0, 0, 0);
 	configRotation(0);
@@ -87,7 +309,7 @@ void ViewContext::reset()
 void ViewContext::translate()
 {
 	// translate in the model coordinates
-	netTranslation = netTranslation * translation;
+	netTranslation *= translation;
 	netTranslationInv = translationInv * netTranslationInv;
 	
 	updateComposite();
@@ -98,11 +320,11 @@ void ViewContext::rotate(bool cw)
 	// rotate in the model coordinates
 	if (cw)
 	{
-		netRotation = netRotation * rotation;
+		netRotation *= rotation;
 		netRotationInv = rotationInv * netRotationInv;
 	} else
 	{
-		netRotation = netRotation * rotationInv;
+		netRotation *= rotationInv;
 		netRotationInv = rotation * netRotationInv;
 	}
 	
@@ -114,10 +336,10 @@ void ViewContext::zoom(bool in)
 	// accumulate to netZoom
 	if (in) 
 	{
-		netScale = netScale * scale;
+		netScale *= scale;
 		netScaleInv = scaleInv * netScaleInv;
 	} else {
-		netScale = netScale * scaleInv;
+		netScale *= scaleInv;
 		netScaleInv = scale * netScaleInv;
 	}
 	
@@ -129,6 +351,7 @@ void ViewContext::updateComposite()
 	resetComposite();
 	// apply zoom, rotation, than translation
 	composite = composite * netTranslation * netRotation * netScale;
+	modelView = vTm * netTranslation * netRotation * netScale;
 	compositeInv = netScaleInv * netRotationInv * 
 			netTranslationInv * compositeInv;
 }
@@ -140,6 +363,9 @@ void ViewContext::resetComposite()
 	config_pTv(25);
 	config_dTp();
 	composite = dTp*pTv*vTm;
+	modelView = vTm;
+	// updateComposite goes through here too, so this covers every change
+	revision = nextRevision++;
 
 	
 	/* old resetComposite TODO: remove?
@@ -156,44 +382,22 @@ void ViewContext::resetComposite()
 	*/
 }
 	
-matrix ViewContext::computeTranslation(double dx, double dy, double dz)
+Mat4 ViewContext::computeTranslation(double dx, double dy, double dz)
 {
-	// reset translation and translationInv to identity
-	matrix tranMatrix = matrix::identity(4);
-	
-	// Set the translation matrix
-	tranMatrix[0][3] = dx;
-	tranMatrix[1][3] = dy;
-	tranMatrix[2][3] = dz;	
-	
-	return tranMatrix;
+	return Mat4::translation(dx, dy, dz);
 }
 
-matrix ViewContext::computeRotation(double angle, double x, double y, double z)
+Mat4 ViewContext::computeRotation(double angle, double x, double y, double z)
 {
 	// convert degrees to radians
 	angle = angle/180 * M_PI;
 		
-	// Translate to origin
-	matrix rotation = computeTranslation(-x, -y, -z);
-	
-	// composite the rotation matrix
-	matrix tempRot = matrix::identity(4);
-	
-	tempRot[0][0] = std::cos(angle);
-	tempRot[0][1] = -std::sin(angle);
-	tempRot[1][0] = std::sin(angle);
-	tempRot[1][1] = std::cos(angle);
-	
-	rotation = tempRot * rotation;
-	
-	// Translate back to the center point
-	rotation = computeTranslation(x, y, z) * rotation;
-
-	return rotation;
+	// Translate to origin, rotate, then translate back to the center point
+	return computeTranslation(x, y, z) * Mat4::rotationZ(angle) * 
+			computeTranslation(-x, -y, -z);
 }
 
-matrix ViewContext::computeZoom(double multiplier, double x, double y, double z)
+Mat4 ViewContext::computeZoom(double multiplier, double x, double y, double z)
 {
 	// if the multiplier is non-positive, throw an exception
 	if (multiplier <= 0)
@@ -201,21 +405,10 @@ matrix ViewContext::computeZoom(double multiplier, double x, double y, double z)
 		throw viewContextException("scale multiplier be a positive double");
 	}
 			
-	// Translate to origin
-	matrix scale = computeTranslation(-x,-y,-z);
-	
-	// composite into the scale matrix the actual scaling
-	matrix scaleMatrix = matrix::identity(4);
-	for (int i=0; i<3; i++)
-	{
-		scaleMatrix[i][i] *= multiplier;
-	}
-	scale = scaleMatrix * scale;
-	
-	// Translate back to the point's center	
-	scale = computeTranslation(x,y,z) * scale;
-	
-	return scale;
+	// Translate to origin, scale, then translate back to the point's center
+	return computeTranslation(x, y, z) * 
+			Mat4::scale(multiplier, multiplier, multiplier) * 
+			computeTranslation(-x, -y, -z);
 }
 
 // Internal configuration of model to view
@@ -227,17 +420,17 @@ matrix ViewContext::computeZoom(double multiplier, double x, double y, double z)
 void ViewContext::config_vTm(double p0x, double p0y, double p0z)
 {
 	// converting from x,y,z coords to L,M,N coords... N = Pr -> p0
-	matrix N(3,1);
+	fixedMatrix<3,1> N;
 	N[0][0] = p0x;
 	N[1][0] = p0y;
 	N[2][0] = p0z;
 	// L = N x V, where V = y
-	matrix L(3,1);
+	fixedMatrix<3,1> L;
 	L[0][0] = N[2][0]; // VyNz - NyVz
 	L[1][0] = 0; // VzNx - NzVx, Vz and Vx always 0
 	L[2][0] = -N[0][0];
 	// M = N x L
-	matrix M(3,1);
+	fixedMatrix<3,1> M;
 	M[0][0] = N[1][0]*L[2][0] - N[2][0]*L[1][0];
 	M[1][0] = N[2][0]*L[0][0] - N[0][0]*L[2][0];
 	M[2][0] = N[0][0]*L[1][0] - N[1][0]*L[0][0];
@@ -274,9 +467,10 @@ void ViewContext::config_pTv(const double zf)
 		throw viewContextException("focal point must be behind the view plane!");
 	}
 	
-	pTv = matrix::identity(4);
-	// no z after projection
-	pTv[2][2] = 0;
+	// z is kept through the projection: it doesn't affect x and y, but
+	// after the divide by w it's a depth that is linear across the
+	// screen, which fillTriangle uses to hide surfaces
+	pTv = Mat4::identity();
 	// perspective projection
 	pTv[3][2] = -1/zf;
 }
@@ -290,7 +484,7 @@ void ViewContext::config_dTp()
 	// TODO: implement????
 	// old resetComposite...
 	// reflect y
-	dTp = matrix::identity(4);
+	dTp = Mat4::identity();
 	dTp[1][1] = -1;
 		
 	// image is inverted, and above the screen, translate down and right
@@ -314,4 +508,13 @@ void ViewContext::configZoom(double multiplier, double x, double y, double z)
 {
 	scale = computeZoom(multiplier, x, y, z);
 	scaleInv = computeZoom(1/multiplier, x, y, z);
-}
\ No newline at end of file
+}
+
+std::ostream& operator<<(std::ostream &os, const ViewContext::CullStats &stats)
+{
+	os << std::dec << "shapes: " << stats.shapesDrawn << " drawn, " 
+			<< stats.shapesCulled << " culled; facets: " << stats.facetsDrawn 
+			<< " drawn, " << stats.facetsOutside << " outside the view, " 
+			<< stats.facetsBackfacing << " facing away";
+	return os;
+}
@@ -0,0 +1,505 @@
+/* Provides an in-memory drawing context. Everything is drawn into a
+ * vector of 32-bit pixels, which can be saved as a PPM or PNG image.
+ */
+
+#include "fbcontext.h"
+#include "drawbase.h"
+#include "MappedFile.h" // for fileException
+#include <fstream>
+#include <algorithm> // for std::fill/std::copy
+#include <cstdlib> // for std::abs
+
+/**
+ * The only constructor provided. Allows size of the buffer and background
+ * color be specified.
+ * */
+FramebufferContext::FramebufferContext(unsigned int sizex, unsigned int sizey,
+		unsigned int bg_color)
+	: width(sizex), height(sizey), originX(0), originY(0), 
+	  storage(sizex*sizey, bg_color & 0xFFFFFF), pixels(storage.data()),
+	  background(bg_color & 0xFFFFFF), color(GraphicsContext::WHITE),
+	  mode(MODE_NORMAL)
+{
+	rasterizer.resize(width, height);
+}
+
+FramebufferContext::FramebufferContext(unsigned int sizex, unsigned int sizey,
+		unsigned int bg_color, int originX, int originY)
+	: width(sizex), height(sizey), originX(originX), originY(originY), 
+	  storage(sizex*sizey, bg_color & 0xFFFFFF), pixels(storage.data()),
+	  background(bg_color & 0xFFFFFF), color(GraphicsContext::WHITE),
+	  mode(MODE_NORMAL)
+{
+	rasterizer.resize(width, height, originX, originY);
+}
+
+FramebufferContext::FramebufferContext(unsigned int sizex, unsigned int sizey,
+		unsigned int bg_color, uint32_t* pixels)
+	: width(sizex), height(sizey), originX(0), originY(0), pixels(pixels),
+	  background(bg_color & 0xFFFFFF), color(GraphicsContext::WHITE),
+	  mode(MODE_NORMAL)
+{
+	rasterizer.resize(width, height);
+	clear();
+}
+
+FramebufferContext::~FramebufferContext()
+{
+	// storage frees the pixels, if they're its own
+}
+
+void FramebufferContext::setMode(drawMode newMode)
+{
+	mode = newMode;
+}
+
+void FramebufferContext::setColor(unsigned int color)
+{
+	this->color = color & 0xFFFFFF;
+}
+
+void FramebufferContext::setPixel(int x, int y)
+{
+	plotClipped(x, y);
+}
+
+unsigned int FramebufferContext::getPixel(int x, int y)
+{
+	if (x < originX || y < originY || x >= originX + width || 
+			y >= originY + height)
+	{
+		return background;
+	}
+	return pixels[(y - originY)*width + (x - originX)];
+}
+
+void FramebufferContext::getPixels(int x, int y, int width, int height,
+		unsigned int* colors)
+{
+	for (int row=y; row<y + height; row++)
+	{
+		// the part of the row inside the buffer is copied, the rest filled
+		int begin = std::max(x, originX);
+		int end = std::min(x + width, originX + this->width);
+		if (row < originY || row >= originY + this->height || begin >= end)
+		{
+			colors = std::fill_n(colors, width, background);
+			continue;
+		}
+		const uint32_t* source = pixels + (row - originY)*this->width;
+		colors = std::fill_n(colors, begin - x, background);
+		colors = std::copy(source + (begin - originX), source + (end - originX), 
+				colors);
+		colors = std::fill_n(colors, x + width - end, background);
+	}
+}
+
+void FramebufferContext::clear()
+{
+	std::fill(pixels, pixels + width*height, background);
+}
+
+// Lines are first cut down to this far from the origin, which keeps the
+// integer math in drawLine from overflowing
+static const double LINE_GUARD = 1 << 20;
+
+// Cohen-Sutherland region codes
+static const int CLIP_LEFT = 1;
+static const int CLIP_RIGHT = 2;
+static const int CLIP_TOP = 4;
+static const int CLIP_BOTTOM = 8;
+
+static int outCode(double x, double y, double low, double high)
+{
+	int code = 0;
+	if (x < low) code |= CLIP_LEFT;
+	else if (x > high) code |= CLIP_RIGHT;
+	if (y < low) code |= CLIP_TOP;
+	else if (y > high) code |= CLIP_BOTTOM;
+	return code;
+}
+
+// Cohen-Sutherland clipping of a line to the square [low, high]^2
+// @returns false if none of the line is inside
+static bool clipLine(double &ax, double &ay, double &bx, double &by, 
+		double low, double high)
+{
+	int codeA = outCode(ax, ay, low, high);
+	int codeB = outCode(bx, by, low, high);
+	while (codeA | codeB)
+	{
+		if (codeA & codeB)
+		{
+			// entirely on one side
+			return false;
+		}
+		
+		// move the endpoint that's outside onto the edge it crosses
+		int code = codeA ? codeA : codeB;
+		double x, y;
+		if (code & CLIP_LEFT)
+		{
+			x = low;
+			y = ay + (by - ay) * (low - ax) / (bx - ax);
+		}
+		else if (code & CLIP_RIGHT)
+		{
+			x = high;
+			y = ay + (by - ay) * (high - ax) / (bx - ax);
+		}
+		else if (code & CLIP_TOP)
+		{
+			y = low;
+			x = ax + (bx - ax) * (low - ay) / (by - ay);
+		}
+		else
+		{
+			y = high;
+			x = ax + (bx - ax) * (high - ay) / (by - ay);
+		}
+		
+		if (code == codeA)
+		{
+			ax = x;
+			ay = y;
+			codeA = outCode(ax, ay, low, high);
+		}
+		else
+		{
+			bx = x;
+			by = y;
+			codeB = outCode(bx, by, low, high);
+		}
+	}
+	return true;
+}
+
+void FramebufferContext::drawLine(int x1, int y1, int x2, int y2)
+{
+	// Lines reaching absurdly far are cut down to the guard square first.
+	// The square is the same for every buffer, so this doesn't change
+	// which pixels are drawn inside any one of them.
+	int64_t ax = x1, ay = y1, bx = x2, by = y2;
+	if (std::abs(ax) > LINE_GUARD || std::abs(ay) > LINE_GUARD || 
+			std::abs(bx) > LINE_GUARD || std::abs(by) > LINE_GUARD)
+	{
+		double cax = ax, cay = ay, cbx = bx, cby = by;
+		if (!clipLine(cax, cay, cbx, cby, -LINE_GUARD, LINE_GUARD))
+		{
+			return;
+		}
+		ax = std::lround(cax);
+		ay = std::lround(cay);
+		bx = std::lround(cbx);
+		by = std::lround(cby);
+	}
+	
+	// Walk the line along its major axis: pixel k is k steps along it, and
+	// the minor coordinate is rounded from (2*k*minor + major) / (2*major).
+	// That's the same pixel Bresenham's algorithm picks, but it can be
+	// computed from any k, so the walk only covers the part of the line
+	// inside the buffer.
+	bool xMajor = std::abs(bx - ax) >= std::abs(by - ay);
+	int64_t majorStart = xMajor ? ax : ay;
+	int64_t minorStart = xMajor ? ay : ax;
+	int64_t major = xMajor ? bx - ax : by - ay;
+	int64_t minor = xMajor ? by - ay : bx - ax;
+	int majorStep = (major < 0) ? -1 : 1;
+	int minorStep = (minor < 0) ? -1 : 1;
+	major = std::abs(major);
+	minor = std::abs(minor);
+	
+	// the range of the major axis inside the buffer, in steps from the start
+	int64_t low = xMajor ? originX : originY;
+	int64_t high = low + (xMajor ? width : height) - 1;
+	int64_t first = (majorStep > 0) ? low - majorStart : majorStart - high;
+	int64_t last = (majorStep > 0) ? high - majorStart : majorStart - low;
+	first = std::max(first, (int64_t)0);
+	last = std::min(last, major);
+	if (first > last)
+	{
+		return;
+	}
+	
+	// the range of the minor axis inside the buffer
+	int64_t minorLow = xMajor ? originY : originX;
+	int64_t minorHigh = minorLow + (xMajor ? height : width) - 1;
+	
+	// quotient and remainder of (2*k*minor + major) / (2*major), stepped
+	// along with k. A single-pixel line has major 0; use 1 instead.
+	int64_t denominator = 2*std::max(major, (int64_t)1);
+	int64_t numerator = 2*first*minor + major;
+	int64_t quotient = numerator / denominator;
+	int64_t remainder = numerator % denominator;
+	for (int64_t k = first; k <= last; k++)
+	{
+		int64_t m = minorStart + minorStep*quotient;
+		if (m >= minorLow && m <= minorHigh)
+		{
+			int64_t M = majorStart + majorStep*k;
+			if (xMajor)
+			{
+				plot(M, m);
+			}
+			else
+			{
+				plot(m, M);
+			}
+		}
+		remainder += 2*minor;
+		if (remainder >= denominator)
+		{
+			remainder -= denominator;
+			quotient++;
+		}
+	}
+}
+
+void FramebufferContext::drawCircle(int x0, int y0, unsigned int radius)
+{
+	// Midpoint circle: walk one octant and mirror it. Mirror images that
+	// land on the same pixel (on the axes and diagonals) are only plotted
+	// once, or XOR mode would cancel them out.
+	int x = 0;
+	int y = radius;
+	int d = 1 - y;
+	while (x <= y)
+	{
+		for (int octant=0; octant<2; octant++)
+		{
+			int dx = octant ? y : x;
+			int dy = octant ? x : y;
+			plotClipped(x0+dx, y0+dy);
+			if (dx != 0)
+			{
+				plotClipped(x0-dx, y0+dy);
+			}
+			if (dy != 0)
+			{
+				plotClipped(x0+dx, y0-dy);
+				if (dx != 0)
+				{
+					plotClipped(x0-dx, y0-dy);
+				}
+			}
+			// on the diagonal the second octant is the same points
+			if (x == y)
+			{
+				break;
+			}
+		}
+		
+		if (d < 0)
+		{
+			d += 2*x + 3;
+		}
+		else
+		{
+			d += 2*(x - y) + 5;
+			y--;
+		}
+		x++;
+	}
+}
+
+void FramebufferContext::fillTriangle(double x0, double y0, double z0,
+		double x1, double y1, double z1,
+		double x2, double y2, double z2)
+{
+	rasterizer.fillTriangle(x0, y0, z0, x1, y1, z1, x2, y2, z2, 
+		[this](int y, int xBegin, int xEnd)
+		{
+			uint32_t* row = pixels + (y - originY)*width;
+			if (mode == MODE_XOR)
+			{
+				for (int x = xBegin; x < xEnd; x++)
+				{
+					row[x - originX] ^= color;
+				}
+			}
+			else
+			{
+				std::fill(row + (xBegin - originX), row + (xEnd - originX), color);
+			}
+		});
+}
+
+void FramebufferContext::clearDepth()
+{
+	// the size never changes
+	rasterizer.clearDepth();
+}
+
+void FramebufferContext::runLoop(DrawingBase* drawing)
+{
+	// no window, no events: a single frame
+	drawing->paint(this);
+	flush();
+}
+
+int FramebufferContext::getWindowWidth()
+{
+	return width;
+}
+
+int FramebufferContext::getWindowHeight()
+{
+	return height;
+}
+
+const uint32_t* FramebufferContext::data() const
+{
+	return pixels;
+}
+
+// the frame as packed 8-bit RGB, the layout both PPM and PNG use
+static void writeRgbRow(const uint32_t* src, int width, char* dst)
+{
+	for (int x=0; x<width; x++)
+	{
+		dst[3*x] = (src[x] >> 16) & 0xFF;
+		dst[3*x+1] = (src[x] >> 8) & 0xFF;
+		dst[3*x+2] = src[x] & 0xFF;
+	}
+}
+
+void FramebufferContext::savePPM(const std::string &path) const
+{
+	std::ofstream ofs(path.c_str(), std::ios::binary);
+	ofs << "P6\n" << width << " " << height << "\n255\n";
+	
+	std::vector<char> row(3*width);
+	for (int y=0; y<height; y++)
+	{
+		writeRgbRow(&pixels[y*width], width, row.data());
+		ofs.write(row.data(), row.size());
+	}
+	
+	if (!ofs)
+	{
+		throw fileException("failed to write " + path);
+	}
+}
+
+// PNG wants a CRC-32 on every chunk
+static uint32_t crc32(uint32_t crc, const unsigned char* data, size_t size)
+{
+	static uint32_t table[256];
+	static bool haveTable = false;
+	if (!haveTable)
+	{
+		for (uint32_t n=0; n<256; n++)
+		{
+			uint32_t c = n;
+			for (int k=0; k<8; k++)
+			{
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		haveTable = true;
+	}
+	
+	crc = ~crc;
+	for (size_t i=0; i<size; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static void appendUint32(std::vector<unsigned char> &out, uint32_t value)
+{
+	out.push_back(value >> 24);
+	out.push_back(value >> 16);
+	out.push_back(value >> 8);
+	out.push_back(value);
+}
+
+// writes a chunk: length, type, data, CRC of type and data
+static void writePngChunk(std::ofstream &ofs, const char* type, 
+		const std::vector<unsigned char> &data)
+{
+	std::vector<unsigned char> chunk;
+	appendUint32(chunk, data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	appendUint32(chunk, crc32(0, &chunk[4], chunk.size() - 4));
+	ofs.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+void FramebufferContext::savePNG(const std::string &path) const
+{
+	std::ofstream ofs(path.c_str(), std::ios::binary);
+	static const unsigned char signature[8] = 
+			{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	ofs.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+	
+	// 8 bits per channel, RGB, no interlacing
+	std::vector<unsigned char> header;
+	appendUint32(header, width);
+	appendUint32(header, height);
+	header.push_back(8);
+	header.push_back(2);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	writePngChunk(ofs, "IHDR", header);
+	
+	// the scanlines, each preceded by filter type 0 (none)
+	size_t rowSize = 1 + 3*width;
+	std::vector<unsigned char> raw(rowSize*height);
+	for (int y=0; y<height; y++)
+	{
+		raw[y*rowSize] = 0;
+		writeRgbRow(&pixels[y*width], width, 
+				reinterpret_cast<char*>(&raw[y*rowSize + 1]));
+	}
+	
+	// A zlib stream of stored (uncompressed) deflate blocks, which hold
+	// at most 65535 bytes each, followed by the Adler-32 of the data
+	std::vector<unsigned char> zlib;
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t pos = 0;
+	do
+	{
+		size_t blockSize = std::min(raw.size() - pos, (size_t)65535);
+		bool last = pos + blockSize == raw.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(blockSize & 0xFF);
+		zlib.push_back(blockSize >> 8);
+		zlib.push_back(~blockSize & 0xFF);
+		zlib.push_back((~blockSize >> 8) & 0xFF);
+		zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + blockSize);
+		pos += blockSize;
+	} while (pos < raw.size());
+	
+	uint32_t a = 1, b = 0;
+	for (size_t i=0; i<raw.size(); i++)
+	{
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	appendUint32(zlib, (b << 16) | a);
+	writePngChunk(ofs, "IDAT", zlib);
+	
+	writePngChunk(ofs, "IEND", std::vector<unsigned char>());
+	
+	if (!ofs)
+	{
+		throw fileException("failed to write " + path);
+	}
+}
+
+void FramebufferContext::save(const std::string &path) const
+{
+	if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".png") == 0)
+	{
+		savePNG(path);
+	}
+	else
+	{
+		savePPM(path);
+	}
+}
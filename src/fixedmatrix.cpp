@@ -0,0 +1,19 @@
+// @file fixedmatrix.cpp
+// Non-template helpers bridging fixedMatrix and matrix
+
+#include "fixedmatrix.h"
+#include "matkernel.h"
+
+matrix operator*(const Mat4& lhs, const matrix& rhs)
+{
+	if (rhs.getRows() != 4)
+	{
+		throw matrixException("inner dimensions of multiplied matrices don't match");
+	}
+
+	// the 4x4 * 4xN batch transform: the hot path of every draw
+	matrix retVal(4, rhs.getCols());
+	multiplyWide(lhs[0], 4, 4, rhs.data(), rhs.getCols(), retVal.data());
+
+	return retVal;
+}
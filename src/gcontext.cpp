@@ -6,6 +6,7 @@
 #include <cmath>	// for trig functions
 #include <iostream> // for debugging
 #include "gcontext.h"	
+#include "drawbase.h"
 
 
 /*
@@ -18,6 +19,20 @@ GraphicsContext::~GraphicsContext()
 }
 
 
+// Reads the rectangle a pixel at a time
+void GraphicsContext::getPixels(int x, int y, int width, int height,
+		unsigned int* pixels)
+{
+	for (int row=0; row<height; row++)
+	{
+		for (int col=0; col<width; col++)
+		{
+			*pixels++ = getPixel(x + col, y + row);
+		}
+	}
+}
+
+
 /* Bresenham's line algorithm -- No floating point arithmetic.
  * Only integer add/subtract and bit shifting
  * 
@@ -146,9 +161,45 @@ void GraphicsContext::drawCircle(int x0, int y0, unsigned int radius)
 	return;	
 }
 
+void GraphicsContext::fillTriangle(double x0, double y0, double z0,
+		double x1, double y1, double z1,
+		double x2, double y2, double z2)
+{
+	rasterizer.fillTriangle(x0, y0, z0, x1, y1, z1, x2, y2, z2, 
+		[this](int y, int xBegin, int xEnd)
+		{
+			drawLine(xBegin, y, xEnd - 1, y);
+		});
+}
+
+void GraphicsContext::clearDepth()
+{
+	int width = getWindowWidth();
+	int height = getWindowHeight();
+	if (width != rasterizer.getWidth() || height != rasterizer.getHeight())
+	{
+		// resizing clears too
+		rasterizer.resize(width, height);
+	}
+	else
+	{
+		rasterizer.clearDepth();
+	}
+}
+
+void GraphicsContext::flush()
+{
+	// nothing is queued by default
+}
+
 void GraphicsContext::endLoop()
 {
 	run = false;
 }
 
+void GraphicsContext::repaint(DrawingBase* drawing)
+{
+	drawing->paint(this);
+}
+
 
@@ -1,10 +1,69 @@
 #include "x11context.h"
+#include "fbcontext.h"
+#include "MappedFile.h"
 #include <unistd.h>
 #include <iostream>
+#include <string>
 #include "mydrawing.h"
 
-int main(void) {
-	GraphicsContext *gc = new X11Context(800, 600, GraphicsContext::BLACK);
+int main(int argc, char** argv) {
+	// "-o file" renders one frame without a display and saves it
+	// (PNG if the name ends in .png, PPM otherwise)
+	// "-p pixmap|image|shm" picks how frames reach the window; the
+	// best one the display supports is used by default
+	const char* outPath = NULL;
+	X11Context::presentMode present = X11Context::PRESENT_SHM;
+	bool usage = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:p:")) != -1)
+	{
+		if (opt == 'o')
+		{
+			outPath = optarg;
+		}
+		else if (opt == 'p' && std::string(optarg) == "pixmap")
+		{
+			present = X11Context::PRESENT_PIXMAP;
+		}
+		else if (opt == 'p' && std::string(optarg) == "image")
+		{
+			present = X11Context::PRESENT_IMAGE;
+		}
+		else if (opt == 'p' && std::string(optarg) == "shm")
+		{
+			present = X11Context::PRESENT_SHM;
+		}
+		else
+		{
+			usage = true;
+		}
+	}
+	if (usage)
+	{
+		std::cerr << "usage: " << argv[0] 
+				<< " [-o image.png] [-p pixmap|image|shm]" << std::endl;
+		return 1;
+	}
+	
+	if (outPath)
+	{
+		FramebufferContext fb(800, 600, GraphicsContext::BLACK);
+		fb.setColor(GraphicsContext::GREEN);
+		// the drawing paints itself once constructed
+		MyDrawing md(&fb);
+		try
+		{
+			fb.save(outPath);
+		}
+		catch (fileException &e)
+		{
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+	
+	GraphicsContext *gc = new X11Context(800, 600, GraphicsContext::BLACK, present);
 	gc->setColor(GraphicsContext::GREEN);
 	// make a drawing
 	MyDrawing md(gc);
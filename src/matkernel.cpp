@@ -0,0 +1,177 @@
+// @file matkernel.cpp
+// Scalar, SSE2 and AVX2 implementations of multiplyWide, plus the runtime
+// selection between them. See matkernel.h.
+
+#include "matkernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MATKERNEL_X86
+#include <immintrin.h>
+#endif
+
+// number of columns of b/out processed per block. A 4 row block of b is
+// 4*256*8 = 8KB, which comfortably stays in L1 while every row of a is
+// applied to it.
+static const unsigned int COL_BLOCK = 256;
+
+// Scalar tail/fallback: computes columns [c0, c1) of out
+static void multiplyColumns(const double* a, unsigned int aRows, unsigned int k,
+		const double* b, unsigned int n, double* out,
+		unsigned int c0, unsigned int c1)
+{
+	for (unsigned int r=0; r<aRows; r++)
+	{
+		const double* aRow = a + r*k;
+		double* outRow = out + r*n;
+		for (unsigned int c=c0; c<c1; c++)
+		{
+			double sum = 0;
+			for (unsigned int i=0; i<k; i++)
+			{
+				sum += aRow[i] * b[i*n + c];
+			}
+			outRow[c] = sum;
+		}
+	}
+}
+
+void multiplyWideScalar(const double* a, unsigned int aRows, unsigned int k,
+		const double* b, unsigned int n, double* out)
+{
+	for (unsigned int c0=0; c0<n; c0+=COL_BLOCK)
+	{
+		unsigned int c1 = (c0 + COL_BLOCK < n) ? c0 + COL_BLOCK : n;
+		multiplyColumns(a, aRows, k, b, n, out, c0, c1);
+	}
+}
+
+#ifdef MATKERNEL_X86
+
+// SSE2: two columns per vector
+__attribute__((target("sse2")))
+static void multiplyWideSse2(const double* a, unsigned int aRows, unsigned int k,
+		const double* b, unsigned int n, double* out)
+{
+	for (unsigned int c0=0; c0<n; c0+=COL_BLOCK)
+	{
+		unsigned int c1 = (c0 + COL_BLOCK < n) ? c0 + COL_BLOCK : n;
+		unsigned int vecEnd = c0 + ((c1 - c0) & ~1u);
+		for (unsigned int r=0; r<aRows; r++)
+		{
+			const double* aRow = a + r*k;
+			double* outRow = out + r*n;
+			for (unsigned int c=c0; c<vecEnd; c+=2)
+			{
+				__m128d sum = _mm_setzero_pd();
+				for (unsigned int i=0; i<k; i++)
+				{
+					__m128d bv = _mm_loadu_pd(b + i*n + c);
+					sum = _mm_add_pd(sum, _mm_mul_pd(_mm_set1_pd(aRow[i]), bv));
+				}
+				_mm_storeu_pd(outRow + c, sum);
+			}
+		}
+		multiplyColumns(a, aRows, k, b, n, out, vecEnd, c1);
+	}
+}
+
+// AVX2: four columns per vector. The 4x4 * 4xN case (the composite
+// transform) keeps the four rows of b in registers and reuses them for every
+// row of a; other shapes go through the generic loop.
+__attribute__((target("avx2")))
+static void multiplyWideAvx2(const double* a, unsigned int aRows, unsigned int k,
+		const double* b, unsigned int n, double* out)
+{
+	for (unsigned int c0=0; c0<n; c0+=COL_BLOCK)
+	{
+		unsigned int c1 = (c0 + COL_BLOCK < n) ? c0 + COL_BLOCK : n;
+		unsigned int vecEnd = c0 + ((c1 - c0) & ~3u);
+		if (aRows == 4 && k == 4)
+		{
+			for (unsigned int c=c0; c<vecEnd; c+=4)
+			{
+				__m256d b0 = _mm256_loadu_pd(b + c);
+				__m256d b1 = _mm256_loadu_pd(b + n + c);
+				__m256d b2 = _mm256_loadu_pd(b + 2*n + c);
+				__m256d b3 = _mm256_loadu_pd(b + 3*n + c);
+				for (unsigned int r=0; r<4; r++)
+				{
+					const double* aRow = a + r*4;
+					__m256d sum = _mm256_setzero_pd();
+					sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_set1_pd(aRow[0]), b0));
+					sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_set1_pd(aRow[1]), b1));
+					sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_set1_pd(aRow[2]), b2));
+					sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_set1_pd(aRow[3]), b3));
+					_mm256_storeu_pd(out + r*n + c, sum);
+				}
+			}
+		}
+		else
+		{
+			for (unsigned int r=0; r<aRows; r++)
+			{
+				const double* aRow = a + r*k;
+				double* outRow = out + r*n;
+				for (unsigned int c=c0; c<vecEnd; c+=4)
+				{
+					__m256d sum = _mm256_setzero_pd();
+					for (unsigned int i=0; i<k; i++)
+					{
+						__m256d bv = _mm256_loadu_pd(b + i*n + c);
+						sum = _mm256_add_pd(sum,
+								_mm256_mul_pd(_mm256_set1_pd(aRow[i]), bv));
+					}
+					_mm256_storeu_pd(outRow + c, sum);
+				}
+			}
+		}
+		multiplyColumns(a, aRows, k, b, n, out, vecEnd, c1);
+	}
+}
+
+#endif
+
+typedef void (*multiplyFunc)(const double*, unsigned int, unsigned int,
+		const double*, unsigned int, double*);
+
+// picks the best implementation for this CPU. Called once.
+static multiplyFunc selectMultiply(const char** name)
+{
+#ifdef MATKERNEL_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		*name = "avx2";
+		return multiplyWideAvx2;
+	}
+	if (__builtin_cpu_supports("sse2"))
+	{
+		*name = "sse2";
+		return multiplyWideSse2;
+	}
+#endif
+	*name = "scalar";
+	return multiplyWideScalar;
+}
+
+static const char* selectedName = "scalar";
+
+// function-local static, so the choice is made on first use even if that
+// happens during another file's static initialization
+static multiplyFunc selected()
+{
+	static const multiplyFunc func = selectMultiply(&selectedName);
+	return func;
+}
+
+void multiplyWide(const double* a, unsigned int aRows, unsigned int k,
+		const double* b, unsigned int n, double* out)
+{
+	selected()(a, aRows, k, b, n, out);
+}
+
+const char* multiplyWideImpl()
+{
+	selected();
+	return selectedName;
+}
@@ -1,13 +1,16 @@
 #include "matrix.h"
+#include "matkernel.h"
 #include <string>
 #include <cmath>
 #include <iostream>
 #include <iomanip>
+#include <algorithm> // for std::copy
 
 using namespace std;
 
 // Parameterized constructor
-matrix::matrix(unsigned int rows, unsigned int cols):rows(rows),cols(cols) 
+matrix::matrix(unsigned int rows, unsigned int cols)
+	: rows(rows), cols(cols), owner(true)
 {  
 	if (rows < 1 || cols < 1)
 	{
@@ -21,49 +24,103 @@ matrix::matrix(unsigned int rows, unsigned int cols):rows(rows),cols(cols)
 	this->clear();
 }
 
+// Constructor over external storage
+matrix::matrix(unsigned int rows, unsigned int cols, double* storage)
+	: the_matrix(storage), rows(rows), cols(cols), owner(false)
+{
+	if (rows < 1 || cols < 1)
+	{
+		throw matrixException("p-constructor bad arguments");
+	}
+}
+
 // Copy constructor
-matrix::matrix(const matrix& from):rows(from.rows),cols(from.cols)
+matrix::matrix(const matrix& from)
+	: rows(from.rows), cols(from.cols), owner(true)
 {
 	// Create a new the_matrix in the heap!
 	the_matrix = new double[rows*cols];
 	
-	// Copy the matrix data!
-	for(unsigned int r=0; r<this->rows; r++)
-	{
-		for(unsigned int c=0; c<this->cols; c++)
-		{
-			this->the_matrix[this->cols*r + c] = from[r][c];
-		}
-	}
+	// Copy the matrix data! Same layout, so one straight copy
+	std::copy(from.the_matrix, from.the_matrix + rows*cols, this->the_matrix);
+
+}
 
+// Move constructor
+matrix::matrix(matrix&& from) noexcept
+	: the_matrix(from.the_matrix), rows(from.rows), cols(from.cols), 
+	  owner(from.owner)
+{
+	// from gives up its storage, it must not free it
+	from.the_matrix = NULL;
+	from.rows = 0;
+	from.cols = 0;
+	from.owner = true;
 }
 
 // Destructor
 matrix::~matrix()
 {
-	delete [] the_matrix;
+	if (owner)
+	{
+		delete [] the_matrix;
+	}
 	// stub
 }
 
 // Assignment operator
 matrix& matrix::operator=(const matrix& rhs)
 {
-	// Copy rhs's cols and rows
+	// self assignment would read from storage we may be replacing
+	if (this == &rhs)
+	{
+		return *this;
+	}
+	
+	// Take rhs's cols and rows, only replacing the_matrix if it's
+	// not already the right size
+	resize(rhs.rows, rhs.cols);
+	
+	std::copy(rhs.the_matrix, rhs.the_matrix + rows*cols, this->the_matrix);
+	
+	return *this;
+}
+
+// Move assignment
+matrix& matrix::operator=(matrix&& rhs) noexcept
+{
+	// swap, rhs's destructor frees what we used to hold
+	double* tmpMatrix = this->the_matrix;
+	unsigned int tmpRows = this->rows;
+	unsigned int tmpCols = this->cols;
+	bool tmpOwner = this->owner;
+	
+	this->the_matrix = rhs.the_matrix;
 	this->rows = rhs.rows;
 	this->cols = rhs.cols;
+	this->owner = rhs.owner;
 	
-	// replace the_matrix with a new one
-	delete [] this->the_matrix;
-	this->the_matrix = new double[this->rows*this->cols];
-	for(unsigned int r=0; r<this->rows; r++)
+	rhs.the_matrix = tmpMatrix;
+	rhs.rows = tmpRows;
+	rhs.cols = tmpCols;
+	rhs.owner = tmpOwner;
+	
+	return *this;
+}
+
+void matrix::resize(unsigned int rows, unsigned int cols)
+{
+	if (this->rows*this->cols != rows*cols)
 	{
-		for(unsigned int c=0; c<this->cols; c++)
+		if (owner)
 		{
-			this->the_matrix[this->cols*r + c] = rhs[r][c];
+			delete [] this->the_matrix;
 		}
+		this->the_matrix = new double[rows*cols];
+		owner = true;
 	}
-	
-	return *this;
+	this->rows = rows;
+	this->cols = cols;
 }
 
 // Named constructor (static)
@@ -78,7 +135,7 @@ matrix matrix::identity(unsigned int size)
 	matrix m(size, size);
 	for (unsigned int i=0; i<size; i++)
 	{
-		m[i][i] = 1;
+		m.uncheckedAt(i, i) = 1;
 	}
 	return m;
 }
@@ -93,6 +150,11 @@ int matrix::getCols() const
 	return cols;
 }
 
+bool matrix::ownsStorage() const
+{
+	return owner;
+}
+
 // Binary operations
 matrix matrix::operator+(const matrix& rhs) const
 {
@@ -104,13 +166,7 @@ matrix matrix::operator+(const matrix& rhs) const
 	
 	// Add into a new matrix!
 	matrix retVal(rhs);
-	for (unsigned int r=0; r<this->rows; r++)
-	{
-		for (unsigned int c=0; c<this->cols; c++)
-		{
-			retVal[r][c] += (*this)[r][c];
-		}
-	}
+	retVal += *this;
 	
 	return retVal;
 }
@@ -127,24 +183,7 @@ matrix matrix::operator*(const matrix& rhs) const
 	
 	// Result is a matrix with size of outer dimensions nxp
 	matrix retVal(this->rows, rhs.cols);
-		
-	// perform multiplication (i don't like this O(n*m*p) algorithm
-	for (unsigned int r=0; r<this->rows; r++)
-	{
-		for (unsigned int rhs_c=0; rhs_c<rhs.cols; rhs_c++)
-		{
-			// each column of this will be multiplied by each row of rhs. 
-			// We know those sides are identical
-			// repeat this process for each column of rhs
-			
-			// each time this loop runs, one element of retVal will be computed: 
-			// retVal[r][rhs_c]; Horizontal to vertical multiplication scan!
-			for (unsigned int i=0; i<this->cols; i++)
-			{
-				retVal[r][rhs_c] += (*this)[r][i] * rhs[i][rhs_c];
-			}
-		}
-	}
+	matrix::multiplyInto(retVal, *this, rhs);
 	
 	return retVal;
 }
@@ -152,17 +191,103 @@ matrix matrix::operator*(const matrix& rhs) const
 matrix matrix::operator*(const double scale) const
 {
 	matrix retVal(*this);
+	retVal *= scale;
+	return retVal;
+}
+
 
+// In-place operations
+matrix& matrix::operator+=(const matrix& rhs)
+{
+	if (this->rows != rhs.rows || this->cols != rhs.cols)
+	{
+		throw matrixException("Added matrices must be of exact dimensions");
+	}
+	
+	// same dimensions, same layout: add element by element
+	for (unsigned int i=0; i<this->rows*this->cols; i++)
+	{
+		this->the_matrix[i] += rhs.the_matrix[i];
+	}
+	
+	return *this;
+}
+
+matrix& matrix::operator*=(const matrix& rhs)
+{
+	// the product keeps our size only if rhs is cols x cols
+	if (this->cols != rhs.rows || rhs.rows != rhs.cols)
+	{
+		throw matrixException("in-place multiplication needs a square rhs " \
+				"matching the columns of lhs");
+	}
+	
+	if (this == &rhs)
+	{
+		// every row of the result depends on all of rhs
+		matrix::multiplyInto(*this, *this, rhs);
+		return *this;
+	}
+	
+	// Each row of the result only depends on the same row of this, so
+	// compute one row into a scratch buffer and write it back.
+	// Small rows (the 4-wide case) never touch the heap.
+	const unsigned int STACK_ROW = 16;
+	double stackRow[STACK_ROW];
+	double* rowBuf = (this->cols <= STACK_ROW) ? stackRow : new double[this->cols];
+	
 	for (unsigned int r=0; r<this->rows; r++)
 	{
 		for (unsigned int c=0; c<this->cols; c++)
 		{
-			retVal[r][c] *= scale;
+			double sum = 0;
+			for (unsigned int i=0; i<this->cols; i++)
+			{
+				sum += uncheckedAt(r, i) * rhs.uncheckedAt(i, c);
+			}
+			rowBuf[c] = sum;
 		}
-	}	
-	return retVal;
+		std::copy(rowBuf, rowBuf + this->cols, &uncheckedAt(r, 0));
+	}
+	
+	if (rowBuf != stackRow)
+	{
+		delete [] rowBuf;
+	}
+	
+	return *this;
 }
 
+matrix& matrix::operator*=(const double scale)
+{
+	for (unsigned int i=0; i<this->rows*this->cols; i++)
+	{
+		this->the_matrix[i] *= scale;
+	}
+	
+	return *this;
+}
+
+void matrix::multiplyInto(matrix& dst, const matrix& a, const matrix& b)
+{
+	if (a.cols != b.rows)
+	{
+		throw matrixException("inner dimensions of multiplied matrices don't match");
+	}
+	
+	// writing into an operand would corrupt the rest of the product
+	if (&dst == &a || &dst == &b)
+	{
+		dst = a * b;
+		return;
+	}
+	
+	dst.resize(a.rows, b.cols);
+	
+	// blocked/vectorized kernel straight on the contiguous storage
+	multiplyWide(a.the_matrix, a.rows, a.cols, b.the_matrix, b.cols,
+			dst.the_matrix);
+}
 
 // Unary operations
 matrix matrix::operator~() const
@@ -175,7 +300,7 @@ matrix matrix::operator~() const
 	{
 		for (unsigned int c=0; c<this->cols; c++)
 		{
-			retVal[c][r] = (*this)[r][c];
+			retVal.uncheckedAt(c, r) = uncheckedAt(r, c);
 		}
 	}
 	
@@ -193,7 +318,7 @@ void matrix::clear()
 
 matrix::row matrix::operator[](unsigned int row)
 {
-	if (row > this->rows)
+	if (row >= this->rows)
 	{
 		throw matrixException("Row accessed are out of range");
 	}
@@ -204,7 +329,7 @@ matrix::row matrix::operator[](unsigned int row)
 
 const matrix::row matrix::operator[](unsigned int row) const
 {
-	if (row > this->rows)
+	if (row >= this->rows)
 	{
 		throw matrixException("Rows accessed are out of range");
 	}
@@ -227,7 +352,7 @@ std::ostream& matrix::out(std::ostream& os) const
 		os << "[";
 		for (unsigned int c=0; c<this->cols; c++)
 		{
-			os << setw(5) << (*this)[r][c] << " "; 
+			os << setw(5) << uncheckedAt(r, c) << " "; 
 		}
 		os << "]";
 		if (r < this->rows - 1)
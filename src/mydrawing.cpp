@@ -11,7 +11,9 @@
 #define SCALE 2
 #define DEFAULT_COLOR GraphicsContext::CYAN
 
-MyDrawing::MyDrawing(GraphicsContext *gc) {
+MyDrawing::MyDrawing(GraphicsContext *gc)
+	: drawn(false), drawnImageRevision(0), drawnViewRevision(0), 
+	  drawnBackface(false) {
 	// create the view contexts
 	vc = new ViewContext(gc->getWindowHeight(), gc->getWindowWidth());
 	// config rotation, and scale
@@ -27,22 +29,27 @@ MyDrawing::MyDrawing(GraphicsContext *gc) {
 	pts[0][1]= axisLen;
 	pts[1][1]= 0;
 	pts[2][1]= 0;
-	Line *xAxis = new Line(pts, GraphicsContext::RED);
+	image->emplace<Line>(pts, (int)GraphicsContext::RED);
 	pts[0][1] = 0;
 	pts[1][1] = axisLen;
 	pts[2][1] = 0;
-	Line *yAxis = new Line(pts, GraphicsContext::GREEN);
+	image->emplace<Line>(pts, (int)GraphicsContext::GREEN);
 	pts[0][1] = 0;
 	pts[1][1] = 0;
 	pts[2][1] = axisLen;
-	Line *zAxis = new Line(pts, GraphicsContext::BLUE);
-	
-	image->add(xAxis);
-	image->add(yAxis);
-	image->add(zAxis);
+	image->emplace<Line>(pts, (int)GraphicsContext::BLUE);
 	
 	// TODO: testing...
-	image->parseStl("word.stl");
+	try
+	{
+		image->setLoadVerbosity(Image::LOAD_REPORT);
+		image->parseStl("word.stl");
+	}
+	catch (imageException &e)
+	{
+		// still usable without the model, the axes are drawn
+		std::cerr << e.what() << std::endl;
+	}
 	paint(gc);
 	return;
 }
@@ -53,11 +60,27 @@ MyDrawing::~MyDrawing() {
 }
 
 void MyDrawing::paint(GraphicsContext *gc) {
+	// only draw if something visible changed
+	if (!drawn || image->getRevision() != drawnImageRevision || 
+			vc->getRevision() != drawnViewRevision || 
+			vc->isBackfaceCulling() != drawnBackface) {
+		render(gc);
+	}
+	// send the whole frame to the display at once
+	gc->flush();
+	return;
+}
+
+void MyDrawing::render(GraphicsContext *gc) {
 	gc->clear();
 	// redraw the image
 	gc->setColor(color);
 	image->draw(gc, vc);
-	return;
+	
+	drawn = true;
+	drawnImageRevision = image->getRevision();
+	drawnViewRevision = vc->getRevision();
+	drawnBackface = vc->isBackfaceCulling();
 }
 
 void MyDrawing::keyDown(GraphicsContext* gc, unsigned int keycode) {
@@ -74,25 +97,53 @@ void MyDrawing::keyUp(GraphicsContext *gc, unsigned int keycode) {
 void MyDrawing::handleImageCommands(GraphicsContext *gc, KeyProtocol key) {
 	switch (key) {
 	/* Loading/Saving images */
-	case MyDrawing::KeyProtocol::load: {
-		// input image from file!
+	case MyDrawing::KeyProtocol::load:
+		// input image from file, in whichever format it was saved
 		std::cout << "Loading image from Saved_Image.img" << std::endl;
-		std::ifstream ifs("Saved_Image.img");
-		// clear, input, redraw
-		gc->clear();
-		ifs >> *image;
-		// clear and redraw
-		paint(gc);
-		ifs.close();
-	}
-		break;
-	case MyDrawing::KeyProtocol::save: {
+		try {
+			image->load("Saved_Image.img");
+		}
+		catch (imageException &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		// redraw: the image changed
+		gc->repaint(this);
+		break;
+	case MyDrawing::KeyProtocol::save:
+	case MyDrawing::KeyProtocol::saveText:
 		// output image into file!
 		std::cout << "Saving image to Saved_Image.img" << std::endl;
-		std::ofstream ofs("Saved_Image.img");
-		ofs << *image;
-		ofs.close();
-	}
+		try {
+			image->save("Saved_Image.img", key == MyDrawing::KeyProtocol::save ?
+					Image::SAVE_COMPRESSED : Image::SAVE_TEXT);
+		}
+		catch (imageException &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		break;
+	/* Rendering Commands */
+	case MyDrawing::KeyProtocol::fill:
+		image->setFilled(!image->isFilled());
+		std::cout << (image->isFilled() ? "Filled" : "Wireframe") << " rendering"
+				<< std::endl;
+		gc->repaint(this);
+		break;
+	case MyDrawing::KeyProtocol::backface:
+		vc->setBackfaceCulling(!vc->isBackfaceCulling());
+		std::cout << "Backface culling " << (vc->isBackfaceCulling() ? "on" : "off")
+				<< std::endl;
+		// painted right away, so the statistics are for the new setting
+		paint(gc);
+		std::cout << vc->getCullStats() << std::endl;
+		break;
+	case MyDrawing::KeyProtocol::packed:
+		image->setPacked(!image->isPacked());
+		std::cout << "Shapes stored " << (image->isPacked() ? "in per-type arrays" :
+				"as objects") << std::endl;
+		gc->repaint(this);
+		break;
+	case MyDrawing::KeyProtocol::cullStats:
+		std::cout << vc->getCullStats() << std::endl;
 		break;
 	/* Color Commands */
 	case MyDrawing::KeyProtocol::black:
@@ -186,8 +237,9 @@ void MyDrawing::handleViewCommands(GraphicsContext *gc, KeyProtocol key) {
 		break;
 	}
 
-	// redraw the image since the coords changed
+	// redraw the image since the coords changed. Repeated keys only
+	// move the view; the image is drawn once they've all been handled.
 	if (performedTransformation) {
-		paint(gc);
+		gc->repaint(this);
 	}
 }
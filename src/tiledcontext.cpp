@@ -0,0 +1,348 @@
+/* Provides a drawing context that records operations, bins them into
+ * tiles and draws the tiles in parallel. See tiledcontext.h.
+ */
+
+#include "tiledcontext.h"
+#include <cmath>
+#include <algorithm>
+
+// fewest commands worth binning on a thread of their own
+static const size_t MIN_BIN_CHUNK = 4096;
+
+TiledContext::TiledContext(unsigned int sizex, unsigned int sizey,
+		unsigned int bg_color, ThreadPool &pool)
+	: FramebufferContext(sizex, sizey, bg_color), pool(pool),
+	  direct(pool.getNumThreads() == 1)
+{
+	if (direct)
+	{
+		tilesX = tilesY = 0;
+		return;
+	}
+	tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	for (int ty=0; ty<tilesY; ty++)
+	{
+		for (int tx=0; tx<tilesX; tx++)
+		{
+			// the last row and column may be cut short
+			int x = tx*TILE_SIZE;
+			int y = ty*TILE_SIZE;
+			tiles.push_back(std::unique_ptr<FramebufferContext>(
+					new FramebufferContext(std::min(TILE_SIZE, width - x), 
+					std::min(TILE_SIZE, height - y), bg_color, x, y)));
+		}
+	}
+}
+
+TiledContext::~TiledContext()
+{
+	// the tiles free themselves
+}
+
+void TiledContext::record(Command::Type type, int numArgs, const double* args)
+{
+	Command command;
+	command.type = type;
+	command.color = color;
+	command.mode = mode;
+	std::copy(args, args + numArgs, command.args);
+	commands.push_back(command);
+}
+
+void TiledContext::setPixel(int x, int y)
+{
+	if (direct)
+	{
+		FramebufferContext::setPixel(x, y);
+		return;
+	}
+	double args[2] = {(double)x, (double)y};
+	record(Command::PIXEL, 2, args);
+}
+
+void TiledContext::clear()
+{
+	if (direct)
+	{
+		FramebufferContext::clear();
+		return;
+	}
+	record(Command::CLEAR, 0, NULL);
+}
+
+void TiledContext::drawLine(int x1, int y1, int x2, int y2)
+{
+	if (direct)
+	{
+		FramebufferContext::drawLine(x1, y1, x2, y2);
+		return;
+	}
+	double args[4] = {(double)x1, (double)y1, (double)x2, (double)y2};
+	record(Command::LINE, 4, args);
+}
+
+void TiledContext::drawCircle(int x, int y, unsigned int radius)
+{
+	if (direct)
+	{
+		FramebufferContext::drawCircle(x, y, radius);
+		return;
+	}
+	double args[3] = {(double)x, (double)y, (double)radius};
+	record(Command::CIRCLE, 3, args);
+}
+
+void TiledContext::fillTriangle(double x0, double y0, double z0,
+		double x1, double y1, double z1,
+		double x2, double y2, double z2)
+{
+	if (direct)
+	{
+		FramebufferContext::fillTriangle(x0, y0, z0, x1, y1, z1, x2, y2, z2);
+		return;
+	}
+	double args[9] = {x0, y0, z0, x1, y1, z1, x2, y2, z2};
+	record(Command::TRIANGLE, 9, args);
+}
+
+void TiledContext::clearDepth()
+{
+	if (direct)
+	{
+		FramebufferContext::clearDepth();
+		return;
+	}
+	record(Command::CLEAR_DEPTH, 0, NULL);
+}
+
+unsigned int TiledContext::getPixel(int x, int y)
+{
+	flush();
+	return FramebufferContext::getPixel(x, y);
+}
+
+void TiledContext::getPixels(int x, int y, int width, int height,
+		unsigned int* pixels)
+{
+	flush();
+	FramebufferContext::getPixels(x, y, width, height, pixels);
+}
+
+void TiledContext::flush()
+{
+	if (commands.empty())
+	{
+		return;
+	}
+	
+	// bin in parallel, in chunks of the command list
+	size_t numChunks = std::min((size_t)pool.getNumThreads() * 4,
+			(commands.size() + MIN_BIN_CHUNK - 1) / MIN_BIN_CHUNK);
+	if (bins.size() < numChunks)
+	{
+		bins.resize(numChunks);
+	}
+	pool.parallelFor(numChunks, [&](unsigned int chunk)
+	{
+		binCommands(chunk, commands.size()*chunk / numChunks,
+				commands.size()*(chunk + 1) / numChunks);
+	});
+	
+	// then draw the tiles. Tiles don't overlap, so neither do their
+	// copies into the framebuffer.
+	pool.parallelFor(tiles.size(), [&](unsigned int tile)
+	{
+		drawTile(tile);
+	});
+	
+	// chunks past numChunks hold nothing from this frame
+	for (size_t c=0; c<numChunks; c++)
+	{
+		for (size_t t=0; t<bins[c].size(); t++)
+		{
+			bins[c][t].clear();
+		}
+	}
+	commands.clear();
+}
+
+void TiledContext::binCommands(unsigned int chunk, size_t begin, size_t end)
+{
+	std::vector<std::vector<unsigned int> > &chunkBins = bins[chunk];
+	chunkBins.resize(tiles.size());
+	
+	for (size_t i=begin; i<end; i++)
+	{
+		const Command &command = commands[i];
+		
+		// the pixels the command may touch
+		double minX, minY, maxX, maxY;
+		switch (command.type)
+		{
+		case Command::PIXEL:
+			minX = maxX = command.args[0];
+			minY = maxY = command.args[1];
+			break;
+		case Command::LINE:
+			minX = std::min(command.args[0], command.args[2]);
+			maxX = std::max(command.args[0], command.args[2]);
+			minY = std::min(command.args[1], command.args[3]);
+			maxY = std::max(command.args[1], command.args[3]);
+			break;
+		case Command::CIRCLE:
+			minX = command.args[0] - command.args[2];
+			maxX = command.args[0] + command.args[2];
+			minY = command.args[1] - command.args[2];
+			maxY = command.args[1] + command.args[2];
+			break;
+		case Command::TRIANGLE:
+			minX = std::min(command.args[0], std::min(command.args[3], command.args[6]));
+			maxX = std::max(command.args[0], std::max(command.args[3], command.args[6]));
+			minY = std::min(command.args[1], std::min(command.args[4], command.args[7]));
+			maxY = std::max(command.args[1], std::max(command.args[4], command.args[7]));
+			break;
+		default:
+			// clearing applies to every tile
+			minX = minY = 0;
+			maxX = width - 1;
+			maxY = height - 1;
+			break;
+		}
+		
+		// rounded out to whole pixels; anything unusable (NaN) or off
+		// the framebuffer touches no tile
+		minX = std::floor(minX);
+		minY = std::floor(minY);
+		maxX = std::ceil(maxX);
+		maxY = std::ceil(maxY);
+		if (!(maxX >= 0 && maxY >= 0 && minX <= width - 1 && minY <= height - 1))
+		{
+			continue;
+		}
+		int firstX = (int)std::max(minX, 0.0) / TILE_SIZE;
+		int firstY = (int)std::max(minY, 0.0) / TILE_SIZE;
+		int lastX = (int)std::min(maxX, (double)width - 1) / TILE_SIZE;
+		int lastY = (int)std::min(maxY, (double)height - 1) / TILE_SIZE;
+		
+		for (int ty=firstY; ty<=lastY; ty++)
+		{
+			// Lines and triangles cross only a few tiles of their
+			// bounding box, those between their leftmost and rightmost
+			// point within this row of tiles. Those points lie on the
+			// lines or the triangle's edges.
+			int rowFirstX = firstX, rowLastX = lastX;
+			if (command.type == Command::LINE || command.type == Command::TRIANGLE)
+			{
+				const double* a = command.args;
+				double low = HUGE_VAL, high = -HUGE_VAL;
+				if (command.type == Command::LINE)
+				{
+					segmentExtent(a[0], a[1], a[2], a[3], ty, low, high);
+				}
+				else
+				{
+					segmentExtent(a[0], a[1], a[3], a[4], ty, low, high);
+					segmentExtent(a[3], a[4], a[6], a[7], ty, low, high);
+					segmentExtent(a[6], a[7], a[0], a[1], ty, low, high);
+				}
+				// give or take the pixel it's rounded to
+				low = std::floor(low) - 1;
+				high = std::ceil(high) + 1;
+				if (!(low <= high))
+				{
+					continue;
+				}
+				if (low > rowFirstX*TILE_SIZE)
+				{
+					rowFirstX = std::min((int)low / TILE_SIZE, lastX);
+				}
+				if (high < (rowLastX + 1)*TILE_SIZE)
+				{
+					rowLastX = std::max((int)std::max(high, 0.0) / TILE_SIZE, firstX);
+				}
+			}
+			for (int tx=rowFirstX; tx<=rowLastX; tx++)
+			{
+				chunkBins[ty*tilesX + tx].push_back(i);
+			}
+		}
+	}
+}
+
+void TiledContext::segmentExtent(double x1, double y1, double x2, double y2,
+		int ty, double &low, double &high) const
+{
+	// the part of the segment within the rows of the tiles
+	double top = std::max((double)ty*TILE_SIZE - 1, std::min(y1, y2));
+	double bottom = std::min((double)(ty + 1)*TILE_SIZE, std::max(y1, y2));
+	if (top > bottom)
+	{
+		return;
+	}
+	double xTop = x1, xBottom = x2;
+	if (y1 != y2)
+	{
+		xTop = x1 + (x2 - x1)*(top - y1)/(y2 - y1);
+		xBottom = x1 + (x2 - x1)*(bottom - y1)/(y2 - y1);
+	}
+	low = std::min(low, std::min(xTop, xBottom));
+	high = std::max(high, std::max(xTop, xBottom));
+}
+
+void TiledContext::drawTile(unsigned int tile)
+{
+	FramebufferContext &target = *tiles[tile];
+	
+	// the chunks in order, so the commands are replayed in the order
+	// they were recorded
+	for (size_t c=0; c<bins.size(); c++)
+	{
+		if (bins[c].size() <= tile)
+		{
+			continue;
+		}
+		const std::vector<unsigned int> &bin = bins[c][tile];
+		for (size_t b=0; b<bin.size(); b++)
+		{
+			const Command &command = commands[bin[b]];
+			const double* a = command.args;
+			target.setColor(command.color);
+			target.setMode(command.mode);
+			switch (command.type)
+			{
+			case Command::PIXEL:
+				target.setPixel(a[0], a[1]);
+				break;
+			case Command::LINE:
+				target.drawLine(a[0], a[1], a[2], a[3]);
+				break;
+			case Command::CIRCLE:
+				target.drawCircle(a[0], a[1], a[2]);
+				break;
+			case Command::TRIANGLE:
+				target.fillTriangle(a[0], a[1], a[2], a[3], a[4], a[5], 
+						a[6], a[7], a[8]);
+				break;
+			case Command::CLEAR:
+				target.clear();
+				break;
+			case Command::CLEAR_DEPTH:
+				target.clearDepth();
+				break;
+			}
+		}
+	}
+	
+	// copy the tile into its place in the framebuffer
+	int tileX = (tile % tilesX)*TILE_SIZE;
+	int tileY = (tile / tilesX)*TILE_SIZE;
+	int tileWidth = target.getWindowWidth();
+	int tileHeight = target.getWindowHeight();
+	const uint32_t* src = target.data();
+	for (int y=0; y<tileHeight; y++)
+	{
+		std::copy(src + y*tileWidth, src + (y + 1)*tileWidth, 
+				&pixels[(tileY + y)*width + tileX]);
+	}
+}
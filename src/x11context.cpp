@@ -9,14 +9,63 @@
 #include "x11context.h"
 #include "drawbase.h"
 #include <iostream>
+#include <climits> // for INT_MAX/INT_MIN
+#include <algorithm> // for std::min/std::max
+#include <chrono>
+#include <sys/select.h> // for waiting on the connection
+#include <sys/ipc.h> // for the shared memory of PRESENT_SHM
+#include <sys/shm.h>
+
+// set by the error handler while XShmAttach is checked
+static bool shmAttachFailed = false;
+
+static int shmAttachErrorHandler(Display* display, XErrorEvent* error)
+{
+	shmAttachFailed = true;
+	return 0;
+}
+
+// for XIfEvent: whether e is of the type arg points to
+static Bool isEventOfType(Display* display, XEvent* e, XPointer arg)
+{
+	return e->type == *(const int*)arg;
+}
+
+// sets up a channel from its mask in the visual
+static void setupChannel(unsigned long mask, int &shift, unsigned long &max)
+{
+	shift = 0;
+	while (mask && !(mask & 1))
+	{
+		mask >>= 1;
+		shift++;
+	}
+	max = mask;
+}
+
+// @returns LSBFirst or MSBFirst, the byte order of this machine's ints
+static int hostByteOrder()
+{
+	const uint32_t one = 1;
+	return *(const unsigned char*)&one ? LSBFirst : MSBFirst;
+}
 
 /**
  * The only constructor provided.  Allows size of window and background
  * color be specified.
  * */
 X11Context::X11Context(unsigned int sizex,unsigned int sizey,
-                       unsigned int bg_color)
+                       unsigned int bg_color, presentMode mode)
+	: bufferWidth(sizex), bufferHeight(sizey), background(bg_color), 
+	  presented(false), mode(mode), image(NULL), shmCompletionType(0), 
+	  shmPending(0), drawnLeft(INT_MAX), 
+	  drawnTop(INT_MAX), drawnRight(INT_MIN), drawnBottom(INT_MIN),
+	  paintRequested(false), exposedLeft(INT_MAX), exposedTop(INT_MAX), 
+	  exposedRight(INT_MIN), exposedBottom(INT_MIN)
 {
+	// not in the event loop yet
+	run = false;
+
 	// Open the display
 	display = XOpenDisplay(NULL);
 	
@@ -41,6 +90,47 @@ X11Context::X11Context(unsigned int sizex,unsigned int sizey,
 
 	// Default color to white
 	XSetForeground(display, graphics_context, GraphicsContext::WHITE);
+	currentColor = GraphicsContext::WHITE;
+	xorMode = false;
+	
+	// how to read pixel values back, worked out once
+	Visual* visual = DefaultVisual(display, DefaultScreen(display));
+	trueColor = (visual->c_class == TrueColor);
+	red.mask = visual->red_mask;
+	green.mask = visual->green_mask;
+	blue.mask = visual->blue_mask;
+	setupChannel(red.mask, red.shift, red.max);
+	setupChannel(green.mask, green.shift, green.max);
+	setupChannel(blue.mask, blue.shift, blue.max);
+	rgbPixels = trueColor && red.mask == 0xFF0000 && green.mask == 0xFF00 && 
+			blue.mask == 0xFF;
+	// nothing read yet
+	markDrawn(0, 0, sizex - 1, sizey - 1);
+	
+	// Copies to the window needn't report areas they couldn't copy: 
+	// neither a pixmap nor an image has any
+	XGCValues copyValues;
+	copyValues.graphics_exposures = False;
+	copy_context = XCreateGC(display, window, GCGraphicsExposures, &copyValues);
+	
+	// fall back as far as the display needs
+	if (this->mode == PRESENT_SHM && !createShmImage())
+	{
+		this->mode = PRESENT_IMAGE;
+	}
+	if (this->mode == PRESENT_IMAGE && !createImage())
+	{
+		this->mode = PRESENT_PIXMAP;
+	}
+	// the others draw into their frame instead
+	backBuffer = None;
+	if (this->mode == PRESENT_PIXMAP)
+	{
+		backBuffer = XCreatePixmap(display, window, sizex, sizey, 
+				DefaultDepth(display, DefaultScreen(display)));
+	}
+	// cleared to the background like the window
+	clear();
 
 	// Wait for MapNotify event
 	for(;;) 
@@ -70,7 +160,23 @@ X11Context::X11Context(unsigned int sizex,unsigned int sizey,
 // Destructor  - shut down window and connection to server
 X11Context::~X11Context()
 {
+	if (mode == PRESENT_SHM)
+	{
+		XShmDetach(display, &shmInfo);
+		shmdt(shmInfo.shmaddr);
+	}
+	if (image)
+	{
+		// the pixels belong to the frame or the shared memory
+		image->data = NULL;
+		XDestroyImage(image);
+	}
+	XFreeGC(display, copy_context);
 	XFreeGC(display, graphics_context);
+	if (backBuffer != None)
+	{
+		XFreePixmap(display, backBuffer);
+	}
 	XDestroyWindow(display,window);
 	XCloseDisplay(display);
 }
@@ -78,6 +184,14 @@ X11Context::~X11Context()
 // Set the drawing mode - argument is enumerated
 void X11Context::setMode(drawMode newMode)
 {
+	if (frame)
+	{
+		frame->setMode(newMode);
+		return;
+	}
+	// queued primitives were drawn in the old mode
+	submitPending();
+	xorMode = (newMode != GraphicsContext::MODE_NORMAL);
 	if (newMode == GraphicsContext::MODE_NORMAL)
 	{
 		XSetFunction(display,graphics_context,GXcopy);
@@ -91,95 +205,559 @@ void X11Context::setMode(drawMode newMode)
 // Set drawing color - assume colormap is 24 bit RGB
 void X11Context::setColor(unsigned int color)
 {
+	if (frame)
+	{
+		frame->setColor(color);
+		return;
+	}
 	// Go ahead and set color here - better performance than setting
-	// on every setPixel 
-    XSetForeground(display, graphics_context, color);
+	// on every setPixel. Shapes set their color on every draw, most
+	// often to the one already set, which must not break up the batch.
+	if (color == currentColor)
+	{
+		return;
+	}
+	submitPending();
+	XSetForeground(display, graphics_context, color);
+	currentColor = color;
 }
 
 // Set a pixel in the current color
 void X11Context::setPixel(int x, int y)
 {
-	XDrawPoint(display, window, graphics_context, x, y);
-	XFlush(display);
+	if (frame)
+	{
+		waitForShm();
+		frame->setPixel(x, y);
+		return;
+	}
+	// A pixel copied in is known without reading it back, so a flood
+	// fill's alternating setPixel/getPixel doesn't fetch the pixels it
+	// just drew. Only what the server works out (lines, circles, XOR)
+	// has to be fetched.
+	if (!xorMode && rgbPixels && readback.size() == bufferWidth*bufferHeight)
+	{
+		if (x >= 0 && y >= 0 && x < (int)bufferWidth && y < (int)bufferHeight)
+		{
+			readback[y*bufferWidth + x] = currentColor & 0xFFFFFF;
+		}
+	}
+	else
+	{
+		markDrawn(x, y, x, y);
+	}
+	XPoint point = {(short)x, (short)y};
+	pendingPoints.push_back(point);
+	if (pendingPoints.size() >= MAX_PENDING)
+	{
+		submitPending();
+	}
 }
 
 unsigned int X11Context::getPixel(int x, int y)
 {
-	XImage *image;
-	image = XGetImage (display, window, x, y, 1, 1, AllPlanes, XYPixmap);
-	XColor color;
-	color.pixel = XGetPixel (image, 0, 0);
-	XFree (image);
-	XQueryColor (display, DefaultColormap(display, DefaultScreen (display)),
-					&color);
-	// I now have RGB values, but, they are 16 bits each, I only want 8-bits
-	// each since I want a 24-bit RGB color value
-	unsigned int pixcolor = color.red & 0xff00;
-	pixcolor |= (color.green >> 8);
-	pixcolor <<= 8;
-	pixcolor |= (color.blue >> 8);
-	return pixcolor;
+	unsigned int color;
+	getPixels(x, y, 1, 1, &color);
+	return color;
+}
+
+void X11Context::getPixels(int x, int y, int width, int height,
+		unsigned int* pixels)
+{
+	if (frame)
+	{
+		frame->getPixels(x, y, width, height, pixels);
+		return;
+	}
+	
+	// Fetching only the requested rectangle would save little: most of
+	// the cost of XGetImage is the round trip. What's drawn is refetched
+	// instead, and everything else is already here.
+	if (drawnLeft <= drawnRight && drawnLeft < x + width && x <= drawnRight &&
+			drawnTop < y + height && y <= drawnBottom)
+	{
+		refreshReadback();
+	}
+	for (int row=y; row<y + height; row++)
+	{
+		for (int col=x; col<x + width; col++)
+		{
+			bool inside = col >= 0 && row >= 0 && col < (int)bufferWidth && 
+					row < (int)bufferHeight;
+			*pixels++ = inside ? readback[row*bufferWidth + col] : background;
+		}
+	}
+}
+
+void X11Context::markDrawn(int left, int top, int right, int bottom)
+{
+	drawnLeft = std::min(drawnLeft, left);
+	drawnTop = std::min(drawnTop, top);
+	drawnRight = std::max(drawnRight, right);
+	drawnBottom = std::max(drawnBottom, bottom);
+}
+
+void X11Context::refreshReadback()
+{
+	// the pixels must reflect everything drawn so far
+	submitPending();
+	
+	int left = std::max(drawnLeft, 0);
+	int top = std::max(drawnTop, 0);
+	int right = std::min(drawnRight, (int)bufferWidth - 1);
+	int bottom = std::min(drawnBottom, (int)bufferHeight - 1);
+	drawnLeft = drawnTop = INT_MAX;
+	drawnRight = drawnBottom = INT_MIN;
+	if (left > right || top > bottom)
+	{
+		return;
+	}
+	
+	int width = right - left + 1;
+	int height = bottom - top + 1;
+	readback.resize(bufferWidth*bufferHeight);
+	XImage* pixelImage = XGetImage(display, backBuffer, left, top, width, 
+			height, AllPlanes, ZPixmap);
+	if (!pixelImage)
+	{
+		return;
+	}
+	// 32 bit pixels in this machine's order are read directly
+	bool direct = pixelImage->bits_per_pixel == 32 && 
+			pixelImage->byte_order == hostByteOrder();
+	std::vector<XColor> colors;
+	for (int row=0; row<height; row++)
+	{
+		uint32_t* target = readback.data() + (top + row)*bufferWidth + left;
+		const uint32_t* source = (const uint32_t*)(pixelImage->data + 
+				row*pixelImage->bytes_per_line);
+		for (int col=0; col<width; col++)
+		{
+			unsigned long pixel = direct ? source[col] : 
+					XGetPixel(pixelImage, col, row);
+			if (trueColor)
+			{
+				target[col] = toRGB(pixel);
+			}
+			else
+			{
+				XColor color;
+				color.pixel = pixel;
+				colors.push_back(color);
+			}
+		}
+	}
+	XDestroyImage(pixelImage);
+	
+	if (!trueColor)
+	{
+		// all the colors are looked up in one round trip
+		XQueryColors(display, DefaultColormap(display, DefaultScreen(display)),
+				colors.data(), colors.size());
+		// the components are 16 bits each, only 8 are kept
+		for (int row=0; row<height; row++)
+		{
+			uint32_t* target = readback.data() + (top + row)*bufferWidth + left;
+			for (int col=0; col<width; col++)
+			{
+				const XColor &color = colors[row*width + col];
+				target[col] = ((color.red & 0xff00) << 8) | 
+						(color.green & 0xff00) | (color.blue >> 8);
+			}
+		}
+	}
+}
+
+unsigned int X11Context::toRGB(unsigned long pixel) const
+{
+	const Channel* channels[3] = {&red, &green, &blue};
+	unsigned int rgb = 0;
+	for (int c=0; c<3; c++)
+	{
+		const Channel &channel = *channels[c];
+		unsigned long value = (pixel & channel.mask) >> channel.shift;
+		// scaled to 8 bits, whatever the channel's depth
+		if (channel.max)
+		{
+			value = (value*255 + channel.max/2) / channel.max;
+		}
+		rgb = (rgb << 8) | value;
+	}
+	return rgb;
 }
 
 void X11Context::clear()
 {
-	XClearWindow(display, window);
+	if (frame)
+	{
+		waitForShm();
+		frame->clear();
+		return;
+	}
+	// anything queued would be cleared away anyway
+	pendingPoints.clear();
+	pendingSegments.clear();
+	pendingArcs.clear();
+	// whatever the drawing mode, the buffer is filled with the background
+	XSetForeground(display, copy_context, background);
+	XFillRectangle(display, backBuffer, copy_context, 0, 0, 
+			bufferWidth, bufferHeight);
+	markDrawn(0, 0, bufferWidth - 1, bufferHeight - 1);
+}
+
+void X11Context::flush()
+{
+	if (frame)
+	{
+		frame->flush();
+	}
+	submitPending();
+	present(0, 0, bufferWidth, bufferHeight);
+	presented = true;
 	XFlush(display);
 }
 
+void X11Context::present(int x, int y, unsigned int width, unsigned int height)
+{
+	switch (mode)
+	{
+	case PRESENT_SHM:
+		// The server reads the frame's own pixels, so drawing waits for
+		// the completion event before changing them (see waitForShm)
+		XShmPutImage(display, window, copy_context, image, x, y, x, y, 
+				width, height, True);
+		shmPending++;
+		break;
+	case PRESENT_IMAGE:
+		XPutImage(display, window, copy_context, image, x, y, x, y, 
+				width, height);
+		break;
+	case PRESENT_PIXMAP:
+		XCopyArea(display, backBuffer, window, copy_context, x, y, width, height,
+				x, y);
+		break;
+	}
+}
+
+X11Context::presentMode X11Context::getPresentMode() const
+{
+	return mode;
+}
+
+void X11Context::waitForShm()
+{
+	// Only completion events are taken off the queue, the others are
+	// left for runLoop. Those runLoop gets to first are counted there.
+	while (shmPending > 0)
+	{
+		XEvent e;
+		XIfEvent(display, &e, isEventOfType, (XPointer)&shmCompletionType);
+		shmPending--;
+	}
+}
+
+bool X11Context::takesFramePixels()
+{
+	// the frame's pixels are 0x00RRGGBB ints, which the server must be
+	// able to take as they are
+	int screen = DefaultScreen(display);
+	Visual* visual = DefaultVisual(display, screen);
+	int depth = DefaultDepth(display, screen);
+	return visual->c_class == TrueColor && (depth == 24 || depth == 32) &&
+			visual->red_mask == 0xFF0000 && visual->green_mask == 0xFF00 &&
+			visual->blue_mask == 0xFF;
+}
+
+bool X11Context::createImage()
+{
+	if (!takesFramePixels())
+	{
+		return false;
+	}
+	
+	int screen = DefaultScreen(display);
+	Visual* visual = DefaultVisual(display, screen);
+	int depth = DefaultDepth(display, screen);
+	frame.reset(new FramebufferContext(bufferWidth, bufferHeight, background));
+	image = XCreateImage(display, visual, depth, ZPixmap, 0, 
+			(char*)frame->data(), bufferWidth, bufferHeight, 32, 
+			bufferWidth*sizeof(uint32_t));
+	if (!image)
+	{
+		frame.reset();
+		return false;
+	}
+	// Xlib swaps the bytes on the way if the server wants them the
+	// other way around
+	image->byte_order = hostByteOrder();
+	return true;
+}
+
+bool X11Context::createShmImage()
+{
+	// Shared memory is only shared with a server on this machine, which
+	// must use this machine's byte order: nothing swaps the pixels
+	int screen = DefaultScreen(display);
+	if (!XShmQueryExtension(display) || 
+			ImageByteOrder(display) != hostByteOrder())
+	{
+		return false;
+	}
+	
+	if (!takesFramePixels())
+	{
+		return false;
+	}
+	image = XShmCreateImage(display, DefaultVisual(display, screen), 
+			DefaultDepth(display, screen), ZPixmap, NULL, &shmInfo, 
+			bufferWidth, bufferHeight);
+	if (!image || image->bytes_per_line != (int)(bufferWidth*sizeof(uint32_t)))
+	{
+		if (image)
+		{
+			XDestroyImage(image);
+			image = NULL;
+		}
+		return false;
+	}
+	
+	shmInfo.shmid = shmget(IPC_PRIVATE, image->bytes_per_line*bufferHeight, 
+			IPC_CREAT | 0600);
+	shmInfo.shmaddr = (shmInfo.shmid < 0) ? (char*)-1 : 
+			(char*)shmat(shmInfo.shmid, NULL, 0);
+	bool attached = false;
+	if (shmInfo.shmaddr != (char*)-1)
+	{
+		image->data = shmInfo.shmaddr;
+		shmInfo.readOnly = False;
+		
+		// A remote server fails the attach with an error event rather
+		// than a return value: catch it
+		shmAttachFailed = false;
+		XErrorHandler previous = XSetErrorHandler(shmAttachErrorHandler);
+		attached = XShmAttach(display, &shmInfo);
+		XSync(display, False);
+		XSetErrorHandler(previous);
+		attached = attached && !shmAttachFailed;
+	}
+	
+	if (shmInfo.shmid >= 0)
+	{
+		// freed once both sides detach
+		shmctl(shmInfo.shmid, IPC_RMID, NULL);
+	}
+	if (!attached)
+	{
+		if (shmInfo.shmaddr != (char*)-1)
+		{
+			shmdt(shmInfo.shmaddr);
+		}
+		image->data = NULL;
+		XDestroyImage(image);
+		image = NULL;
+		return false;
+	}
+	
+	// frames are drawn straight into the shared memory
+	frame.reset(new FramebufferContext(bufferWidth, bufferHeight, background,
+			(uint32_t*)image->data));
+	shmCompletionType = XShmGetEventBase(display) + ShmCompletion;
+	return true;
+}
+
+void X11Context::submitPending()
+{
+	// Xlib splits these into as many requests as the server's maximum
+	// request size needs
+	if (!pendingPoints.empty())
+	{
+		XDrawPoints(display, backBuffer, graphics_context, pendingPoints.data(),
+				pendingPoints.size(), CoordModeOrigin);
+		pendingPoints.clear();
+	}
+	if (!pendingSegments.empty())
+	{
+		XDrawSegments(display, backBuffer, graphics_context, pendingSegments.data(),
+				pendingSegments.size());
+		pendingSegments.clear();
+	}
+	if (!pendingArcs.empty())
+	{
+		XDrawArcs(display, backBuffer, graphics_context, pendingArcs.data(),
+				pendingArcs.size());
+		pendingArcs.clear();
+	}
+}
+
  
 
 // Run event loop
 void X11Context::runLoop(DrawingBase* drawing)
 {
+	typedef std::chrono::steady_clock clock;
+	const clock::duration interval = 
+			std::chrono::milliseconds(FRAME_INTERVAL_MS);
+	// the first paint needn't wait
+	clock::time_point lastPaint = clock::now() - interval;
+	int connection = ConnectionNumber(display);
 	run = true;
 	
 	while(run)
 	{
-		XEvent e;
-		XNextEvent(display, &e);
-
-		// Exposure event - lets not worry about region
-		if (e.type == Expose)
+		// Wait for events, but no longer than until a requested paint
+		// is due. XPending also sends anything still buffered.
+		if (XPending(display) == 0)
+		{
+			fd_set readable;
+			FD_ZERO(&readable);
+			FD_SET(connection, &readable);
+			timeval timeout;
+			timeval* wait = NULL;
+			if (paintRequested)
+			{
+				long remaining = std::max<long>(0, 
+						std::chrono::duration_cast<std::chrono::microseconds>(
+						lastPaint + interval - clock::now()).count());
+				timeout.tv_sec = remaining / 1000000;
+				timeout.tv_usec = remaining % 1000000;
+				wait = &timeout;
+			}
+			select(connection + 1, &readable, NULL, NULL, wait);
+		}
+		
+		// Handle the events queued so far, but not ones arriving while
+		// doing so, which would hold off painting for as long as they
+		// kept coming. Motion is merged: only where the pointer ended
+		// up matters, as long as it's passed on before anything else.
+		int queued = XPending(display);
+		bool moved = false;
+		XEvent motion;
+		// drawing may take completion events out of the queue meanwhile
+		// (see waitForShm), which mustn't leave XNextEvent waiting
+		while (queued-- > 0 && run && XEventsQueued(display, QueuedAlready) > 0)
+		{
+			XEvent e;
+			XNextEvent(display, &e);
+			if (e.type == MotionNotify)
+			{
+				motion = e;
+				moved = true;
+				continue;
+			}
+			if (moved)
+			{
+				handleEvent(drawing, motion);
+				moved = false;
+			}
+			handleEvent(drawing, e);
+		}
+		if (moved && run)
+		{
+			handleEvent(drawing, motion);
+		}
+		if (!run)
+		{
+			break;
+		}
+		
+		// Uncovered areas are repaired in one go: from the back buffer
+		// once it holds a frame, by painting until then
+		if (exposedLeft <= exposedRight)
+		{
+			if (presented)
+			{
+				present(exposedLeft, exposedTop, 
+						exposedRight - exposedLeft + 1, 
+						exposedBottom - exposedTop + 1);
+			}
+			else
+			{
+				paintRequested = true;
+			}
+			exposedLeft = exposedTop = INT_MAX;
+			exposedRight = exposedBottom = INT_MIN;
+		}
+		
+		if (paintRequested && clock::now() - lastPaint >= interval)
+		{
+			paintRequested = false;
+			lastPaint = clock::now();
 			drawing->paint(this);
+		}
+	}
+	paintRequested = false;
+}
 
-		// Key Down
-		else if (e.type == KeyPress)
-			drawing->keyDown(this,XLookupKeysym((XKeyEvent*)&e,
-					(((e.xkey.state&0x01)&&!(e.xkey.state&0x02))||
-					(!(e.xkey.state&0x01)&&(e.xkey.state&0x02)))?1:0));
-	 
-		// Key Up
-		else if (e.type == KeyRelease){
-			drawing->keyUp(this,XLookupKeysym((XKeyEvent*)&e,
-					(((e.xkey.state&0x01)&&!(e.xkey.state&0x02))||
-					(!(e.xkey.state&0x01)&&(e.xkey.state&0x02)))?1:0));
-				}
-
-		// Mouse Button Down
-		else if (e.type == ButtonPress)
-			drawing->mouseButtonDown(this,
-			e.xbutton.button,
-			e.xbutton.x,
-			e.xbutton.y);
-			
-		// Mouse Button Up
-		else if (e.type == ButtonRelease)
-			drawing->mouseButtonUp(this,
-			e.xbutton.button,
-			e.xbutton.x,
-			e.xbutton.y);
-			
-		// Mouse Move	
-		else if (e.type == MotionNotify)
-			drawing->mouseMove(this,
-			e.xmotion.x,
-			e.xmotion.y);
-
-		// This will respond to the WM_DELETE_WINDOW from the
-		// window manager.
-		else if (e.type == ClientMessage)
-		break;
+void X11Context::handleEvent(DrawingBase* drawing, XEvent &e)
+{
+	// the server is done with a frame put with XShmPutImage
+	if (mode == PRESENT_SHM && e.type == shmCompletionType)
+	{
+		if (shmPending > 0)
+		{
+			shmPending--;
+		}
+	}
+	
+	// Exposure event
+	else if (e.type == Expose)
+	{
+		exposedLeft = std::min(exposedLeft, (int)e.xexpose.x);
+		exposedTop = std::min(exposedTop, (int)e.xexpose.y);
+		exposedRight = std::max(exposedRight, 
+				e.xexpose.x + e.xexpose.width - 1);
+		exposedBottom = std::max(exposedBottom, 
+				e.xexpose.y + e.xexpose.height - 1);
+	}
+
+	// Key Down
+	else if (e.type == KeyPress)
+		drawing->keyDown(this,XLookupKeysym((XKeyEvent*)&e,
+				(((e.xkey.state&0x01)&&!(e.xkey.state&0x02))||
+				(!(e.xkey.state&0x01)&&(e.xkey.state&0x02)))?1:0));
+ 
+	// Key Up
+	else if (e.type == KeyRelease){
+		drawing->keyUp(this,XLookupKeysym((XKeyEvent*)&e,
+				(((e.xkey.state&0x01)&&!(e.xkey.state&0x02))||
+				(!(e.xkey.state&0x01)&&(e.xkey.state&0x02)))?1:0));
+			}
+
+	// Mouse Button Down
+	else if (e.type == ButtonPress)
+		drawing->mouseButtonDown(this,
+		e.xbutton.button,
+		e.xbutton.x,
+		e.xbutton.y);
+		
+	// Mouse Button Up
+	else if (e.type == ButtonRelease)
+		drawing->mouseButtonUp(this,
+		e.xbutton.button,
+		e.xbutton.x,
+		e.xbutton.y);
+		
+	// Mouse Move	
+	else if (e.type == MotionNotify)
+		drawing->mouseMove(this,
+		e.xmotion.x,
+		e.xmotion.y);
+
+	// This will respond to the WM_DELETE_WINDOW from the
+	// window manager.
+	else if (e.type == ClientMessage)
+		run = false;
+}
+
+void X11Context::repaint(DrawingBase* drawing)
+{
+	if (run)
+	{
+		paintRequested = true;
+	}
+	else
+	{
+		drawing->paint(this);
 	}
 }
 
@@ -198,17 +776,62 @@ int X11Context::getWindowHeight()
 	return window_attributes.height;
 }
 
-// leave these out for now
 void X11Context::drawLine(int x1, int y1, int x2, int y2)
 {
-	XDrawLine(display, window, graphics_context, x1, y1, x2, y2);		
-	XFlush(display);
+	if (frame)
+	{
+		waitForShm();
+		frame->drawLine(x1, y1, x2, y2);
+		return;
+	}
+	markDrawn(std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), 
+			std::max(y1, y2));
+	XSegment segment = {(short)x1, (short)y1, (short)x2, (short)y2};
+	pendingSegments.push_back(segment);
+	if (pendingSegments.size() >= MAX_PENDING)
+	{
+		submitPending();
+	}
 }
 
-void X11Context::drawCircle(int x, int y, int radius)
+void X11Context::drawCircle(int x, int y, unsigned int radius)
 {
-	XDrawArc(display, window, graphics_context, x-radius,
-				 y-radius, radius*2, radius*2, 0, 360*64);
-	XFlush(display);
+	if (frame)
+	{
+		waitForShm();
+		frame->drawCircle(x, y, radius);
+		return;
+	}
+	int r = radius;
+	markDrawn(x - r, y - r, x + r, y + r);
+	XArc arc = {(short)(x-r), (short)(y-r), (unsigned short)(r*2), 
+			(unsigned short)(r*2), 0, 360*64};
+	pendingArcs.push_back(arc);
+	if (pendingArcs.size() >= MAX_PENDING)
+	{
+		submitPending();
+	}
 }
 
+void X11Context::fillTriangle(double x0, double y0, double z0,
+		double x1, double y1, double z1,
+		double x2, double y2, double z2)
+{
+	if (frame)
+	{
+		waitForShm();
+		frame->fillTriangle(x0, y0, z0, x1, y1, z1, x2, y2, z2);
+		return;
+	}
+	GraphicsContext::fillTriangle(x0, y0, z0, x1, y1, z1, x2, y2, z2);
+}
+
+void X11Context::clearDepth()
+{
+	if (frame)
+	{
+		frame->clearDepth();
+		return;
+	}
+	GraphicsContext::clearDepth();
+}